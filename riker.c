@@ -3,7 +3,7 @@
  * Copyright (c) 2025 Andrea Cervesato <andrea.cervesato@mailbox.org>
  */
 
-#include "riker.h"
+#include "riker_internal.h"
 #include <time.h>
 #include <stdio.h>
 #include <errno.h>
@@ -26,27 +26,23 @@
 #define MAGENTA(str) BOLD "\033[35m" str RESET
 #define COLORIZE(color, str, colorize) (colorize ? color(str) : str)
 
-typedef enum
+typedef struct
 {
-	SUITE_SETUP = 0,
-	SUITE_TEARDOWN,
-	TEST_RUN,
-	TEST_SETUP,
-	TEST_TEARDOWN,
-} rk_session_state_t;
+	rk_counters_t *counters;
+	rk_suite_t *suite;
+} rk_session_t;
 
-typedef struct __attribute__((packed))
+/* Test running on the thread, so thread-safe tests can run concurrently */
+typedef struct
 {
-	size_t passed;
-	size_t failed;
-	size_t skipped;
-	size_t errors;
-	rk_suite_t *suite;
+	rk_counters_t *results;
 	rk_test_t *curr_test;
 	rk_session_state_t state;
-} rk_session_t;
+	char padding[4];
+} rk_context_t;
 
-static rk_session_t *session;
+static rk_session_t session;
+static __thread rk_context_t context;
 
 /* Forward declaration specifying gnu_printf attribute */
 void show_test_result(const char *file, const int lineno, int res,
@@ -60,26 +56,33 @@ void show_test_result(const char *file, const int lineno, int res,
 	size_t sfx_size;
 	size_t buf_size = sizeof(buf);
 	const char *str_res;
+	rk_counters_t *results;
+
+	results = context.results ? context.results : session.counters;
 
 	switch (res) {
 	case TPASS:
-		str_res = COLORIZE(GREEN, "PASS", 1);
-		session->passed++;
+		str_res = COLORIZE(GREEN, "PASS", rk_output_color());
+		__atomic_fetch_add(&results->passed, 1,
+			__ATOMIC_RELAXED);
 		break;
 	case TFAIL:
-		str_res = COLORIZE(RED, "FAIL", 1);
-		session->failed++;
+		str_res = COLORIZE(RED, "FAIL", rk_output_color());
+		__atomic_fetch_add(&results->failed, 1,
+			__ATOMIC_RELAXED);
 		break;
 	case TSKIP:
-		str_res = COLORIZE(YELLOW, "SKIP", 1);
-		session->skipped++;
+		str_res = COLORIZE(YELLOW, "SKIP", rk_output_color());
+		__atomic_fetch_add(&results->skipped, 1,
+			__ATOMIC_RELAXED);
 		break;
 	case TERROR:
-		str_res = COLORIZE(MAGENTA, "ERROR", 1);
-		session->errors++;
+		str_res = COLORIZE(MAGENTA, "ERROR", rk_output_color());
+		__atomic_fetch_add(&results->errors, 1,
+			__ATOMIC_RELAXED);
 		break;
 	default:
-		str_res = COLORIZE(BLUE, "INFO", 1);
+		str_res = COLORIZE(BLUE, "INFO", rk_output_color());
 		break;
 	}
 
@@ -91,27 +94,159 @@ void show_test_result(const char *file, const int lineno, int res,
 	if (sfx_size < buf_size)
 		vsnprintf(buf + sfx_size, buf_size - sfx_size, fmt, va);
 
-	printf("%s\n", buf);
+	rk_out_printf_("%s\n", buf);
 }
 
-static void run_test(rk_test_t *test)
+static void run_test(rk_test_t *test, size_t index)
 {
 	assert(test);
 
+	rk_lock_reset_();
+	rk_res_start_(index, test->name);
+
+	rk_res_phase_(RK_IO_SETUP);
 	if (test->setup) {
-		session->state = TEST_SETUP;
+		context.state = TEST_SETUP;
 		test->setup();
 	}
 
+	rk_res_phase_(RK_IO_RUN);
 	if (test->run) {
-		session->state = TEST_RUN;
+		context.state = TEST_RUN;
 		test->run();
 	}
 
+	rk_res_phase_(RK_IO_TEARDOWN);
+	if (test->teardown) {
+		context.state = TEST_TEARDOWN;
+		test->teardown();
+	}
+
+	rk_res_phase_(-1);
+	rk_clock_disable();
+	rk_lock_report_();
+	rk_arena_reset_();
+	rk_out_flush_();
+}
+
+static void run_async(rk_test_t *tests, size_t count)
+{
+	rk_lock_reset_();
+	rk_run_async_(tests, count);
+	rk_clock_disable();
+	rk_lock_report_();
+	rk_arena_reset_();
+	rk_out_flush_();
+}
+
+static void run_indexed(size_t index)
+{
+	char name[64];
+
+	context.curr_test = session.suite->tests + index;
+
+	rk_coverage_begin_();
+
+	if (context.curr_test->flags & RK_TEST_ISA_SWEEP)
+		rk_isa_sweep_(context.curr_test, index, run_test);
+	else
+		run_test(context.curr_test, index);
+
+	rk_coverage_end_(rk_test_name_(context.curr_test, index, name,
+		sizeof(name)));
+}
+
+/*
+ * Resources, lock contention and the virtual clock are accounted for the
+ * whole process, so they are left aside by tests running concurrently.
+ */
+static void run_pooled(size_t index)
+{
+	rk_test_t *test = session.suite->tests + index;
+
+	context.curr_test = test;
+
+	if (test->setup) {
+		context.state = TEST_SETUP;
+		test->setup();
+	}
+
+	context.state = TEST_RUN;
+	test->run();
+
 	if (test->teardown) {
-		session->state = TEST_TEARDOWN;
+		context.state = TEST_TEARDOWN;
 		test->teardown();
 	}
+
+	context.curr_test = NULL;
+	rk_arena_reset_();
+	rk_out_flush_();
+}
+
+static unsigned int env_count(const char *name)
+{
+	const char *value = getenv(name);
+
+	if (!value)
+		return 0;
+
+	return (unsigned int)strtoul(value, NULL, 10);
+}
+
+bool rk_test_pooled_(const rk_test_t *test, unsigned int threads)
+{
+	/* dispatch points are forced for the whole process */
+	return threads && test->run &&
+		(test->flags & RK_TEST_THREAD_SAFE) &&
+		!(test->flags & RK_TEST_ISA_SWEEP);
+}
+
+const char *rk_test_name_(const rk_test_t *test, size_t index, char *buf,
+		size_t size)
+{
+	if (test->name)
+		snprintf(buf, size, "%s", test->name);
+	else
+		snprintf(buf, size, "test %zu", index + 1);
+
+	return buf;
+}
+
+void rk_session_set_(rk_test_t *test, rk_session_state_t state)
+{
+	context.curr_test = test;
+	context.state = state;
+}
+
+void rk_session_count_(rk_counters_t *counters)
+{
+	context.results = counters;
+}
+
+void rk_session_results_(rk_counters_t *counters)
+{
+	const rk_counters_t *results;
+
+	results = context.results ? context.results : session.counters;
+
+	counters->passed = __atomic_load_n(&results->passed, __ATOMIC_RELAXED);
+	counters->failed = __atomic_load_n(&results->failed, __ATOMIC_RELAXED);
+	counters->skipped = __atomic_load_n(&results->skipped,
+		__ATOMIC_RELAXED);
+	counters->errors = __atomic_load_n(&results->errors, __ATOMIC_RELAXED);
+}
+
+void rk_session_add_(const rk_counters_t *counters)
+{
+	__atomic_fetch_add(&session.counters->passed, counters->passed,
+		__ATOMIC_RELAXED);
+	__atomic_fetch_add(&session.counters->failed, counters->failed,
+		__ATOMIC_RELAXED);
+	__atomic_fetch_add(&session.counters->skipped, counters->skipped,
+		__ATOMIC_RELAXED);
+	__atomic_fetch_add(&session.counters->errors, counters->errors,
+		__ATOMIC_RELAXED);
 }
 
 void rk_result_(const char *file, const int lineno, rk_test_result_t ttype,
@@ -125,19 +260,24 @@ void rk_result_(const char *file, const int lineno, rk_test_result_t ttype,
 	show_test_result(file, lineno, ttype, fmt, va);
 	va_end(va);
 
+	/* errors often precede a crash, which would lose the buffered output */
+	if (ttype == TERROR)
+		rk_out_flush_();
+
 	if (ttype == TERROR) {
-		switch (session->state) {
+		switch (context.state) {
 		case SUITE_SETUP:
-			suite = session->suite;
+			suite = session.suite;
 			if (suite && suite->teardown)
 				suite->teardown();
 			break;
 		case TEST_SETUP:
 		case TEST_RUN:
-			test = session->curr_test;
+			test = context.curr_test;
 			if (test && test->teardown)
 				test->teardown();
 			break;
+		case SUITE_RUN:
 		case SUITE_TEARDOWN:
 		case TEST_TEARDOWN:
 		default:
@@ -153,61 +293,113 @@ void rk_run_suite(rk_suite_t *suite)
 
 	assert(suite);
 
-	session = mmap(NULL,
-		sizeof(rk_session_t),
+	session.counters = mmap(NULL,
+		sizeof(rk_counters_t),
 		PROT_READ | PROT_WRITE,
 		MAP_SHARED | MAP_ANONYMOUS,
 		-1, 0);
 
-	if (session == MAP_FAILED) {
+	if (session.counters == MAP_FAILED) {
 		rk_result(TERROR, "mmap() error: %s\n", strerror(errno));
+		rk_out_flush_();
 		return;
 	}
 
-	session->suite = suite;
+	session.suite = suite;
+
+	rk_out_init_();
+	rk_coverage_init_();
+	rk_calib_init_();
 
 	if (suite->setup) {
-		session->state = SUITE_SETUP;
+		context.state = SUITE_SETUP;
 		suite->setup();
 	}
 
+	rk_out_flush_();
+
 	if (suite->tests) {
-		for (size_t i = 0; suite->tests[i].run; i++) {
-			session->curr_test = suite->tests + i;
-			run_test(session->curr_test);
+		unsigned int jobs = env_count("RIKER_JOBS");
+		unsigned int threads = env_count("RIKER_THREADS");
+		size_t tests_count = 0;
+
+		while (suite->tests[tests_count].run ||
+			suite->tests[tests_count].async)
+			tests_count++;
+
+		rk_res_init_(tests_count);
+
+		/* thread-safe tests share the fixtures of the suite */
+		if (threads) {
+			context.state = SUITE_RUN;
+			rk_run_pool_(suite->tests, tests_count, threads,
+				run_pooled);
+		}
+
+		/* synchronous tests are forked, asynchronous ones follow */
+		if (jobs) {
+			context.state = SUITE_RUN;
+			rk_run_parallel_(suite->tests, tests_count, jobs,
+				threads, run_indexed);
 		}
 
-		session->curr_test = NULL;
+		for (size_t i = 0; suite->tests[i].run || suite->tests[i].async;) {
+			size_t count = 0;
+
+			/* consecutive asynchronous tests run concurrently */
+			while (suite->tests[i + count].async)
+				count++;
+
+			if (count) {
+				run_async(suite->tests + i, count);
+				i += count;
+				continue;
+			}
+
+			if (!jobs && !rk_test_pooled_(suite->tests + i, threads))
+				run_indexed(i);
+
+			i++;
+		}
+
+		context.curr_test = NULL;
 	}
 
-	if (session->skipped)
+	if (session.counters->skipped)
 		result = RK_SKIPPED;
-	else if (session->failed || session->errors)
+	else if (session.counters->failed || session.counters->errors)
 		result = RK_FAILED;
 
 	if (suite->teardown) {
-		session->state = SUITE_TEARDOWN;
+		context.state = SUITE_TEARDOWN;
 		suite->teardown();
 	}
 
-	printf("\nSummary:\n"
+	rk_res_report_();
+	rk_coverage_merge_();
+	rk_arena_release_();
+	rk_regex_release_();
+
+	rk_out_printf_("\nSummary:\n"
 		"%s:  %lu\n"
 		"%s:  %lu\n"
 		"%s: %lu\n"
 		"%s:  %lu\n",
-		COLORIZE(GREEN, "Passed", 1),
-		session->passed,
-		COLORIZE(RED, "Failed", 1),
-		session->failed,
-		COLORIZE(YELLOW, "Skipped", 1),
-		session->skipped,
-		COLORIZE(MAGENTA, "Errors", 1),
-		session->errors
+		COLORIZE(GREEN, "Passed", rk_output_color()),
+		session.counters->passed,
+		COLORIZE(RED, "Failed", rk_output_color()),
+		session.counters->failed,
+		COLORIZE(YELLOW, "Skipped", rk_output_color()),
+		session.counters->skipped,
+		COLORIZE(MAGENTA, "Errors", rk_output_color()),
+		session.counters->errors
 	);
 
-	ret = munmap(session, sizeof(rk_session_t));
+	ret = munmap(session.counters, sizeof(rk_counters_t));
 	if (ret == -1)
 		rk_result(TERROR, "munmap() error: %s\n", strerror(errno));
 
+	rk_out_release_();
+
 	exit(result);
 }
@@ -11,9 +11,14 @@
 #include <stdarg.h>
 #include <assert.h>
 #include <stddef.h>
+#include <errno.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 /** @brief Latest test result. This is set all the times we call `rk_result`. */
-static int RK_TST_RES;
+static __thread int RK_TST_RES __attribute__((unused));
 
 /**
  * @brief Test result type.
@@ -55,6 +60,52 @@ typedef enum
 
 typedef void (*rk_test_func)(void);
 
+/**
+ * @brief Context of an asynchronous test.
+ */
+typedef struct rk_async rk_async_t;
+
+typedef void (*rk_async_func)(rk_async_t *ctx);
+
+/**
+ * @brief Continuation of an asynchronous test.
+ *
+ * @param ctx Context of the asynchronous test.
+ * @param fd File descriptor which is ready.
+ * @param events Events of the file descriptor, as returned by epoll.
+ * @param data User data given to @ref rk_async_watch.
+ */
+typedef void (*rk_async_cb)(rk_async_t *ctx, int fd, unsigned int events,
+		void *data);
+
+/**
+ * @brief The test is a benchmark which needs a physical core for itself.
+ *
+ * When tests are forked in parallel, the test is pinned on a physical core
+ * whose SMT siblings are kept idle, preferring cores which don't share the
+ * last level cache with other running tests.
+ */
+#define RK_TEST_EXCLUSIVE (1UL << 0)
+
+/**
+ * @brief The test can run concurrently with other tests of the suite.
+ *
+ * When RIKER_THREADS is defined, these tests run on a pool of threads inside
+ * the testing process, sharing the fixtures created by the suite setup,
+ * before the other tests. Each thread has its own RK_TST_RES.
+ */
+#define RK_TEST_THREAD_SAFE (1UL << 1)
+
+/**
+ * @brief Run the test once for each ISA level supported by the CPU.
+ *
+ * Before each run, the dispatch points registered by @ref rk_isa_register
+ * are forced to the ISA level. The results of each variant are summarized
+ * once all of them completed. These tests never run on the pool of threads,
+ * since dispatch points are shared by the whole process.
+ */
+#define RK_TEST_ISA_SWEEP (1UL << 2)
+
 /**
  * @brief Rapresent a test.
  *
@@ -68,6 +119,27 @@ typedef struct
 	rk_test_func teardown;
 	/** @brief Test to execute. */
 	rk_test_func run;
+	/**
+	 * @brief Asynchronous test to execute instead of `run`.
+	 *
+	 * Consecutive asynchronous tests are executed concurrently inside the
+	 * same event loop. The test completes when this function returned and
+	 * no file descriptors are watched anymore, or when @ref rk_async_done
+	 * is called.
+	 */
+	rk_async_func async;
+	/** @brief Timeout of the asynchronous test in milliseconds. */
+	unsigned long timeout;
+	/**
+	 * @brief Name of the test, shown in the resource table.
+	 *
+	 * The history journal defined by RIKER_HISTORY is keyed by name, so
+	 * only named tests have their memory and duration recorded and they
+	 * are the only ones batched when tests run in parallel.
+	 */
+	const char *name;
+	/** @brief Combination of the RK_TEST_* flags. */
+	unsigned long flags;
 } rk_test_t;
 
 /**
@@ -109,7 +181,7 @@ void rk_result_(const char *file, const int lineno, rk_test_result_t ttype,
 		const char *fmt, ...)
 		__attribute__ ((format (printf, 4, 5)));
 
-#if __STDC_VERSION__ >= 201112L
+#if !defined(__cplusplus) && __STDC_VERSION__ >= 201112L
 
 #define RK_PRINT_FMT_(...) \
 	_Generic((__VA_ARGS__), \
@@ -176,7 +248,7 @@ do { \
 
 #define RK_CHECK_NUM_(a, b, op) \
 do { \
-	int ttype__ = (((a) op (b)) ? TPASS : TFAIL); \
+	rk_test_result_t ttype__ = (((a) op (b)) ? TPASS : TFAIL); \
 	if (ttype__ == TFAIL) { \
 		char buf__[4096] = {0}; \
 		size_t buf_size__ = 4096; \
@@ -365,10 +437,14 @@ do { \
 		rk_result(TFAIL, "%s == %s", #m1, #m2); \
 } while(0)
 
+void rk_diff_(const char *a_name, const char *a, size_t a_len,
+		const char *b_name, const char *b, size_t b_len);
+
 /**
  * @brief Verify that two strings contain the same data. 
  *
- * Verify that `s1` and `s2` contains the same data.
+ * Verify that `s1` and `s2` contains the same data. On failure, a unified
+ * diff of the two strings lines is shown.
  *
  * @param s1 First pointer to some string data.
  * @param s2 Second pointer to some string data.
@@ -383,8 +459,9 @@ do { \
 		rk_result(TPASS, "%s == %s (%s = %s, %s = %s)", \
 			#s1, #s2, #s1, _ck_s1, #s2, _ck_s2); \
 	} else { \
-		rk_result(TFAIL, "%s != %s (%s = %s, %s = %s)", \
-			#s1, #s2, #s1, _ck_s1, #s2, _ck_s2); \
+		rk_result(TFAIL, "%s != %s", #s1, #s2); \
+		rk_diff_(#s1, _ck_s1, strnlen(_ck_s1, _ck_n), \
+			#s2, _ck_s2, strnlen(_ck_s2, _ck_n)); \
 	} \
 } while(0)
 
@@ -460,20 +537,1476 @@ do { \
 } while(0)
 
 /**
- * @brief Testing suite declaration.
+ * @brief Total time spent waiting on contended locks by the current test.
+ *
+ * Locks are tracked only when riker is built with the `lock_contention`
+ * option, which interposes pthread mutexes, rwlocks and condition variables.
+ * Otherwise this function always returns 0. Time spent inside
+ * pthread_cond_wait() is reported apart and it's not counted as lock wait.
  *
- * Override this object in order to declare your own testing suite.
+ * @return Wait time in nanoseconds.
  */
-static rk_suite_t test_suite;
+unsigned long long rk_contention_wait_ns(void);
 
 /**
- * @brief Run a testing suite.
+ * @brief Verify that the current test didn't wait on locks too long.
  *
- * Run all tests inside a testing suite and return the ending result.
+ * Verify that the time spent by the current test waiting on contended locks
+ * is lower or equal than `limit` and return a TPASS message. TFAIL otherwise.
  *
- * @param suite Testing suite object.
+ * @param limit Maximum wait time in nanoseconds.
  */
-void rk_run_suite(rk_suite_t *suite);
+#define rk_check_contention_le(limit) \
+do { \
+	unsigned long long _ck_wait = rk_contention_wait_ns(); \
+	unsigned long long _ck_limit = (unsigned long long)(limit); \
+	if (_ck_wait <= _ck_limit) \
+		rk_result(TPASS, "lock wait %llu ns <= %s", _ck_wait, #limit); \
+	else \
+		rk_result(TFAIL, "lock wait %llu ns > %s", _ck_wait, #limit); \
+} while(0)
+
+/**
+ * @brief Enable the virtual clock for the current test.
+ *
+ * When riker is built with the `virtual_clock` option, clock_gettime(),
+ * gettimeofday(), time(), nanosleep(), clock_nanosleep(), usleep(), sleep(),
+ * poll() and epoll_wait() are interposed. Once the virtual clock is enabled,
+ * sleeps and timeouts return immediately moving the time forward, as soon as
+ * all the threads of the process are waiting for a timer. While some threads
+ * are running, or blocked on anything else, the time goes on at the real
+ * pace. If RIKER_CLOCK_GRACE_MS is set, a sleeping thread moves the time
+ * forward after waiting that many real milliseconds anyway, which speeds up
+ * tests whose threads block on I/O but lets running threads see the time
+ * jump. The virtual clock is disabled automatically at the end of each test.
+ *
+ * @return 0 on success, -1 if riker doesn't support the virtual clock.
+ */
+int rk_clock_enable(void);
+
+/**
+ * @brief Disable the virtual clock and go back to the real time.
+ */
+void rk_clock_disable(void);
+
+/**
+ * @brief Move the virtual clock forward.
+ *
+ * @param ns Number of nanoseconds to add to the virtual clock.
+ */
+void rk_clock_advance(unsigned long long ns);
+
+/**
+ * @brief Call `cb` every time `fd` is ready.
+ *
+ * Register a continuation of an asynchronous test, which is called by the
+ * event loop when one of the `events` happens on `fd`.
+ *
+ * @param ctx Context of the asynchronous test.
+ * @param fd File descriptor to watch.
+ * @param events epoll events to watch, such as EPOLLIN or EPOLLOUT.
+ * @param cb Continuation to call.
+ * @param data User data given to `cb`.
+ * @return 0 on success, -1 on error and errno is set.
+ */
+int rk_async_watch(rk_async_t *ctx, int fd, unsigned int events,
+		rk_async_cb cb, void *data);
+
+/**
+ * @brief Stop watching `fd`.
+ *
+ * @param ctx Context of the asynchronous test.
+ * @param fd File descriptor which was given to @ref rk_async_watch.
+ */
+void rk_async_unwatch(rk_async_t *ctx, int fd);
+
+/**
+ * @brief Suspend the asynchronous test until `fd` is ready.
+ *
+ * Other asynchronous tests run while waiting. This function can be called
+ * only from the `async` function of the test, not from its continuations.
+ *
+ * @param ctx Context of the asynchronous test.
+ * @param fd File descriptor to wait for.
+ * @param events epoll events to wait for, such as EPOLLIN or EPOLLOUT.
+ * @return Events of the file descriptor, -1 on error and errno is set.
+ *         errno is ETIMEDOUT when the test timed out.
+ */
+int rk_async_wait(rk_async_t *ctx, int fd, unsigned int events);
+
+/**
+ * @brief Complete the asynchronous test.
+ *
+ * @param ctx Context of the asynchronous test.
+ */
+void rk_async_done(rk_async_t *ctx);
+
+/**
+ * @brief Request-response rule of a service stub.
+ *
+ * Rules are checked in order and the list is terminated by a rule having a
+ * NULL `response`. A request is answered once it's complete, that is when
+ * the `end` of the matching rule has been received.
+ */
+typedef struct
+{
+	/** @brief Prefix of the request. NULL matches any request. */
+	const char *request;
+	/** @brief Response sent back when `request` matches. */
+	const char *response;
+	/** @brief Length of `response`. 0 means strlen(response). */
+	size_t response_len;
+	/** @brief End of the request, such as "\r\n\r\n". NULL means "\n". */
+	const char *end;
+} rk_stub_rule_t;
+
+/**
+ * @brief In-process service stand-in, see @ref rk_service_stub_start.
+ */
+typedef struct rk_service_stub rk_service_stub_t;
+
+/**
+ * @brief Start a scripted service listening on a local socket.
+ *
+ * The service runs on its own thread and it answers each request matching
+ * `rules`. Requests of a connection are buffered until they are complete and
+ * they are answered in order, while the latency and the bandwidth of a
+ * response don't delay the other connections. Connections sending unknown
+ * requests, or requests bigger than 64 KiB, are closed. UNIX sockets are
+ * created inside a private temporary directory and loopback sockets on a
+ * port chosen by the kernel, so many stubs can run in parallel.
+ *
+ * @param domain AF_UNIX or AF_INET.
+ * @param rules List of request-response rules.
+ * @param latency_us Delay before sending each response in microseconds.
+ * @param bandwidth Maximum bytes per second of responses. 0 is unlimited.
+ * @return A new service stub, NULL on error and errno is set.
+ */
+rk_service_stub_t *rk_service_stub_start(int domain,
+		const rk_stub_rule_t *rules, unsigned long latency_us,
+		unsigned long bandwidth);
+
+/**
+ * @brief Address of the service stub.
+ *
+ * @param stub Service stub.
+ * @return Socket path for AF_UNIX, "127.0.0.1:<port>" for AF_INET.
+ */
+const char *rk_service_stub_address(rk_service_stub_t *stub);
+
+/**
+ * @brief Open a new connection to the service stub.
+ *
+ * @param stub Service stub.
+ * @return Connected socket, -1 on error and errno is set.
+ */
+int rk_service_stub_connect(rk_service_stub_t *stub);
+
+/**
+ * @brief Read the traffic received by the service stub.
+ *
+ * @param stub Service stub.
+ * @param buf Buffer where received data is copied. It can be NULL.
+ * @param size Size of `buf`.
+ * @param requests Number of requests received. It can be NULL.
+ * @return Number of bytes received by the service stub.
+ */
+size_t rk_service_stub_traffic(rk_service_stub_t *stub, char *buf,
+		size_t size, size_t *requests);
+
+/**
+ * @brief Stop the service stub and release its resources.
+ *
+ * @param stub Service stub.
+ */
+void rk_service_stub_stop(rk_service_stub_t *stub);
+
+const char *rk_memmem_(const char *haystack, size_t haystack_len,
+		const char *needle, size_t needle_len)
+		__attribute__ ((pure));
+
+size_t rk_line_of_(const char *buf, size_t offset)
+		__attribute__ ((pure));
+
+size_t rk_count_(const char *buf, size_t len, const char *needle,
+		size_t needle_len)
+		__attribute__ ((pure));
+
+size_t rk_nearest_(const char *buf, size_t len, const char *needle,
+		size_t needle_len, size_t *offset);
+
+int rk_regex_(const char *buf, size_t len, const char *pattern,
+		size_t *offset);
+
+/**
+ * @brief Verify that a buffer contains a string.
+ *
+ * Search `needle` inside the first `len` bytes of `buf` and return a TPASS
+ * message reporting its offset. TFAIL otherwise, reporting the longest
+ * prefix of `needle` which has been found and its line.
+ *
+ * @param buf Buffer to search in.
+ * @param len Length of the buffer.
+ * @param needle String to search.
+ */
+#define rk_check_contains(buf, len, needle) \
+do { \
+	const char *_ck_buf = (buf); \
+	size_t _ck_len = (size_t)(len); \
+	const char *_ck_needle = (needle); \
+	size_t _ck_needle_len = strlen(_ck_needle); \
+	const char *_ck_pos = rk_memmem_(_ck_buf, _ck_len, \
+		_ck_needle, _ck_needle_len); \
+	size_t _ck_off, _ck_near; \
+	if (_ck_pos) { \
+		_ck_off = (size_t)(_ck_pos - _ck_buf); \
+		rk_result(TPASS, "%s contains %s (offset = %zu, line = %zu)", \
+			#buf, #needle, _ck_off, rk_line_of_(_ck_buf, _ck_off)); \
+	} else { \
+		_ck_near = rk_nearest_(_ck_buf, _ck_len, _ck_needle, \
+			_ck_needle_len, &_ck_off); \
+		rk_result(TFAIL, "%s doesn't contain %s (longest prefix " \
+			"found = %zu bytes, line = %zu)", #buf, #needle, \
+			_ck_near, _ck_near ? rk_line_of_(_ck_buf, _ck_off) : 0); \
+	} \
+} while(0)
+
+/**
+ * @brief Verify that a buffer doesn't contain a string.
+ *
+ * Search `needle` inside the first `len` bytes of `buf` and return a TPASS
+ * message if it's not found. TFAIL otherwise, reporting its offset and line.
+ *
+ * @param buf Buffer to search in.
+ * @param len Length of the buffer.
+ * @param needle String to search.
+ */
+#define rk_check_not_contains(buf, len, needle) \
+do { \
+	const char *_ck_buf = (buf); \
+	const char *_ck_needle = (needle); \
+	const char *_ck_pos = rk_memmem_(_ck_buf, (size_t)(len), \
+		_ck_needle, strlen(_ck_needle)); \
+	size_t _ck_off; \
+	if (!_ck_pos) { \
+		rk_result(TPASS, "%s doesn't contain %s", #buf, #needle); \
+	} else { \
+		_ck_off = (size_t)(_ck_pos - _ck_buf); \
+		rk_result(TFAIL, "%s contains %s (offset = %zu, line = %zu)", \
+			#buf, #needle, _ck_off, rk_line_of_(_ck_buf, _ck_off)); \
+	} \
+} while(0)
+
+/**
+ * @brief Verify how many times a buffer contains a string.
+ *
+ * Count the non-overlapping occurrences of `needle` inside the first `len`
+ * bytes of `buf` and return a TPASS message if they are `n`. TFAIL otherwise.
+ *
+ * @param buf Buffer to search in.
+ * @param len Length of the buffer.
+ * @param needle String to search.
+ * @param n Expected number of occurrences.
+ */
+#define rk_check_count(buf, len, needle, n) \
+do { \
+	const char *_ck_needle = (needle); \
+	size_t _ck_count = rk_count_((buf), (size_t)(len), \
+		_ck_needle, strlen(_ck_needle)); \
+	if (_ck_count == (size_t)(n)) { \
+		rk_result(TPASS, "%s contains %s %s times", \
+			#buf, #needle, #n); \
+	} else { \
+		rk_result(TFAIL, "%s contains %s %s times (count = %zu)", \
+			#buf, #needle, #n, _ck_count); \
+	} \
+} while(0)
+
+/**
+ * @brief Verify that a buffer matches a regular expression.
+ *
+ * Match the first `len` bytes of `buf` against the POSIX extended regular
+ * expression `pattern` and return a TPASS message reporting the match
+ * offset. TFAIL otherwise. Compiled patterns are cached by each thread, so
+ * checking the same pattern many times doesn't compile it again. Buffers
+ * bigger than 2 GiB are rejected, since their offsets don't fit inside a
+ * regmatch_t.
+ *
+ * @param buf Buffer to match.
+ * @param len Length of the buffer.
+ * @param pattern Regular expression.
+ */
+#define rk_check_regex(buf, len, pattern) \
+do { \
+	const char *_ck_buf = (buf); \
+	size_t _ck_off = 0; \
+	int _ck_ret = rk_regex_(_ck_buf, (size_t)(len), (pattern), &_ck_off); \
+	if (_ck_ret == 1) { \
+		rk_result(TPASS, "%s matches %s (offset = %zu, line = %zu)", \
+			#buf, #pattern, _ck_off, rk_line_of_(_ck_buf, _ck_off)); \
+	} else if (!_ck_ret) { \
+		rk_result(TFAIL, "%s doesn't match %s", #buf, #pattern); \
+	} else if (errno == EOVERFLOW) { \
+		rk_result(TFAIL, "%s is too large to be matched", #buf); \
+	} else { \
+		rk_result(TFAIL, "%s is not a valid regular expression", \
+			#pattern); \
+	} \
+} while(0)
+
+/**
+ * @brief Compute the FNV-1a hash of a buffer.
+ *
+ * @param buf Data to hash.
+ * @param len Length of data.
+ * @return 64 bits hash of data.
+ */
+unsigned long long rk_hash(const void *buf, size_t len)
+		__attribute__ ((pure));
+
+/**
+ * @brief Callback receiving the output of a command.
+ *
+ * @param buf Chunk of output.
+ * @param len Length of the chunk.
+ * @param fd STDOUT_FILENO or STDERR_FILENO, depending on the stream.
+ * @param data User data given to @ref rk_run_cmd.
+ */
+typedef void (*rk_cmd_output_cb)(const char *buf, size_t len, int fd,
+		void *data);
+
+/**
+ * @brief Options of @ref rk_run_cmd.
+ */
+typedef struct
+{
+	/**
+	 * @brief Output streaming callback.
+	 *
+	 * When it's set, output is given to this callback in large chunks
+	 * instead of being captured.
+	 */
+	rk_cmd_output_cb output;
+	/** @brief User data given to `output`. */
+	void *data;
+	/** @brief Environment of the command. NULL inherits the current one. */
+	char *const *envp;
+} rk_cmd_opts_t;
+
+/**
+ * @brief Result of @ref rk_run_cmd.
+ */
+typedef struct
+{
+	/** @brief Captured stdout. */
+	const char *out;
+	/** @brief Length of the captured stdout. */
+	size_t out_len;
+	/** @brief Captured stderr. */
+	const char *err;
+	/** @brief Length of the captured stderr. */
+	size_t err_len;
+	/** @brief Exit status of the command, -1 if it was killed. */
+	int exit_status;
+	/** @brief Signal which killed the command, 0 otherwise. */
+	int signal;
+	/** @brief Memory file holding stdout. */
+	int out_fd;
+	/** @brief Memory file holding stderr. */
+	int err_fd;
+} rk_cmd_result_t;
+
+/**
+ * @brief Run a command and wait for its completion.
+ *
+ * The command is spawned with posix_spawnp(), searching `argv[0]` inside
+ * PATH. Unless an output callback is given, stdout and stderr of the command
+ * are memory files which are mapped in `res` once the command completed, so
+ * output is never copied by the testing process. Release `res` with
+ * @ref rk_cmd_release.
+ *
+ * @param argv NULL terminated list of arguments.
+ * @param opts Command options. It can be NULL.
+ * @param res Command result.
+ * @return 0 on success, -1 on error and errno is set.
+ */
+int rk_run_cmd(char *const argv[], const rk_cmd_opts_t *opts,
+		rk_cmd_result_t *res);
+
+/**
+ * @brief Release the output captured by @ref rk_run_cmd.
+ *
+ * @param res Command result.
+ */
+void rk_cmd_release(rk_cmd_result_t *res);
+
+/**
+ * @brief Verify that a command exited with `status`.
+ *
+ * @param res Pointer to the command result.
+ * @param status Expected exit status.
+ */
+#define rk_check_cmd_exit(res, status) \
+do { \
+	const rk_cmd_result_t *_ck_res = (res); \
+	int _ck_status = (status); \
+	if (_ck_res->signal) { \
+		rk_result(TFAIL, "%s exit status == %s (signal = %d)", \
+			#res, #status, _ck_res->signal); \
+	} else if (_ck_res->exit_status == _ck_status) { \
+		rk_result(TPASS, "%s exit status == %s", #res, #status); \
+	} else { \
+		rk_result(TFAIL, "%s exit status == %s (exit status = %d)", \
+			#res, #status, _ck_res->exit_status); \
+	} \
+} while(0)
+
+/**
+ * @brief Verify that a command has been killed by `sig`.
+ *
+ * @param res Pointer to the command result.
+ * @param sig Expected signal.
+ */
+#define rk_check_cmd_signal(res, sig) \
+do { \
+	const rk_cmd_result_t *_ck_res = (res); \
+	int _ck_sig = (sig); \
+	if (_ck_res->signal == _ck_sig) { \
+		rk_result(TPASS, "%s signal == %s", #res, #sig); \
+	} else if (_ck_res->signal) { \
+		rk_result(TFAIL, "%s signal == %s (signal = %d)", \
+			#res, #sig, _ck_res->signal); \
+	} else { \
+		rk_result(TFAIL, "%s signal == %s (exit status = %d)", \
+			#res, #sig, _ck_res->exit_status); \
+	} \
+} while(0)
+
+/**
+ * @brief Verify that the stdout of a command is `str`.
+ *
+ * @param res Pointer to the command result.
+ * @param str Expected output.
+ */
+#define rk_check_cmd_out_eq(res, str) \
+do { \
+	const rk_cmd_result_t *_ck_res = (res); \
+	const char *_ck_str = (str); \
+	size_t _ck_len = strlen(_ck_str); \
+	if (_ck_res->out_len == _ck_len && \
+		!memcmp(_ck_res->out, _ck_str, _ck_len)) { \
+		rk_result(TPASS, "%s stdout == %s", #res, #str); \
+	} else { \
+		rk_result(TFAIL, "%s stdout == %s (%zu bytes of stdout)", \
+			#res, #str, _ck_res->out_len); \
+	} \
+} while(0)
+
+/**
+ * @brief Verify that the stdout of a command contains `str`.
+ *
+ * @param res Pointer to the command result.
+ * @param str String to search.
+ */
+#define rk_check_cmd_out_contains(res, str) \
+do { \
+	const rk_cmd_result_t *_ck_res = (res); \
+	const char *_ck_str = (str); \
+	const char *_ck_pos = rk_memmem_(_ck_res->out, _ck_res->out_len, \
+		_ck_str, strlen(_ck_str)); \
+	if (_ck_pos) { \
+		rk_result(TPASS, "%s stdout contains %s (offset = %zu)", \
+			#res, #str, (size_t)(_ck_pos - _ck_res->out)); \
+	} else { \
+		rk_result(TFAIL, "%s stdout doesn't contain %s", #res, #str); \
+	} \
+} while(0)
+
+/**
+ * @brief Verify the hash of the stdout of a command.
+ *
+ * @param res Pointer to the command result.
+ * @param hash Expected @ref rk_hash of the output.
+ */
+#define rk_check_cmd_out_hash(res, hash) \
+do { \
+	const rk_cmd_result_t *_ck_res = (res); \
+	unsigned long long _ck_hash = rk_hash(_ck_res->out, _ck_res->out_len); \
+	if (_ck_hash == (unsigned long long)(hash)) { \
+		rk_result(TPASS, "%s stdout hash == %s", #res, #hash); \
+	} else { \
+		rk_result(TFAIL, "%s stdout hash == %s (hash = 0x%016llx)", \
+			#res, #hash, _ck_hash); \
+	} \
+} while(0)
+
+/** @brief Welch's t-statistic above which code is not constant time. */
+#define RK_CT_THRESHOLD 10
+
+/**
+ * @brief Function whose execution time is verified.
+ *
+ * @param input Input generated by @ref rk_ct_gen.
+ * @param size Size of the input.
+ */
+typedef void (*rk_ct_func)(const void *input, size_t size);
+
+/**
+ * @brief Generator of the inputs of a constant time verification.
+ *
+ * @param input Buffer to fill.
+ * @param size Size of the buffer.
+ * @param cls Input class. It's 0 for the fixed class, usually a constant
+ * input, and 1 for the random class.
+ */
+typedef void (*rk_ct_gen)(void *input, size_t size, int cls);
+
+/**
+ * @brief Measure the execution time of a function for two inputs classes.
+ *
+ * Classes are interleaved at random and measured in cycles on a pinned CPU.
+ * Times are compared using Welch's t-test, after cropping the samples at
+ * different percentiles, as done by dudect.
+ *
+ * @param fn Function to measure.
+ * @param gen Inputs generator.
+ * @param size Size of each input.
+ * @param samples Number of measurements.
+ * @param t Highest absolute t-statistic among the cropped samples.
+ * @return 0 on success, -1 on error and errno is set.
+ */
+int rk_constant_time_(rk_ct_func fn, rk_ct_gen gen, size_t size,
+		size_t samples, double *t);
+
+/**
+ * @brief Verify that a function runs in constant time.
+ *
+ * Return a TFAIL when execution time of `fn` depends on the class of the
+ * inputs provided by `gen`, according to @ref rk_constant_time_.
+ *
+ * @param fn Function to verify.
+ * @param gen Inputs generator.
+ * @param size Size of each input.
+ * @param samples Number of measurements.
+ */
+#define rk_check_constant_time(fn, gen, size, samples) \
+do { \
+	double _ck_t; \
+	if (rk_constant_time_(fn, gen, size, samples, &_ck_t)) { \
+		rk_result(TFAIL, "%s can't be measured (%s)", #fn, \
+			strerror(errno)); \
+	} else if (_ck_t <= RK_CT_THRESHOLD) { \
+		rk_result(TPASS, "%s is constant time (t = %.2f)", #fn, _ck_t); \
+	} else { \
+		rk_result(TFAIL, "%s is not constant time (t = %.2f > %d)", \
+			#fn, _ck_t, RK_CT_THRESHOLD); \
+	} \
+} while(0)
+
+/**
+ * @brief Work executed at every period of @ref rk_jitter.
+ *
+ * @param data User data given to @ref rk_jitter.
+ */
+typedef void (*rk_jitter_func)(void *data);
+
+/**
+ * @brief Options of @ref rk_jitter.
+ */
+typedef struct
+{
+	/** @brief Period of the loop in microseconds. */
+	unsigned long interval_us;
+	/** @brief Number of periods to measure. */
+	unsigned long loops;
+	/** @brief Work executed after every wake up. It can be NULL. */
+	rk_jitter_func work;
+	/** @brief User data given to `work`. */
+	void *data;
+	/** @brief CPU where the loop is pinned, -1 to not pin it. */
+	int cpu;
+	/**
+	 * @brief SCHED_FIFO priority of the loop, 0 to keep the default
+	 * scheduling policy. Without privileges the default policy is used.
+	 */
+	int priority;
+} rk_jitter_opts_t;
+
+/**
+ * @brief Wake up latency measured by @ref rk_jitter.
+ */
+typedef struct
+{
+	/** @brief Minimum latency in nanoseconds. */
+	unsigned long long min_ns;
+	/** @brief Average latency in nanoseconds. */
+	unsigned long long avg_ns;
+	/** @brief Maximum latency in nanoseconds. */
+	unsigned long long max_ns;
+	/** @brief 99th percentile of the latency, with 1us resolution. */
+	unsigned long long p99_ns;
+	/** @brief Number of measured periods. */
+	unsigned long loops;
+	/** @brief Number of periods skipped because work took too long. */
+	unsigned long overruns;
+	/** @brief 1 if the loop ran with SCHED_FIFO policy. */
+	int realtime;
+	/** @brief 1 if the loop has been pinned to the requested CPU. */
+	int pinned;
+} rk_jitter_result_t;
+
+/**
+ * @brief Measure scheduling latency of a periodic loop.
+ *
+ * A dedicated thread wakes up every `interval_us` using clock_nanosleep()
+ * with an absolute deadline and records how late it woke up into a
+ * histogram. The real monotonic clock is always used, even when the
+ * virtual clock is enabled.
+ *
+ * @param opts Loop options.
+ * @param res Measured latency.
+ * @return 0 on success, -1 on error and errno is set.
+ */
+int rk_jitter(const rk_jitter_opts_t *opts, rk_jitter_result_t *res);
+
+/**
+ * @brief Verify the wake up latency of a periodic loop.
+ *
+ * Return a TFAIL if maximum latency is higher than `max_us` or if its 99th
+ * percentile is higher than `p99_us`.
+ *
+ * @param res Pointer to the result of @ref rk_jitter.
+ * @param max_us Maximum latency budget in microseconds.
+ * @param p99_us 99th percentile latency budget in microseconds.
+ */
+#define rk_check_jitter_le(res, max_us, p99_us) \
+do { \
+	const rk_jitter_result_t *_ck_res = (res); \
+	unsigned long long _ck_max = (unsigned long long)(max_us) * 1000ULL; \
+	unsigned long long _ck_p99 = (unsigned long long)(p99_us) * 1000ULL; \
+	if (_ck_res->max_ns <= _ck_max && _ck_res->p99_ns <= _ck_p99) { \
+		rk_result(TPASS, "jitter max %llu ns <= %s us, p99 %llu ns " \
+			"<= %s us (%s)", _ck_res->max_ns, #max_us, \
+			_ck_res->p99_ns, #p99_us, \
+			_ck_res->realtime ? "SCHED_FIFO" : "SCHED_OTHER"); \
+	} else { \
+		rk_result(TFAIL, "jitter max %llu ns <= %s us, p99 %llu ns " \
+			"<= %s us (%s)", _ck_res->max_ns, #max_us, \
+			_ck_res->p99_ns, #p99_us, \
+			_ck_res->realtime ? "SCHED_FIFO" : "SCHED_OTHER"); \
+	} \
+} while(0)
+
+/**
+ * @brief Buffer kernel checked by @ref rk_sweep_buffers.
+ *
+ * @param dst Destination buffer of `len` bytes.
+ * @param src Source buffer of `len` bytes.
+ * @param len Length of the buffers.
+ */
+typedef void (*rk_sweep_func)(void *dst, const void *src, size_t len);
+
+long rk_sweep_buffers_(const char *file, const int lineno, rk_sweep_func fn,
+		rk_sweep_func ref_fn, size_t max_len, size_t align_range);
+
+/**
+ * @brief Verify that a buffer kernel behaves like a reference one for all
+ * lengths and alignments.
+ *
+ * For each alignment of source and destination up to `align_range` and for
+ * each length up to `max_len`, buffers are placed right before a guard page
+ * and `fn` output is compared with `ref_fn` one, including the bytes around
+ * the destination. Faults are caught and reported as failures. Failing
+ * cases are reported as ranges of lengths for each pair of alignments.
+ *
+ * The sweep runs on multiple threads, so `fn` and `ref_fn` must be thread
+ * safe.
+ *
+ * @param fn Kernel to verify.
+ * @param ref_fn Reference kernel.
+ * @param max_len Maximum length of the buffers.
+ * @param align_range Number of alignments to verify, up to the page size.
+ */
+#define rk_sweep_buffers(fn, ref_fn, max_len, align_range) \
+do { \
+	long _ck_fails = rk_sweep_buffers_(__FILE__, __LINE__, (fn), \
+		(ref_fn), (max_len), (align_range)); \
+	if (_ck_fails < 0) { \
+		rk_result(TFAIL, "%s can't be swept (%s)", #fn, \
+			strerror(errno)); \
+	} else if (!_ck_fails) { \
+		rk_result(TPASS, "%s matches %s up to %s bytes, %s alignments", \
+			#fn, #ref_fn, #max_len, #align_range); \
+	} else { \
+		rk_result(TFAIL, "%s differs from %s in %ld cases", #fn, \
+			#ref_fn, _ck_fails); \
+	} \
+} while(0)
+
+/**
+ * @brief Maximum number of threads of a litmus test.
+ */
+#define RK_LITMUS_MAX_THREADS 4
+
+/**
+ * @brief Number of registers each thread of a litmus test can observe.
+ */
+#define RK_LITMUS_REGS 2
+
+/**
+ * @brief Maximum number of distinct outcomes recorded by @ref rk_litmus.
+ */
+#define RK_LITMUS_MAX_OUTCOMES 16
+
+/**
+ * @brief Thread of a litmus test.
+ *
+ * @param state Shared state of the litmus test.
+ * @param regs Values observed by the thread, @ref RK_LITMUS_REGS of them.
+ */
+typedef void (*rk_litmus_func)(void *state, long *regs);
+
+/**
+ * @brief Reset the shared state before each iteration of a litmus test.
+ *
+ * @param state Shared state of the litmus test.
+ */
+typedef void (*rk_litmus_init_func)(void *state);
+
+/**
+ * @brief Tell if an outcome of a litmus test is forbidden.
+ *
+ * @param regs Registers of all the threads, where register `r` of thread
+ * `t` is `regs[t * RK_LITMUS_REGS + r]`.
+ * @return 1 if the outcome is forbidden, 0 otherwise.
+ */
+typedef int (*rk_litmus_cond_func)(const long *regs);
+
+/**
+ * @brief Options of @ref rk_litmus.
+ */
+typedef struct
+{
+	/** @brief Threads of the test, unused ones are NULL. */
+	rk_litmus_func threads[RK_LITMUS_MAX_THREADS];
+	/** @brief Reset of the shared state. It can be NULL. */
+	rk_litmus_init_func init;
+	/** @brief Forbidden outcomes. It can be NULL. */
+	rk_litmus_cond_func forbidden;
+	/** @brief Shared state given to the threads. */
+	void *state;
+	/** @brief Number of times the threads are run. */
+	unsigned long iterations;
+} rk_litmus_opts_t;
+
+/**
+ * @brief Outcome of a litmus test.
+ */
+typedef struct
+{
+	/** @brief Registers observed by the threads. */
+	long regs[RK_LITMUS_MAX_THREADS * RK_LITMUS_REGS];
+	/** @brief Number of iterations ending with this outcome. */
+	unsigned long count;
+	/** @brief 1 if the outcome is forbidden. */
+	int forbidden;
+	char padding[4];
+} rk_litmus_outcome_t;
+
+/**
+ * @brief Histogram of the outcomes observed by @ref rk_litmus.
+ */
+typedef struct
+{
+	/** @brief Distinct outcomes, in the order they have been observed. */
+	rk_litmus_outcome_t outcomes[RK_LITMUS_MAX_OUTCOMES];
+	/** @brief Number of distinct outcomes. */
+	size_t noutcomes;
+	/** @brief Number of iterations. */
+	unsigned long iterations;
+	/** @brief Iterations ending with a forbidden outcome. */
+	unsigned long forbidden;
+	/** @brief Iterations whose outcome didn't fit the histogram. */
+	unsigned long dropped;
+	/** @brief Duration of the test in nanoseconds. */
+	unsigned long long duration_ns;
+	/** @brief Number of threads. */
+	unsigned int threads;
+	/** @brief 1 if each thread has been pinned to a different CPU. */
+	int pinned;
+} rk_litmus_result_t;
+
+/**
+ * @brief Run a memory model litmus test.
+ *
+ * Threads are pinned to different cores when possible and run
+ * `iterations` times. A spin barrier synchronizes the start of each
+ * iteration, then each thread is delayed by a few cycles, which change
+ * from one iteration to the next, so that reordering windows are hit in a
+ * reproducible way. The registers observed by the threads are collected
+ * in a histogram of outcomes.
+ *
+ * @param opts Litmus test options.
+ * @param res Histogram of the outcomes.
+ * @return 0 on success, -1 on error and errno is set.
+ */
+int rk_litmus(const rk_litmus_opts_t *opts, rk_litmus_result_t *res);
+
+void rk_litmus_report_(const char *file, const int lineno,
+		const rk_litmus_result_t *res);
+
+/**
+ * @brief Print the histogram of the outcomes of a litmus test.
+ *
+ * @param res Pointer to the result of @ref rk_litmus.
+ */
+#define rk_litmus_report(res) \
+	rk_litmus_report_(__FILE__, __LINE__, (res))
+
+/**
+ * @brief Verify that a litmus test never observed a forbidden outcome.
+ *
+ * @param res Pointer to the result of @ref rk_litmus.
+ */
+#define rk_check_litmus(res) \
+do { \
+	const rk_litmus_result_t *_ck_res = (res); \
+	if (!_ck_res->forbidden) { \
+		rk_result(TPASS, "no forbidden outcome in %lu iterations " \
+			"(%zu outcomes)", _ck_res->iterations, \
+			_ck_res->noutcomes); \
+	} else { \
+		rk_litmus_report(_ck_res); \
+		rk_result(TFAIL, "forbidden outcome in %lu of %lu " \
+			"iterations", _ck_res->forbidden, \
+			_ck_res->iterations); \
+	} \
+} while(0)
+
+/**
+ * @brief Statistics of a benchmark.
+ */
+typedef struct
+{
+	/** @brief Fastest run in nanoseconds. */
+	unsigned long long min_ns;
+	/** @brief Slowest run in nanoseconds. */
+	unsigned long long max_ns;
+	/** @brief Average run time in nanoseconds. */
+	unsigned long long mean_ns;
+	/** @brief Median run time in nanoseconds. */
+	unsigned long long median_ns;
+	/** @brief Standard deviation of the run time in nanoseconds. */
+	unsigned long long stddev_ns;
+	/** @brief Number of runs. */
+	size_t runs;
+} rk_bench_stats_t;
+
+/**
+ * @brief Compute the statistics of a benchmark.
+ *
+ * @param samples Duration of each run in nanoseconds.
+ * @param count Number of runs.
+ * @param stats Computed statistics.
+ * @return 0 on success, -1 on error and errno is set.
+ */
+int rk_bench_stats(const unsigned long long *samples, size_t count,
+		rk_bench_stats_t *stats);
+
+void rk_bench_report_(const char *file, const int lineno, const char *name,
+		const rk_bench_stats_t *stats);
+
+/**
+ * @brief Print the statistics of a benchmark.
+ *
+ * @param name Name of the benchmark.
+ * @param stats Benchmark statistics.
+ */
+#define rk_bench_report(name, stats) \
+	rk_bench_report_(__FILE__, __LINE__, (name), (stats))
+
+/**
+ * @brief Reference kernels measured by @ref rk_calibrate.
+ */
+typedef enum
+{
+	/** @brief Dependent integer multiply and shift loop. */
+	RK_CALIB_ALU = 0,
+	/** @brief STREAM triad over arrays bigger than the caches. */
+	RK_CALIB_STREAM,
+	/** @brief Random pointer chasing over a 32 MB chain. */
+	RK_CALIB_LATENCY,
+	/** @brief getppid() system call round trips. */
+	RK_CALIB_SYSCALL,
+	RK_CALIB_COUNT,
+} rk_calib_kernel_t;
+
+/**
+ * @brief Fingerprint of the machine running the benchmarks.
+ */
+typedef struct
+{
+	/** @brief Median duration of each reference kernel in nanoseconds. */
+	unsigned long long kernel_ns[RK_CALIB_COUNT];
+	/**
+	 * @brief Speed of the machine relative to the reference one, as the
+	 * geometric mean of the kernels speedups.
+	 */
+	double speed;
+	/** @brief CPU model of the machine. */
+	char cpu[128];
+} rk_calib_t;
+
+/**
+ * @brief Measure the reference kernels on the current machine.
+ *
+ * When RIKER_CALIBRATION is defined, the suite calibrates the machine
+ * before running and stores the fingerprint inside the file it points to.
+ * The file keeps a fingerprint for each CPU model, so hosts of different
+ * kinds can share it, and the machine is only measured when its CPU model
+ * has none yet.
+ *
+ * @param calib Fingerprint of the machine.
+ * @return 0 on success, -1 on error and errno is set.
+ */
+int rk_calibrate(rk_calib_t *calib);
+
+/**
+ * @brief Fingerprint of the machine running the suite.
+ *
+ * @return Fingerprint measured or loaded at the start of the suite, NULL if
+ * RIKER_CALIBRATION is not defined.
+ */
+const rk_calib_t *rk_calibration(void) __attribute__ ((pure));
+
+/**
+ * @brief Normalized score of a benchmark.
+ *
+ * The score is the median duration the benchmark would have on the
+ * reference machine, so it can be compared with baselines recorded on
+ * other hosts.
+ *
+ * @param stats Statistics of the benchmark.
+ * @return Score in reference nanoseconds, a negative value if the suite is
+ * not calibrated.
+ */
+double rk_bench_score(const rk_bench_stats_t *stats) __attribute__ ((pure));
+
+/**
+ * @brief Verify that a benchmark is not slower than a shared baseline.
+ *
+ * Return a TSKIP if the suite is not calibrated.
+ *
+ * @param stats Pointer to the statistics of the benchmark.
+ * @param baseline Maximum score, in reference nanoseconds.
+ */
+#define rk_check_bench_score_le(stats, baseline) \
+do { \
+	double _ck_score = rk_bench_score(stats); \
+	double _ck_baseline = (double)(baseline); \
+	if (_ck_score < 0) { \
+		rk_result(TSKIP, "benchmark is not calibrated"); \
+	} else if (_ck_score <= _ck_baseline) { \
+		rk_result(TPASS, "score %.0f <= %s", _ck_score, #baseline); \
+	} else { \
+		rk_result(TFAIL, "score %.0f <= %s", _ck_score, #baseline); \
+	} \
+} while(0)
+
+/**
+ * @brief Options of @ref rk_bench_io.
+ */
+typedef struct
+{
+	/**
+	 * @brief File used by the benchmark. It's overwritten. When NULL, a
+	 * temporary file is created inside /var/tmp.
+	 */
+	const char *path;
+	/**
+	 * @brief Size of the file. With O_DIRECT it has to be a multiple of
+	 * `block_size`.
+	 */
+	size_t file_size;
+	/**
+	 * @brief Size of each read or write. With O_DIRECT it has to be a
+	 * multiple of 4096, which covers the logical block size of the devices.
+	 */
+	size_t block_size;
+	/** @brief Number of runs, each one transferring the whole file. */
+	unsigned long runs;
+	/** @brief Use O_DIRECT, when supported by the filesystem. */
+	int direct;
+	/** @brief Benchmark writes instead of reads. */
+	int write;
+} rk_bench_io_opts_t;
+
+/**
+ * @brief Result of @ref rk_bench_io.
+ */
+typedef struct
+{
+	/** @brief Duration statistics of the runs. */
+	rk_bench_stats_t stats;
+	/** @brief Throughput of the median run in MB/s. */
+	unsigned long long mb_per_sec;
+	/** @brief I/O operations per second of the median run. */
+	unsigned long long iops;
+	/** @brief Pages which were still cached before the runs. */
+	size_t cached_pages;
+	/** @brief 1 if page cache was verified to be empty before all runs. */
+	int cold;
+	/** @brief 1 if O_DIRECT has been used. */
+	int direct;
+} rk_bench_io_result_t;
+
+/**
+ * @brief Create a file filled with non-zero data.
+ *
+ * @param path Path of the file.
+ * @param size Size of the file.
+ * @return 0 on success, -1 on error and errno is set.
+ */
+int rk_bench_file_prepare(const char *path, size_t size);
+
+/**
+ * @brief Drop a file from the page cache.
+ *
+ * File data is written back with fdatasync() and dropped with
+ * posix_fadvise(POSIX_FADV_DONTNEED). Then mincore() verifies that no pages
+ * are cached anymore.
+ *
+ * @param path Path of the file.
+ * @param resident Number of pages which are still cached. It can be NULL.
+ * @return 0 on success, -1 on error and errno is set.
+ */
+int rk_bench_drop_cache(const char *path, size_t *resident);
+
+/**
+ * @brief Benchmark sequential I/O on a file with a cold page cache.
+ *
+ * The file is prepared once, then it's dropped from the page cache before
+ * each run. Writes are followed by fdatasync() inside the measured time.
+ *
+ * @param opts Benchmark options.
+ * @param res Benchmark result.
+ * @return 0 on success, -1 on error and errno is set.
+ */
+int rk_bench_io(const rk_bench_io_opts_t *opts, rk_bench_io_result_t *res);
+
+void rk_bench_io_report_(const char *file, const int lineno, const char *name,
+		const rk_bench_io_result_t *res);
+
+/**
+ * @brief Print the statistics of an I/O benchmark, with MB/s and IOPS.
+ *
+ * @param name Name of the benchmark.
+ * @param res Pointer to the result of @ref rk_bench_io.
+ */
+#define rk_bench_io_report(name, res) \
+	rk_bench_io_report_(__FILE__, __LINE__, (name), (res))
+
+/**
+ * @brief Maximum number of working sets measured by
+ * @ref rk_bench_mem_latency.
+ */
+#define RK_MEM_LATENCY_SIZES 32
+
+/**
+ * @brief Options of @ref rk_bench_mem_latency.
+ */
+typedef struct
+{
+	/** @brief Smallest working set in bytes, 0 for 4 KB. */
+	size_t min_size;
+	/** @brief Biggest working set in bytes, 0 for 1 GB. */
+	size_t max_size;
+	/** @brief Loads measured for each working set, 0 for 1M. */
+	unsigned long loads;
+} rk_bench_mem_latency_opts_t;
+
+/**
+ * @brief Result of @ref rk_bench_mem_latency.
+ */
+typedef struct
+{
+	/** @brief Size of each working set in bytes. */
+	size_t size[RK_MEM_LATENCY_SIZES];
+	/** @brief Average latency of a load for each working set. */
+	double ns[RK_MEM_LATENCY_SIZES];
+	/** @brief Number of measured working sets. */
+	size_t count;
+} rk_bench_mem_latency_result_t;
+
+/**
+ * @brief Measure the load latency of the memory hierarchy.
+ *
+ * Working sets double from `min_size` up to `max_size`. Each one is a chain
+ * of pointers, one per cache line, visited in a random order, so every load
+ * depends on the previous one and prefetchers can't guess the next line.
+ * Working sets which can't be allocated end the measure.
+ *
+ * @param opts Benchmark options. It can be NULL.
+ * @param res Latency of each working set.
+ * @return 0 on success, -1 on error and errno is set.
+ */
+int rk_bench_mem_latency(const rk_bench_mem_latency_opts_t *opts,
+		rk_bench_mem_latency_result_t *res);
+
+void rk_bench_mem_latency_report_(const char *file, const int lineno,
+		const rk_bench_mem_latency_result_t *res);
+
+/**
+ * @brief Print the load latency of each working set.
+ *
+ * @param res Pointer to the result of @ref rk_bench_mem_latency.
+ */
+#define rk_bench_mem_latency_report(res) \
+	rk_bench_mem_latency_report_(__FILE__, __LINE__, (res))
+
+/**
+ * @brief STREAM kernels measured by @ref rk_bench_mem_bandwidth.
+ */
+typedef enum
+{
+	/** @brief c[i] = a[i] */
+	RK_MEM_COPY = 0,
+	/** @brief b[i] = s * c[i] */
+	RK_MEM_SCALE,
+	/** @brief c[i] = a[i] + b[i] */
+	RK_MEM_ADD,
+	/** @brief a[i] = b[i] + s * c[i] */
+	RK_MEM_TRIAD,
+	RK_MEM_KERNELS,
+} rk_mem_kernel_t;
+
+/**
+ * @brief Options of @ref rk_bench_mem_bandwidth.
+ */
+typedef struct
+{
+	/** @brief Size of each of the three arrays, 0 for 64 MB. */
+	size_t size;
+	/** @brief Runs of each kernel, 0 for 5. */
+	unsigned long runs;
+	/**
+	 * @brief Threads sharing the arrays, 0 for one per CPU where the
+	 * process can run.
+	 */
+	unsigned int threads;
+	/** @brief Pin each thread to its own CPU. */
+	int pin;
+} rk_bench_mem_bandwidth_opts_t;
+
+/**
+ * @brief Result of @ref rk_bench_mem_bandwidth.
+ */
+typedef struct
+{
+	/** @brief Bandwidth of the fastest run of each kernel in MB/s. */
+	unsigned long long mb_per_sec[RK_MEM_KERNELS];
+	/** @brief Highest bandwidth of all the kernels in MB/s. */
+	unsigned long long peak_mb_per_sec;
+	/** @brief Number of threads which ran the kernels. */
+	unsigned int threads;
+	/** @brief 1 if each thread has been pinned to its own CPU. */
+	int pinned;
+} rk_bench_mem_bandwidth_result_t;
+
+/**
+ * @brief Measure the memory bandwidth with the STREAM kernels.
+ *
+ * Each thread initializes and works on its own slice of the arrays, so
+ * memory is local to the thread. Threads start each run together. Like
+ * STREAM, the fastest run of each kernel is kept. The peak bandwidth is
+ * remembered by the process for @ref rk_bench_peak_percent.
+ *
+ * @param opts Benchmark options. It can be NULL.
+ * @param res Bandwidth of each kernel.
+ * @return 0 on success, -1 on error and errno is set.
+ */
+int rk_bench_mem_bandwidth(const rk_bench_mem_bandwidth_opts_t *opts,
+		rk_bench_mem_bandwidth_result_t *res);
+
+void rk_bench_mem_bandwidth_report_(const char *file, const int lineno,
+		const rk_bench_mem_bandwidth_result_t *res);
+
+/**
+ * @brief Print the bandwidth of each STREAM kernel.
+ *
+ * @param res Pointer to the result of @ref rk_bench_mem_bandwidth.
+ */
+#define rk_bench_mem_bandwidth_report(res) \
+	rk_bench_mem_bandwidth_report_(__FILE__, __LINE__, (res))
+
+/**
+ * @brief Bandwidth of a benchmark as a percentage of the peak one.
+ *
+ * @param stats Statistics of the benchmark.
+ * @param bytes Bytes moved by each run of the benchmark.
+ * @return Bandwidth of the median run in percent of the peak bandwidth
+ * measured by the last @ref rk_bench_mem_bandwidth, a negative value if
+ * the peak bandwidth has not been measured.
+ */
+double rk_bench_peak_percent(const rk_bench_stats_t *stats, size_t bytes)
+	__attribute__ ((pure));
+
+/**
+ * @brief Phase of a test whose I/O is accounted.
+ */
+typedef enum
+{
+	/** @brief Test setup. */
+	RK_IO_SETUP = 0,
+	/** @brief Test execution. */
+	RK_IO_RUN,
+	/** @brief Test teardown. */
+	RK_IO_TEARDOWN,
+	/** @brief All the phases of the test. */
+	RK_IO_TOTAL,
+} rk_io_block_t;
+
+/**
+ * @brief I/O counters of a test, as reported by /proc/self/io.
+ */
+typedef struct
+{
+	/** @brief Bytes read by read-like system calls. */
+	unsigned long long rchar;
+	/** @brief Bytes written by write-like system calls. */
+	unsigned long long wchar;
+	/** @brief Number of read-like system calls. */
+	unsigned long long syscr;
+	/** @brief Number of write-like system calls. */
+	unsigned long long syscw;
+	/** @brief Bytes fetched from the storage layer. */
+	unsigned long long read_bytes;
+	/** @brief Bytes sent to the storage layer. */
+	unsigned long long write_bytes;
+} rk_io_t;
+
+/** @brief Number of counters inside @ref rk_io_t. */
+#define RK_IO_FIELDS (sizeof(rk_io_t) / sizeof(unsigned long long))
+
+/**
+ * @brief Read the I/O done by the current test.
+ *
+ * Counters are collected around each phase of the test. The phase which is
+ * currently running is accounted up to now.
+ *
+ * @param block Phase of the test.
+ * @param io I/O counters of the phase.
+ * @return 0 on success, -1 on error and errno is set.
+ */
+int rk_io_usage(rk_io_block_t block, rk_io_t *io);
+
+/**
+ * @brief Verify that a test didn't exceed an I/O budget.
+ *
+ * Return a TSKIP if I/O accounting is not available.
+ *
+ * @param block Phase of the test, as defined by @ref rk_io_block_t.
+ * @param field Counter of @ref rk_io_t, such as `write_bytes`.
+ * @param limit Maximum value of the counter.
+ */
+#define rk_check_io_le(block, field, limit) \
+do { \
+	rk_io_t _ck_io; \
+	unsigned long long _ck_limit = (unsigned long long)(limit); \
+	if (rk_io_usage(block, &_ck_io)) { \
+		rk_result(TSKIP, "I/O accounting is not available"); \
+	} else if (_ck_io.field <= _ck_limit) { \
+		rk_result(TPASS, "%s %s %llu <= %s", #block, #field, \
+			_ck_io.field, #limit); \
+	} else { \
+		rk_result(TFAIL, "%s %s %llu <= %s", #block, #field, \
+			_ck_io.field, #limit); \
+	} \
+} while(0)
+
+/**
+ * @brief ISA levels of the kernels selected at runtime.
+ */
+typedef enum
+{
+	RK_ISA_SCALAR = 0,
+	RK_ISA_SSE2,
+	RK_ISA_AVX2,
+	RK_ISA_AVX512,
+	RK_ISA_COUNT,
+} rk_isa_t;
+
+/**
+ * @brief Force a dispatch point to use the kernels of an ISA level.
+ *
+ * @param isa ISA level to use.
+ * @param data User data given to @ref rk_isa_register.
+ * @return 0 on success, -1 if the dispatch point has no kernel for the ISA
+ * level.
+ */
+typedef int (*rk_isa_select_func)(rk_isa_t isa, void *data);
+
+/**
+ * @brief Read the ISA level of the kernels a dispatch point is using.
+ *
+ * @param data User data given to @ref rk_isa_register.
+ * @return ISA level in use.
+ */
+typedef rk_isa_t (*rk_isa_query_func)(void *data);
+
+/**
+ * @brief Register a dispatch point of the code under test.
+ *
+ * Dispatch points have to be registered before the tests using them start,
+ * for example during the suite setup. Registering a dispatch point with the
+ * same name replaces it.
+ *
+ * After a @ref RK_TEST_ISA_SWEEP test, each dispatch point is given back the
+ * ISA level returned by `query` before the test. Without `query`, the
+ * highest ISA level the dispatch point accepts is used.
+ *
+ * @param name Name of the dispatch point.
+ * @param select Function forcing the ISA level of the dispatch point.
+ * @param query Function reading the ISA level of the dispatch point, or
+ * NULL.
+ * @param data User data given to `select` and `query`.
+ * @return 0 on success, -1 on error, setting errno.
+ */
+int rk_isa_register(const char *name, rk_isa_select_func select,
+		rk_isa_query_func query, void *data);
+
+/**
+ * @brief Name of an ISA level.
+ *
+ * @param isa ISA level.
+ * @return Name of the ISA level, such as "avx2".
+ */
+const char *rk_isa_name(rk_isa_t isa) __attribute__ ((const));
+
+/**
+ * @brief Check if the CPU supports an ISA level.
+ *
+ * @param isa ISA level.
+ * @return 1 if the ISA level is supported, 0 otherwise.
+ */
+int rk_isa_supported(rk_isa_t isa) __attribute__ ((pure));
+
+/**
+ * @brief ISA level which the dispatch points are forced to.
+ *
+ * @return ISA level of the running variant of a @ref RK_TEST_ISA_SWEEP
+ * test, the highest supported ISA level otherwise.
+ */
+rk_isa_t rk_isa_current(void) __attribute__ ((pure));
+
+/**
+ * @brief Record a benchmark of the running ISA variant.
+ *
+ * When all the variants of the test completed, a table is printed with the
+ * median time of each kernel and its speedup over the scalar variant.
+ *
+ * @param name Name of the kernel.
+ * @param stats Statistics of the benchmark, see @ref rk_bench_stats.
+ */
+void rk_isa_report(const char *name, const rk_bench_stats_t *stats);
+
+/**
+ * @brief Allocate memory released automatically when the test completes.
+ *
+ * Memory comes from an arena of the thread running the test, which is
+ * released at once after the test teardown, so it doesn't have to be freed.
+ * When RIKER_ARENA_POISON is defined, released memory is filled with 0xa5.
+ *
+ * @param size Size of the memory.
+ * @param align Alignment of the memory, a power of two. 0 uses the
+ * alignment of malloc().
+ * @return Pointer to the memory, NULL on error, setting errno.
+ */
+void *rk_arena_alloc(size_t size, size_t align)
+		__attribute__ ((malloc, alloc_size (1)));
+
+/**
+ * @brief Function receiving the output of the tests.
+ *
+ * @param buf Output, which is not NUL terminated.
+ * @param len Length of the output.
+ * @param data Data given to @ref rk_output_callback.
+ */
+typedef void (*rk_output_func)(const char *buf, size_t len, void *data);
+
+/**
+ * @brief Write the output of the tests to a file descriptor.
+ *
+ * Output is buffered and written with a single writev() when each test
+ * completes, so a test costs one system call regardless of the number of its
+ * checks. Terminals are written at the end of each line instead. By default,
+ * output is written to the standard output, or to the file defined by the
+ * RIKER_OUTPUT variable.
+ *
+ * Colors are used on terminals. The RIKER_COLOR variable forces them when
+ * it's "always" and disables them when it's "never", otherwise a non-empty
+ * NO_COLOR variable disables them.
+ *
+ * @param fd File descriptor, which is left open.
+ * @return 0 on success, -1 on error and errno is set.
+ */
+int rk_output_fd(int fd);
+
+/**
+ * @brief Write the output of the tests to a file, truncating it.
+ *
+ * See @ref rk_output_fd.
+ *
+ * @param path Path of the file.
+ * @return 0 on success, -1 on error and errno is set.
+ */
+int rk_output_file(const char *path);
+
+/**
+ * @brief Give the output of the tests to a function, without colors.
+ *
+ * The function is called when each test completes, once for each chunk of
+ * the buffered output. Tests running on the pool of threads call it from
+ * their own thread, at the same time.
+ *
+ * @param func Function receiving the output.
+ * @param data Data passed to `func`.
+ * @return 0 on success, -1 on error and errno is set.
+ */
+int rk_output_callback(rk_output_func func, void *data);
+
+/**
+ * @brief Check if the output of the tests is colored.
+ *
+ * @return 1 if colors are used, 0 otherwise.
+ */
+int rk_output_color(void) __attribute__ ((pure));
+
+/**
+ * @brief Testing suite declaration.
+ *
+ * Override this object in order to declare your own testing suite. C++
+ * doesn't allow tentative definitions, so C++ tests define it without the
+ * `static` keyword.
+ */
+#ifdef __cplusplus
+extern rk_suite_t test_suite;
+#else
+static rk_suite_t test_suite __attribute__((unused));
+#endif
+
+/**
+ * @brief Run a testing suite.
+ *
+ * Run all tests inside a testing suite and return the ending result.
+ *
+ * @param suite Testing suite object.
+ */
+void rk_run_suite(rk_suite_t *suite);
+
+#ifdef __cplusplus
+}
+#endif
 
 #ifndef TEST_CUSTOM_MAIN
 
@@ -0,0 +1,585 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) 2025 Andrea Cervesato <andrea.cervesato@mailbox.org>
+ */
+
+#ifndef RIKER_HPP
+#define RIKER_HPP
+
+#if __cplusplus < 201103L
+#error "riker.hpp requires C++11 or later"
+#endif
+
+#include "riker.h"
+#include <exception>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+/**
+ * @file riker.hpp
+ * @brief C++ front-end of riker.
+ *
+ * Tests written in C++ share the runner and the reporters of the C library,
+ * this header only adds:
+ *
+ * - comparison checks which accept any type, replacing the numeric
+ *   `rk_check_*` macros of riker.h. The comparison is inlined, values are
+ *   formatted by @ref riker::formatter only when the check fails.
+ * - RAII fixtures, mapping constructors and destructors onto the `setup` and
+ *   `teardown` functions of @ref rk_test_t and @ref rk_suite_t.
+ *
+ * Since the suite can't be declared twice in C++, it's defined without the
+ * `static` keyword:
+ *
+ * @code
+ * struct tmp_file {
+ *	tmp_file() { ... }
+ *	~tmp_file() { ... }
+ *	void write_read() { rk_check_eq(read_back(), std::string("data")); }
+ * };
+ *
+ * static rk_test_t tests[] = {
+ *	riker::test<tmp_file, &tmp_file::write_read>("write_read"),
+ *	riker::test<check_version>("version"),
+ *	{},
+ * };
+ *
+ * rk_suite_t test_suite = riker::suite(tests);
+ * @endcode
+ */
+
+namespace riker {
+
+namespace detail {
+
+template <typename T>
+class is_streamable
+{
+	template <typename U>
+	static auto test(int) -> decltype(std::declval<std::ostream &>() <<
+		std::declval<const U &>(), std::true_type());
+
+	template <typename U>
+	static std::false_type test(...);
+
+public:
+	static constexpr bool value = decltype(test<T>(0))::value;
+};
+
+template <typename T>
+std::string stream_value(const T &value, std::true_type)
+{
+	std::ostringstream out;
+
+	out << value;
+
+	return out.str();
+}
+
+template <typename T>
+std::string stream_value(const T &value, std::false_type)
+{
+	(void)value;
+
+	return "<" + std::to_string(sizeof(T)) + "-byte object>";
+}
+
+} /* namespace detail */
+
+/**
+ * @brief Format values of failed checks.
+ *
+ * Values are shown through their `operator<<` when they have one. Specialize
+ * this template to show user types which can't be streamed, or to show them
+ * differently inside the test reports:
+ *
+ * @code
+ * template <>
+ * struct riker::formatter<point> {
+ *	static std::string format(const point &p)
+ *	{
+ *		return "(" + std::to_string(p.x) + ", " +
+ *			std::to_string(p.y) + ")";
+ *	}
+ * };
+ * @endcode
+ */
+template <typename T, typename Enable = void>
+struct formatter
+{
+	static std::string format(const T &value)
+	{
+		return detail::stream_value(value, std::integral_constant<bool,
+			detail::is_streamable<T>::value>());
+	}
+};
+
+/** @brief Booleans are shown as `true` and `false`. */
+template <>
+struct formatter<bool>
+{
+	static std::string format(bool value)
+	{
+		return value ? "true" : "false";
+	}
+};
+
+/** @brief Small integers are shown as numbers, not as characters. */
+template <typename T>
+struct formatter<T, typename std::enable_if<
+	std::is_same<T, signed char>::value ||
+	std::is_same<T, unsigned char>::value>::type>
+{
+	static std::string format(T value)
+	{
+		return std::to_string(static_cast<int>(value));
+	}
+};
+
+/** @brief Enums are shown through their underlying value. */
+template <typename T>
+struct formatter<T, typename std::enable_if<std::is_enum<T>::value>::type>
+{
+	static std::string format(T value)
+	{
+		return std::to_string(static_cast<
+			typename std::underlying_type<T>::type>(value));
+	}
+};
+
+/** @brief C strings are shown between quotes, like std::string. */
+template <>
+struct formatter<const char *>
+{
+	static std::string format(const char *value)
+	{
+		return value ? "\"" + std::string(value) + "\"" : "NULL";
+	}
+};
+
+template <>
+struct formatter<char *> : formatter<const char *>
+{
+};
+
+template <>
+struct formatter<std::string>
+{
+	static std::string format(const std::string &value)
+	{
+		return "\"" + value + "\"";
+	}
+};
+
+template <>
+struct formatter<std::nullptr_t>
+{
+	static std::string format(std::nullptr_t)
+	{
+		return "nullptr";
+	}
+};
+
+/**
+ * @brief Format a value through its @ref formatter.
+ *
+ * Arrays are formatted as the pointer they decay to.
+ */
+template <typename T>
+std::string format(const T &value)
+{
+	return formatter<typename std::decay<T>::type>::format(value);
+}
+
+namespace detail {
+
+struct cmp_eq
+{
+	template <typename A, typename B>
+	static bool test(const A &a, const B &b) { return a == b; }
+};
+
+struct cmp_ne
+{
+	template <typename A, typename B>
+	static bool test(const A &a, const B &b) { return a != b; }
+};
+
+struct cmp_gt
+{
+	template <typename A, typename B>
+	static bool test(const A &a, const B &b) { return a > b; }
+};
+
+struct cmp_ge
+{
+	template <typename A, typename B>
+	static bool test(const A &a, const B &b) { return a >= b; }
+};
+
+struct cmp_lt
+{
+	template <typename A, typename B>
+	static bool test(const A &a, const B &b) { return a < b; }
+};
+
+struct cmp_le
+{
+	template <typename A, typename B>
+	static bool test(const A &a, const B &b) { return a <= b; }
+};
+
+/*
+ * Reporters of the checks have internal linkage, like RK_TST_RES itself, so
+ * each translation unit updates its own result.
+ */
+namespace {
+
+__attribute__((noinline, unused))
+void check_pass(const char *file, int lineno, const char *a_name,
+		const char *op, const char *b_name)
+{
+	RK_TST_RES = TPASS;
+	rk_result_(file, lineno, TPASS, "%s %s %s", a_name, op, b_name);
+}
+
+template <typename A, typename B>
+__attribute__((cold, noinline))
+void check_fail(const char *file, int lineno, const char *a_name,
+		const char *op, const char *b_name, const A &a, const B &b)
+{
+	const std::string a_value = ::riker::format(a);
+	const std::string b_value = ::riker::format(b);
+
+	RK_TST_RES = TFAIL;
+	rk_result_(file, lineno, TFAIL, "%s %s %s (%s = %s, %s = %s)", a_name,
+		op, b_name, a_name, a_value.c_str(), b_name, b_value.c_str());
+}
+
+template <typename Cmp, typename A, typename B>
+inline void check(const char *file, int lineno, const char *a_name,
+		const char *op, const char *b_name, const A &a, const B &b)
+{
+	if (__builtin_expect(Cmp::test(a, b), 1))
+		check_pass(file, lineno, a_name, op, b_name);
+	else
+		check_fail(file, lineno, a_name, op, b_name, a, b);
+}
+
+} /* namespace */
+
+/* Where a test or a suite was declared, to report its errors */
+struct origin
+{
+	const char *name;
+	const char *file;
+	int line;
+};
+
+__attribute__((cold))
+inline void report_exception(const origin &from, const char *phase,
+		const char *what)
+{
+	const char *file = from.file ? from.file : __FILE__;
+	int line = from.file ? from.line : __LINE__;
+
+	if (from.name) {
+		rk_result_(file, line, TERROR,
+			"%s: uncaught exception in %s: %s", from.name, phase,
+			what);
+	} else {
+		rk_result_(file, line, TERROR, "Uncaught exception in %s: %s",
+			phase, what);
+	}
+}
+
+/*
+ * Exceptions can't cross the C runner, they become errors of the test. The
+ * runner calls `teardown` on errors, so fixtures are released as usual.
+ */
+template <typename Func>
+void guard(const origin &from, const char *phase, Func func) noexcept
+{
+	try {
+		func();
+	} catch (const std::exception &e) {
+		report_exception(from, phase, e.what());
+	} catch (...) {
+		report_exception(from, phase, "unknown exception");
+	}
+}
+
+/*
+ * Tests of the pool run on many threads at the same time, so each thread
+ * has its own instance of the fixture.
+ */
+template <typename F, void (F::*Run)()>
+struct test_method
+{
+	static origin &from()
+	{
+		static origin declared;
+
+		return declared;
+	}
+
+	static F *&instance()
+	{
+		static thread_local F *fixture;
+
+		return fixture;
+	}
+
+	static void setup()
+	{
+		guard(from(), "setup", [] { instance() = new F(); });
+	}
+
+	/* called twice when the test reported an error */
+	static void teardown()
+	{
+		F *fixture = instance();
+
+		instance() = nullptr;
+		guard(from(), "teardown", [fixture] { delete fixture; });
+	}
+
+	static void run()
+	{
+		F *fixture = instance();
+
+		if (fixture)
+			guard(from(), "test", [fixture] { (fixture->*Run)(); });
+	}
+};
+
+template <void (*Run)()>
+struct test_function
+{
+	static origin &from()
+	{
+		static origin declared;
+
+		return declared;
+	}
+
+	static void run()
+	{
+		guard(from(), "test", [] { Run(); });
+	}
+};
+
+/* the suite fixture is shared by all the threads running the tests */
+template <typename S>
+struct suite_fixture
+{
+	static origin &from()
+	{
+		static origin declared;
+
+		return declared;
+	}
+
+	static S *&instance()
+	{
+		static S *fixture;
+
+		return fixture;
+	}
+
+	static void setup()
+	{
+		guard(from(), "suite setup", [] { instance() = new S(); });
+	}
+
+	static void teardown()
+	{
+		S *fixture = instance();
+
+		instance() = nullptr;
+		guard(from(), "suite teardown", [fixture] { delete fixture; });
+	}
+};
+
+} /* namespace detail */
+
+/**
+ * @brief Declare a test running a method of a fixture.
+ *
+ * A new `F` is constructed before the test and destroyed after it, inside
+ * the `setup` and `teardown` functions of the test. Uncaught exceptions are
+ * reported as errors of the test, with its name and the place where it's
+ * declared.
+ *
+ * @param name Name of the test.
+ * @param flags Combination of the RK_TEST_* flags.
+ * @param file Source file declaring the test, filled by the compiler.
+ * @param line Line declaring the test, filled by the compiler.
+ * @return The test, to be placed inside the tests of the suite.
+ */
+template <typename F, void (F::*Run)()>
+rk_test_t test(const char *name = nullptr, unsigned long flags = 0,
+		const char *file = __builtin_FILE(), int line = __builtin_LINE())
+{
+	rk_test_t test = {};
+
+	detail::test_method<F, Run>::from() = { name, file, line };
+
+	test.setup = detail::test_method<F, Run>::setup;
+	test.run = detail::test_method<F, Run>::run;
+	test.teardown = detail::test_method<F, Run>::teardown;
+	test.name = name;
+	test.flags = flags;
+
+	return test;
+}
+
+/**
+ * @brief Declare a test running a function.
+ *
+ * Uncaught exceptions are reported as errors of the test, with its name and
+ * the place where it's declared.
+ *
+ * @param name Name of the test.
+ * @param flags Combination of the RK_TEST_* flags.
+ * @param file Source file declaring the test, filled by the compiler.
+ * @param line Line declaring the test, filled by the compiler.
+ * @return The test, to be placed inside the tests of the suite.
+ */
+template <void (*Run)()>
+rk_test_t test(const char *name = nullptr, unsigned long flags = 0,
+		const char *file = __builtin_FILE(), int line = __builtin_LINE())
+{
+	rk_test_t test = {};
+
+	detail::test_function<Run>::from() = { name, file, line };
+
+	test.run = detail::test_function<Run>::run;
+	test.name = name;
+	test.flags = flags;
+
+	return test;
+}
+
+/**
+ * @brief Declare a suite.
+ *
+ * @param tests List of the tests, terminated by an empty test.
+ * @return The suite, to be assigned to `test_suite`.
+ */
+inline rk_suite_t suite(rk_test_t *tests)
+{
+	rk_suite_t suite = {};
+
+	suite.tests = tests;
+
+	return suite;
+}
+
+/**
+ * @brief Declare a suite sharing a fixture between its tests.
+ *
+ * A single `S` is constructed before all the tests and destroyed after them.
+ * Tests access it through @ref suite_fixture.
+ *
+ * @param tests List of the tests, terminated by an empty test.
+ * @param file Source file declaring the suite, filled by the compiler.
+ * @param line Line declaring the suite, filled by the compiler.
+ * @return The suite, to be assigned to `test_suite`.
+ */
+template <typename S>
+rk_suite_t suite(rk_test_t *tests, const char *file = __builtin_FILE(),
+		int line = __builtin_LINE())
+{
+	rk_suite_t suite = {};
+
+	detail::suite_fixture<S>::from() = { nullptr, file, line };
+
+	suite.setup = detail::suite_fixture<S>::setup;
+	suite.teardown = detail::suite_fixture<S>::teardown;
+	suite.tests = tests;
+
+	return suite;
+}
+
+/**
+ * @brief Fixture of the suite declared by `riker::suite<S>()`.
+ *
+ * @return The fixture, which is only valid while the suite is running.
+ */
+template <typename S>
+S &suite_fixture()
+{
+	return *detail::suite_fixture<S>::instance();
+}
+
+} /* namespace riker */
+
+#define RK_CHECK_CMP_(a, b, op, cmp) \
+	::riker::detail::check< ::riker::detail::cmp>(__FILE__, __LINE__, \
+		#a, #op, #b, (a), (b))
+
+/*
+ * Numeric checks of riker.h rely on _Generic, which doesn't exist in C++.
+ * These ones accept any pair of comparable values.
+ */
+#undef rk_check_eq
+#undef rk_check_ne
+#undef rk_check_gt
+#undef rk_check_ge
+#undef rk_check_lt
+#undef rk_check_le
+
+/**
+ * @brief Verify that `a` is equal to `b`.
+ *
+ * On failure, both values are shown through @ref riker::formatter.
+ *
+ * @param a First value.
+ * @param b Second value.
+ */
+#define rk_check_eq(a, b) RK_CHECK_CMP_(a, b, ==, cmp_eq)
+
+/**
+ * @brief Verify that `a` is not equal to `b`.
+ *
+ * @param a First value.
+ * @param b Second value.
+ */
+#define rk_check_ne(a, b) RK_CHECK_CMP_(a, b, !=, cmp_ne)
+
+/**
+ * @brief Verify that `a` is greater than `b`.
+ *
+ * @param a First value.
+ * @param b Second value.
+ */
+#define rk_check_gt(a, b) RK_CHECK_CMP_(a, b, >, cmp_gt)
+
+/**
+ * @brief Verify that `a` is greater or equal than `b`.
+ *
+ * @param a First value.
+ * @param b Second value.
+ */
+#define rk_check_ge(a, b) RK_CHECK_CMP_(a, b, >=, cmp_ge)
+
+/**
+ * @brief Verify that `a` is lower than `b`.
+ *
+ * @param a First value.
+ * @param b Second value.
+ */
+#define rk_check_lt(a, b) RK_CHECK_CMP_(a, b, <, cmp_lt)
+
+/**
+ * @brief Verify that `a` is lower or equal than `b`.
+ *
+ * @param a First value.
+ * @param b Second value.
+ */
+#define rk_check_le(a, b) RK_CHECK_CMP_(a, b, <=, cmp_le)
+
+#endif
@@ -0,0 +1,191 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) 2025 Andrea Cervesato <andrea.cervesato@mailbox.org>
+ */
+
+#define _GNU_SOURCE
+
+#include "riker_internal.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <sys/mman.h>
+
+/* Size of the chunks mapped by the arena, unless a bigger one is needed */
+#define ARENA_CHUNK_SIZE (1024 * 1024)
+
+/* Pattern written on released memory when RIKER_ARENA_POISON is set */
+#define ARENA_POISON 0xa5
+
+/*
+ * Chunks are kept after a reset, so the next test reuses them without
+ * mapping memory again.
+ */
+typedef struct rk_chunk
+{
+	struct rk_chunk *next;
+	size_t size;
+} rk_chunk_t;
+
+typedef struct
+{
+	rk_chunk_t *first;
+	rk_chunk_t *current;
+	size_t offset;
+} rk_arena_t;
+
+static __thread rk_arena_t arena;
+
+static int poison = -1;
+
+void *rk_arena_chunk_(size_t size)
+{
+	void *chunk;
+
+	chunk = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	return chunk == MAP_FAILED ? NULL : chunk;
+}
+
+void rk_arena_unchunk_(void *chunk, size_t size)
+{
+	munmap(chunk, size);
+}
+
+static rk_chunk_t *map_chunk(size_t size)
+{
+	rk_chunk_t *chunk;
+
+	if (size < ARENA_CHUNK_SIZE)
+		size = ARENA_CHUNK_SIZE;
+
+	chunk = rk_arena_chunk_(size);
+	if (!chunk)
+		return NULL;
+
+	chunk->next = NULL;
+	chunk->size = size;
+
+	return chunk;
+}
+
+static size_t align_offset(const rk_chunk_t *chunk, size_t offset,
+		size_t align)
+{
+	uintptr_t addr = (uintptr_t)chunk + offset;
+
+	return offset + ((align - addr % align) % align);
+}
+
+void *rk_arena_alloc(size_t size, size_t align)
+{
+	rk_chunk_t *chunk;
+	size_t offset;
+
+	if (!align)
+		align = _Alignof(max_align_t);
+
+	if (align & (align - 1) || size > SIZE_MAX / 2) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	chunk = arena.current;
+	offset = arena.offset;
+
+	while (chunk) {
+		offset = align_offset(chunk, offset, align);
+		if (offset <= chunk->size && size <= chunk->size - offset)
+			break;
+
+		/* chunks kept by the last reset which can fit the data */
+		chunk = chunk->next;
+		offset = sizeof(rk_chunk_t);
+	}
+
+	if (!chunk) {
+		chunk = map_chunk(sizeof(rk_chunk_t) + size + align);
+		if (!chunk)
+			return NULL;
+
+		if (arena.current) {
+			chunk->next = arena.current->next;
+			arena.current->next = chunk;
+		} else {
+			arena.first = chunk;
+		}
+
+		offset = align_offset(chunk, sizeof(rk_chunk_t), align);
+	}
+
+	arena.current = chunk;
+	arena.offset = offset + size;
+
+	return (char *)chunk + offset;
+}
+
+static bool poison_enabled(void)
+{
+	if (poison == -1)
+		poison = getenv("RIKER_ARENA_POISON") != NULL;
+
+	return poison;
+}
+
+rk_arena_mark_t rk_arena_mark_(void)
+{
+	rk_arena_mark_t mark = {
+		.chunk = arena.current,
+		.offset = arena.offset,
+	};
+
+	return mark;
+}
+
+void rk_arena_rewind_(rk_arena_mark_t mark)
+{
+	rk_chunk_t *chunk = mark.chunk ? mark.chunk : arena.first;
+	size_t offset = mark.chunk ? mark.offset : sizeof(rk_chunk_t);
+
+	if (!chunk)
+		return;
+
+	/* use after reset reads the pattern instead of stale data */
+	if (poison_enabled()) {
+		for (rk_chunk_t *c = chunk; c; c = c->next) {
+			size_t start = c == chunk ? offset : sizeof(rk_chunk_t);
+			size_t end = c == arena.current ? arena.offset : c->size;
+
+			if (end > start)
+				memset((char *)c + start, ARENA_POISON, end - start);
+
+			if (c == arena.current)
+				break;
+		}
+	}
+
+	arena.current = chunk;
+	arena.offset = offset;
+}
+
+void rk_arena_reset_(void)
+{
+	rk_arena_mark_t mark = { .chunk = NULL, .offset = 0 };
+
+	rk_arena_rewind_(mark);
+}
+
+void rk_arena_release_(void)
+{
+	rk_chunk_t *chunk = arena.first;
+	rk_chunk_t *next;
+
+	while (chunk) {
+		next = chunk->next;
+		rk_arena_unchunk_(chunk, chunk->size);
+		chunk = next;
+	}
+
+	memset(&arena, 0, sizeof(rk_arena_t));
+}
@@ -0,0 +1,414 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) 2025 Andrea Cervesato <andrea.cervesato@mailbox.org>
+ */
+
+#include "riker_internal.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <ucontext.h>
+#include <sys/mman.h>
+#include <sys/epoll.h>
+
+/* Stack size of each asynchronous test */
+#define ASYNC_STACK_SIZE (256 * 1024)
+
+/* Default timeout of an asynchronous test in milliseconds */
+#define ASYNC_TIMEOUT 30000
+
+/* Number of events read from epoll at once */
+#define ASYNC_EVENTS 64
+
+typedef struct rk_async_watch rk_async_watch_t;
+
+struct rk_async_watch
+{
+	rk_async_t *owner;
+	rk_async_cb cb;
+	void *data;
+	rk_async_watch_t *next;
+	int fd;
+	unsigned int events;
+};
+
+struct rk_async
+{
+	rk_test_t *test;
+	void *stack;
+	rk_async_watch_t *watches;
+	unsigned long long deadline;
+	ucontext_t context;
+	int epfd;
+	unsigned int revents;
+	bool suspended;
+	bool returned;
+	bool done;
+	char padding[5];
+};
+
+static ucontext_t loop_context;
+static rk_async_t *async_starting;
+static rk_async_t *async_running;
+
+/*
+ * Removed watches are released only after processing the events returned by
+ * epoll_wait(), since some of these events might still refer to them.
+ */
+static rk_async_watch_t *async_removed;
+
+static void async_entry(void)
+{
+	rk_async_t *ctx = async_starting;
+
+	ctx->test->async(ctx);
+	ctx->returned = true;
+
+	/* uc_link brings us back to the event loop */
+}
+
+static void resume(rk_async_t *ctx)
+{
+	rk_async_t *prev = async_running;
+
+	async_running = ctx;
+	rk_session_set_(ctx->test, TEST_RUN);
+
+	if (swapcontext(&loop_context, &ctx->context) == -1)
+		rk_error("swapcontext() error: %s", strerror(errno));
+
+	async_running = prev;
+}
+
+static void remove_watch(rk_async_t *ctx, rk_async_watch_t *watch)
+{
+	rk_async_watch_t **pos;
+
+	for (pos = &ctx->watches; *pos; pos = &(*pos)->next) {
+		if (*pos == watch) {
+			*pos = watch->next;
+			break;
+		}
+	}
+
+	epoll_ctl(ctx->epfd, EPOLL_CTL_DEL, watch->fd, NULL);
+
+	watch->owner = NULL;
+	watch->next = async_removed;
+	async_removed = watch;
+}
+
+static void release_watches(void)
+{
+	rk_async_watch_t *watch;
+
+	while (async_removed) {
+		watch = async_removed;
+		async_removed = watch->next;
+		free(watch);
+	}
+}
+
+static rk_async_watch_t *add_watch(rk_async_t *ctx, int fd,
+		unsigned int events, rk_async_cb cb, void *data)
+{
+	struct epoll_event ev = { .events = events };
+	rk_async_watch_t *watch;
+
+	watch = calloc(1, sizeof(rk_async_watch_t));
+	if (!watch)
+		return NULL;
+
+	watch->owner = ctx;
+	watch->cb = cb;
+	watch->data = data;
+	watch->fd = fd;
+	watch->events = events;
+
+	ev.data.ptr = watch;
+
+	if (epoll_ctl(ctx->epfd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+		free(watch);
+		return NULL;
+	}
+
+	watch->next = ctx->watches;
+	ctx->watches = watch;
+
+	return watch;
+}
+
+int rk_async_watch(rk_async_t *ctx, int fd, unsigned int events,
+		rk_async_cb cb, void *data)
+{
+	assert(ctx);
+	assert(cb);
+
+	if (ctx->done) {
+		errno = ETIMEDOUT;
+		return -1;
+	}
+
+	return add_watch(ctx, fd, events, cb, data) ? 0 : -1;
+}
+
+void rk_async_unwatch(rk_async_t *ctx, int fd)
+{
+	rk_async_watch_t *watch;
+
+	assert(ctx);
+
+	for (watch = ctx->watches; watch; watch = watch->next) {
+		if (watch->fd == fd) {
+			remove_watch(ctx, watch);
+			break;
+		}
+	}
+}
+
+int rk_async_wait(rk_async_t *ctx, int fd, unsigned int events)
+{
+	rk_async_watch_t *watch;
+
+	assert(ctx);
+
+	if (ctx != async_running || ctx->returned) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (ctx->done) {
+		errno = ETIMEDOUT;
+		return -1;
+	}
+
+	watch = add_watch(ctx, fd, events, NULL, NULL);
+	if (!watch)
+		return -1;
+
+	ctx->revents = 0;
+	ctx->suspended = true;
+
+	if (swapcontext(&ctx->context, &loop_context) == -1)
+		return -1;
+
+	if (!ctx->revents) {
+		errno = ETIMEDOUT;
+		return -1;
+	}
+
+	return (int)ctx->revents;
+}
+
+void rk_async_done(rk_async_t *ctx)
+{
+	assert(ctx);
+
+	ctx->done = true;
+}
+
+/*
+ * Map the stack of an asynchronous test, returning its lowest address. The
+ * page below it is made inaccessible, so an overflow faults instead of
+ * writing into the next mapping.
+ */
+static void *map_stack(void)
+{
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	char *stack;
+
+	stack = mmap(NULL, ASYNC_STACK_SIZE + page, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+
+	if (stack == MAP_FAILED)
+		return NULL;
+
+	if (mprotect(stack, page, PROT_NONE) == -1) {
+		munmap(stack, ASYNC_STACK_SIZE + page);
+		return NULL;
+	}
+
+	return stack + page;
+}
+
+static void unmap_stack(void *stack)
+{
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+
+	munmap((char *)stack - page, ASYNC_STACK_SIZE + page);
+}
+
+static void finish(rk_async_t *ctx)
+{
+	while (ctx->watches)
+		remove_watch(ctx, ctx->watches);
+
+	/* let a suspended test body go back from rk_async_wait() */
+	if (ctx->suspended) {
+		ctx->suspended = false;
+		ctx->revents = 0;
+		resume(ctx);
+	}
+
+	if (!ctx->returned)
+		return;
+
+	if (ctx->test->teardown) {
+		rk_session_set_(ctx->test, TEST_TEARDOWN);
+		ctx->test->teardown();
+	}
+
+	unmap_stack(ctx->stack);
+	ctx->stack = NULL;
+}
+
+static bool completed(rk_async_t *ctx)
+{
+	return !ctx->stack;
+}
+
+static void dispatch(struct epoll_event *ev)
+{
+	rk_async_watch_t *watch = ev->data.ptr;
+	rk_async_t *ctx = watch->owner;
+
+	/* watch has been removed while processing previous events */
+	if (!ctx)
+		return;
+
+	if (!watch->cb) {
+		/* a test body is waiting for this file descriptor */
+		remove_watch(ctx, watch);
+
+		ctx->suspended = false;
+		ctx->revents = ev->events;
+		resume(ctx);
+		return;
+	}
+
+	rk_session_set_(ctx->test, TEST_RUN);
+	watch->cb(ctx, watch->fd, ev->events, watch->data);
+}
+
+static int start(rk_async_t *ctx, rk_test_t *test, int epfd)
+{
+	unsigned long timeout = test->timeout ? test->timeout : ASYNC_TIMEOUT;
+
+	memset(ctx, 0, sizeof(rk_async_t));
+
+	ctx->test = test;
+	ctx->epfd = epfd;
+	ctx->deadline = rk_now_ns_() + timeout * 1000000ULL;
+
+	ctx->stack = map_stack();
+	if (!ctx->stack)
+		return -1;
+
+	if (getcontext(&ctx->context) == -1) {
+		unmap_stack(ctx->stack);
+		ctx->stack = NULL;
+		return -1;
+	}
+
+	ctx->context.uc_stack.ss_sp = ctx->stack;
+	ctx->context.uc_stack.ss_size = ASYNC_STACK_SIZE;
+	ctx->context.uc_link = &loop_context;
+
+	makecontext(&ctx->context, async_entry, 0);
+
+	if (test->setup) {
+		rk_session_set_(test, TEST_SETUP);
+		test->setup();
+	}
+
+	async_starting = ctx;
+	resume(ctx);
+	async_starting = NULL;
+
+	return 0;
+}
+
+void rk_run_async_(rk_test_t *tests, size_t count)
+{
+	struct epoll_event events[ASYNC_EVENTS];
+	unsigned long long now, next;
+	rk_async_t *ctxs;
+	size_t running = 0;
+	int epfd, timeout, num;
+
+	ctxs = calloc(count, sizeof(rk_async_t));
+	if (!ctxs) {
+		rk_error("calloc() error: %s", strerror(errno));
+		return;
+	}
+
+	epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (epfd == -1) {
+		rk_error("epoll_create1() error: %s", strerror(errno));
+		free(ctxs);
+		return;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		if (start(ctxs + i, tests + i, epfd)) {
+			rk_error("Can't start asynchronous test: %s",
+				strerror(errno));
+			continue;
+		}
+
+		running++;
+	}
+
+	while (running) {
+		now = rk_now_ns_();
+		next = 0;
+
+		for (size_t i = 0; i < count; i++) {
+			rk_async_t *ctx = ctxs + i;
+
+			if (completed(ctx))
+				continue;
+
+			if (!ctx->done && now >= ctx->deadline) {
+				ctx->done = true;
+
+				rk_session_set_(ctx->test, TEST_RUN);
+				rk_result(TFAIL, "Asynchronous test timed out");
+			}
+
+			if (ctx->done || (ctx->returned && !ctx->watches)) {
+				ctx->done = true;
+				finish(ctx);
+
+				if (completed(ctx))
+					running--;
+
+				continue;
+			}
+
+			if (!next || ctx->deadline < next)
+				next = ctx->deadline;
+		}
+
+		if (!running)
+			break;
+
+		timeout = next > now ? (int)((next - now) / 1000000ULL) + 1 : 0;
+
+		num = epoll_wait(epfd, events, ASYNC_EVENTS, timeout);
+		if (num == -1 && errno != EINTR) {
+			rk_error("epoll_wait() error: %s", strerror(errno));
+			break;
+		}
+
+		for (int i = 0; i < num; i++)
+			dispatch(events + i);
+
+		release_watches();
+	}
+
+	release_watches();
+	close(epfd);
+	free(ctxs);
+}
@@ -0,0 +1,90 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) 2025 Andrea Cervesato <andrea.cervesato@mailbox.org>
+ */
+
+#include "riker_internal.h"
+#include <math.h>
+#include <stdlib.h>
+
+static int compare_ns(const void *a, const void *b)
+{
+	unsigned long long x = *(const unsigned long long *)a;
+	unsigned long long y = *(const unsigned long long *)b;
+
+	return (x > y) - (x < y);
+}
+
+int rk_bench_stats(const unsigned long long *samples, size_t count,
+		rk_bench_stats_t *stats)
+{
+	unsigned long long *sorted;
+	double mean, delta, stddev, m2 = 0;
+	unsigned long long total = 0;
+
+	assert(samples);
+	assert(stats);
+
+	memset(stats, 0, sizeof(rk_bench_stats_t));
+
+	if (!count)
+		return 0;
+
+	sorted = malloc(count * sizeof(unsigned long long));
+	if (!sorted)
+		return -1;
+
+	memcpy(sorted, samples, count * sizeof(unsigned long long));
+	qsort(sorted, count, sizeof(unsigned long long), compare_ns);
+
+	for (size_t i = 0; i < count; i++)
+		total += sorted[i];
+
+	mean = (double)total / (double)count;
+
+	for (size_t i = 0; i < count; i++) {
+		delta = (double)sorted[i] - mean;
+		m2 += delta * delta;
+	}
+
+	stats->runs = count;
+	stats->min_ns = sorted[0];
+	stats->max_ns = sorted[count - 1];
+	stats->mean_ns = total / count;
+
+	if (count % 2)
+		stats->median_ns = sorted[count / 2];
+	else
+		stats->median_ns = (sorted[count / 2 - 1] + sorted[count / 2]) / 2;
+
+	if (count > 1) {
+		stddev = sqrt(m2 / (double)(count - 1));
+		stats->stddev_ns = (unsigned long long)stddev;
+	}
+
+	free(sorted);
+
+	return 0;
+}
+
+void rk_bench_report_(const char *file, const int lineno, const char *name,
+		const rk_bench_stats_t *stats)
+{
+	char score[64] = "";
+	double normalized;
+
+	assert(name);
+	assert(stats);
+
+	/* normalized score can be compared with other hosts */
+	if (rk_calibration()) {
+		normalized = rk_bench_score(stats);
+		snprintf(score, sizeof(score), ", score %llu",
+			(unsigned long long)normalized);
+	}
+
+	rk_result_(file, lineno, TINFO, "%s: %zu runs, median %llu ns, "
+		"mean %llu ns, min %llu ns, max %llu ns, stddev %llu ns%s",
+		name, stats->runs, stats->median_ns, stats->mean_ns,
+		stats->min_ns, stats->max_ns, stats->stddev_ns, score);
+}
@@ -0,0 +1,328 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) 2025 Andrea Cervesato <andrea.cervesato@mailbox.org>
+ */
+
+#define _GNU_SOURCE
+
+#include "riker_internal.h"
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* Alignment of the buffers and of the transfers used with O_DIRECT */
+#define IO_ALIGN 4096
+
+/* Size of the chunks written when preparing a file */
+#define IO_FILL_SIZE (1024 * 1024)
+
+/* Dirty pages might need a few attempts before being dropped */
+#define IO_DROP_RETRIES 10
+
+int rk_bench_file_prepare(const char *path, size_t size)
+{
+	size_t len;
+	ssize_t ret;
+	char *buf;
+	int fd;
+
+	assert(path);
+
+	buf = malloc(IO_FILL_SIZE);
+	if (!buf)
+		return -1;
+
+	/* data which can't be stored as sparse or zero filled blocks */
+	for (size_t i = 0; i < IO_FILL_SIZE; i++)
+		buf[i] = (char)(i * 31 + 7);
+
+	fd = open(path, O_CREAT | O_WRONLY | O_TRUNC | O_CLOEXEC, 0600);
+	if (fd == -1) {
+		free(buf);
+		return -1;
+	}
+
+	while (size) {
+		len = size < IO_FILL_SIZE ? size : IO_FILL_SIZE;
+
+		ret = write(fd, buf, len);
+		if (ret == -1) {
+			if (errno == EINTR)
+				continue;
+
+			goto error;
+		}
+
+		size -= (size_t)ret;
+	}
+
+	if (fdatasync(fd))
+		goto error;
+
+	free(buf);
+
+	return close(fd);
+
+error:
+	free(buf);
+	close(fd);
+
+	return -1;
+}
+
+static int resident_pages(int fd, size_t size, size_t *count)
+{
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	size_t pages = (size + page - 1) / page;
+	unsigned char *vec;
+	void *ptr;
+
+	*count = 0;
+
+	if (!size)
+		return 0;
+
+	vec = malloc(pages);
+	if (!vec)
+		return -1;
+
+	ptr = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+	if (ptr == MAP_FAILED) {
+		free(vec);
+		return -1;
+	}
+
+	if (mincore(ptr, size, vec)) {
+		munmap(ptr, size);
+		free(vec);
+		return -1;
+	}
+
+	for (size_t i = 0; i < pages; i++)
+		*count += vec[i] & 1;
+
+	munmap(ptr, size);
+	free(vec);
+
+	return 0;
+}
+
+int rk_bench_drop_cache(const char *path, size_t *resident)
+{
+	struct stat st;
+	size_t count = 0;
+	int fd;
+
+	assert(path);
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd == -1)
+		return -1;
+
+	if (fstat(fd, &st))
+		goto error;
+
+	for (int i = 0; i < IO_DROP_RETRIES; i++) {
+		/* dirty pages are never dropped, so write them back first */
+		if (fdatasync(fd))
+			goto error;
+
+		errno = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+		if (errno)
+			goto error;
+
+		if (resident_pages(fd, (size_t)st.st_size, &count))
+			goto error;
+
+		if (!count)
+			break;
+	}
+
+	if (resident)
+		*resident = count;
+
+	return close(fd);
+
+error:
+	close(fd);
+
+	return -1;
+}
+
+static int open_file(const char *path, bool write, bool *direct)
+{
+	int flags = (write ? O_WRONLY : O_RDONLY) | O_CLOEXEC;
+	int fd;
+
+	if (*direct) {
+		fd = open(path, flags | O_DIRECT);
+		if (fd != -1 || errno != EINVAL)
+			return fd;
+
+		/* filesystem doesn't support O_DIRECT, like tmpfs */
+		*direct = false;
+	}
+
+	return open(path, flags);
+}
+
+static int transfer(int fd, char *buf, const rk_bench_io_opts_t *opts)
+{
+	size_t len;
+	ssize_t ret;
+
+	for (size_t off = 0; off < opts->file_size; off += (size_t)ret) {
+		len = opts->file_size - off;
+		if (len > opts->block_size)
+			len = opts->block_size;
+
+		if (opts->write)
+			ret = pwrite(fd, buf, len, (off_t)off);
+		else
+			ret = pread(fd, buf, len, (off_t)off);
+
+		if (ret == -1 && errno == EINTR) {
+			ret = 0;
+			continue;
+		}
+
+		if (ret <= 0)
+			return -1;
+	}
+
+	/* written data has to reach the device to be measured */
+	if (opts->write && fdatasync(fd))
+		return -1;
+
+	return 0;
+}
+
+int rk_bench_io(const rk_bench_io_opts_t *opts, rk_bench_io_result_t *res)
+{
+	char tmp_path[] = "/var/tmp/riker-io-XXXXXX";
+	unsigned long long *samples = NULL;
+	unsigned long long start;
+	const char *path;
+	bool direct;
+	size_t resident, blocks;
+	char *buf = NULL;
+	int fd, ret = -1;
+
+	assert(opts);
+	assert(res);
+
+	memset(res, 0, sizeof(rk_bench_io_result_t));
+
+	path = opts->path;
+	direct = opts->direct;
+
+	if (!opts->file_size || !opts->block_size || !opts->runs) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	/* unaligned transfers would fail inside the timed loop */
+	if (opts->direct && (opts->block_size % IO_ALIGN ||
+			opts->file_size % opts->block_size)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (!path) {
+		fd = mkstemp(tmp_path);
+		if (fd == -1)
+			return -1;
+
+		close(fd);
+		path = tmp_path;
+	}
+
+	samples = malloc(opts->runs * sizeof(unsigned long long));
+	if (!samples)
+		goto exit;
+
+	errno = posix_memalign((void **)&buf, IO_ALIGN, opts->block_size);
+	if (errno) {
+		buf = NULL;
+		goto exit;
+	}
+
+	memset(buf, 0x5a, opts->block_size);
+
+	if (rk_bench_file_prepare(path, opts->file_size))
+		goto exit;
+
+	res->cold = 1;
+
+	for (unsigned long i = 0; i < opts->runs; i++) {
+		if (rk_bench_drop_cache(path, &resident))
+			goto exit;
+
+		if (resident) {
+			res->cold = 0;
+			res->cached_pages += resident;
+		}
+
+		fd = open_file(path, opts->write, &direct);
+		if (fd == -1)
+			goto exit;
+
+		start = rk_now_ns_();
+
+		if (transfer(fd, buf, opts)) {
+			close(fd);
+			goto exit;
+		}
+
+		samples[i] = rk_now_ns_() - start;
+		close(fd);
+	}
+
+	if (rk_bench_stats(samples, opts->runs, &res->stats))
+		goto exit;
+
+	res->direct = direct;
+
+	if (res->stats.median_ns) {
+		blocks = (opts->file_size + opts->block_size - 1) /
+			opts->block_size;
+
+		res->mb_per_sec = opts->file_size * 1000ULL /
+			res->stats.median_ns;
+		res->iops = blocks * 1000000000ULL / res->stats.median_ns;
+	}
+
+	ret = 0;
+
+exit:
+	if (path == tmp_path)
+		unlink(tmp_path);
+
+	free(samples);
+	free(buf);
+
+	return ret;
+}
+
+void rk_bench_io_report_(const char *file, const int lineno, const char *name,
+		const rk_bench_io_result_t *res)
+{
+	assert(name);
+	assert(res);
+
+	rk_bench_report_(file, lineno, name, &res->stats);
+
+	if (res->cold) {
+		rk_result_(file, lineno, TINFO, "%s: %llu MB/s, %llu IOPS, "
+			"cold cache, %s", name, res->mb_per_sec, res->iops,
+			res->direct ? "O_DIRECT" : "buffered");
+	} else {
+		rk_result_(file, lineno, TINFO, "%s: %llu MB/s, %llu IOPS, "
+			"%zu cached pages, %s", name, res->mb_per_sec,
+			res->iops, res->cached_pages,
+			res->direct ? "O_DIRECT" : "buffered");
+	}
+}
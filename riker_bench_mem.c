@@ -0,0 +1,468 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) 2025 Andrea Cervesato <andrea.cervesato@mailbox.org>
+ */
+
+#define _GNU_SOURCE
+
+#include "riker_internal.h"
+#include <sched.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+/* Distance between the pointers of a latency chain */
+#define MEM_LINE 64
+
+#define MEM_LATENCY_MIN_SIZE (4UL * 1024)
+#define MEM_LATENCY_MAX_SIZE (1024UL * 1024 * 1024)
+#define MEM_LATENCY_LOADS (1024UL * 1024)
+
+#define MEM_BANDWIDTH_SIZE (64UL * 1024 * 1024)
+#define MEM_BANDWIDTH_RUNS 5
+
+/* Bytes moved by each element of the STREAM kernels */
+static const size_t kernel_bytes[RK_MEM_KERNELS] = {
+	[RK_MEM_COPY] = 2 * sizeof(double),
+	[RK_MEM_SCALE] = 2 * sizeof(double),
+	[RK_MEM_ADD] = 3 * sizeof(double),
+	[RK_MEM_TRIAD] = 3 * sizeof(double),
+};
+
+static const char *const kernel_names[] = {
+	[RK_MEM_COPY] = "copy",
+	[RK_MEM_SCALE] = "scale",
+	[RK_MEM_ADD] = "add",
+	[RK_MEM_TRIAD] = "triad",
+};
+
+/* Peak bandwidth measured by the process, used as a reference */
+static unsigned long long peak_mb_per_sec;
+
+/* the chain is followed into this, so loads can't be optimized away */
+static void *volatile mem_sink;
+
+/*
+ * Link the cache lines of a buffer into a single random cycle (Sattolo's
+ * algorithm). The generator has a fixed seed, so runs are reproducible.
+ */
+static void build_chain(char *buf, size_t size)
+{
+	size_t lines = size / MEM_LINE;
+	uint64_t seed = 0x2545f4914f6cdd1dULL;
+	size_t *order, j, tmp;
+
+	order = malloc(lines * sizeof(size_t));
+
+	if (!order) {
+		/* a sequential chain still gives the latency of the caches */
+		for (size_t i = 0; i < lines; i++) {
+			*(void **)(void *)(buf + i * MEM_LINE) =
+				buf + ((i + 1) % lines) * MEM_LINE;
+		}
+
+		return;
+	}
+
+	for (size_t i = 0; i < lines; i++)
+		order[i] = i;
+
+	for (size_t i = lines - 1; i > 0; i--) {
+		seed ^= seed << 13;
+		seed ^= seed >> 7;
+		seed ^= seed << 17;
+
+		j = (size_t)(seed % i);
+		tmp = order[i];
+		order[i] = order[j];
+		order[j] = tmp;
+	}
+
+	/* each line points to the line that follows it inside the cycle */
+	for (size_t i = 0; i < lines; i++) {
+		*(void **)(void *)(buf + i * MEM_LINE) =
+			buf + order[i] * MEM_LINE;
+	}
+
+	free(order);
+}
+
+static double chase(char *buf, size_t size, unsigned long loads)
+{
+	unsigned long long start, elapsed;
+	size_t warmup = size / MEM_LINE;
+	void *ptr = buf;
+
+	if (warmup > loads)
+		warmup = loads;
+
+	/* one lap brings the working set into the caches where it fits */
+	for (size_t i = 0; i < warmup; i++)
+		ptr = *(void **)ptr;
+
+	start = rk_now_ns_();
+
+	for (unsigned long i = 0; i < loads; i++)
+		ptr = *(void **)ptr;
+
+	elapsed = rk_now_ns_() - start;
+	mem_sink = ptr;
+
+	return (double)elapsed / (double)loads;
+}
+
+int rk_bench_mem_latency(const rk_bench_mem_latency_opts_t *opts,
+		rk_bench_mem_latency_result_t *res)
+{
+	size_t min_size = MEM_LATENCY_MIN_SIZE;
+	size_t max_size = MEM_LATENCY_MAX_SIZE;
+	unsigned long loads = MEM_LATENCY_LOADS;
+	char *buf;
+
+	assert(res);
+
+	memset(res, 0, sizeof(rk_bench_mem_latency_result_t));
+
+	if (opts && opts->min_size)
+		min_size = opts->min_size;
+
+	if (opts && opts->max_size)
+		max_size = opts->max_size;
+
+	if (opts && opts->loads)
+		loads = opts->loads;
+
+	if (min_size < 2 * MEM_LINE || min_size > max_size) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	for (size_t size = min_size; size <= max_size &&
+		res->count < RK_MEM_LATENCY_SIZES; size *= 2) {
+		buf = mmap(NULL, size, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (buf == MAP_FAILED)
+			break;
+
+		/* fewer TLB misses, so caches and memory are measured */
+		madvise(buf, size, MADV_HUGEPAGE);
+
+		build_chain(buf, size);
+
+		res->size[res->count] = size;
+		res->ns[res->count] = chase(buf, size, loads);
+		res->count++;
+
+		munmap(buf, size);
+	}
+
+	if (!res->count) {
+		errno = ENOMEM;
+		return -1;
+	}
+
+	return 0;
+}
+
+void rk_bench_mem_latency_report_(const char *file, const int lineno,
+		const rk_bench_mem_latency_result_t *res)
+{
+	size_t size;
+
+	assert(res);
+
+	for (size_t i = 0; i < res->count; i++) {
+		size = res->size[i];
+
+		if (size >= 1024 * 1024) {
+			rk_result_(file, lineno, TINFO, "latency %zu MB: %.1f ns",
+				size / (1024 * 1024), res->ns[i]);
+		} else {
+			rk_result_(file, lineno, TINFO, "latency %zu KB: %.1f ns",
+				size / 1024, res->ns[i]);
+		}
+	}
+}
+
+typedef struct rk_stream rk_stream_t;
+
+typedef struct
+{
+	rk_stream_t *stream;
+	double *a;
+	double *b;
+	double *c;
+	size_t count;
+	pthread_t thread;
+	int cpu;
+	bool started;
+	bool pinned;
+	char padding[2];
+} rk_stream_worker_t;
+
+/*
+ * Threads wait on the barrier before and after each kernel, so the time
+ * between the two barriers is the time of the slowest thread.
+ */
+struct rk_stream
+{
+	rk_stream_worker_t *workers;
+	pthread_barrier_t barrier;
+	unsigned long runs;
+	unsigned int threads;
+	int go;
+};
+
+static void run_kernel(rk_stream_worker_t *worker, int kernel)
+{
+	const double scalar = 3;
+	double *a = worker->a;
+	double *b = worker->b;
+	double *c = worker->c;
+
+	switch (kernel) {
+	case RK_MEM_COPY:
+		for (size_t i = 0; i < worker->count; i++)
+			c[i] = a[i];
+		break;
+	case RK_MEM_SCALE:
+		for (size_t i = 0; i < worker->count; i++)
+			b[i] = scalar * c[i];
+		break;
+	case RK_MEM_ADD:
+		for (size_t i = 0; i < worker->count; i++)
+			c[i] = a[i] + b[i];
+		break;
+	case RK_MEM_TRIAD:
+	default:
+		for (size_t i = 0; i < worker->count; i++)
+			a[i] = b[i] + scalar * c[i];
+		break;
+	}
+}
+
+static void *stream_loop(void *arg)
+{
+	rk_stream_worker_t *worker = arg;
+	rk_stream_t *stream = worker->stream;
+	cpu_set_t mask;
+	int go;
+
+	if (worker->cpu >= 0) {
+		CPU_ZERO(&mask);
+		CPU_SET((size_t)worker->cpu, &mask);
+
+		worker->pinned = !sched_setaffinity(0, sizeof(mask), &mask);
+	}
+
+	/* first touch places the pages next to the thread using them */
+	for (size_t i = 0; i < worker->count; i++) {
+		worker->a[i] = 1;
+		worker->b[i] = 2;
+		worker->c[i] = 0;
+	}
+
+	/* wait until all the threads started, or one of them failed to */
+	while (!(go = __atomic_load_n(&stream->go, __ATOMIC_ACQUIRE)))
+		sched_yield();
+
+	if (go < 0)
+		return NULL;
+
+	for (unsigned long run = 0; run < stream->runs; run++) {
+		for (int kernel = 0; kernel < RK_MEM_KERNELS; kernel++) {
+			pthread_barrier_wait(&stream->barrier);
+			run_kernel(worker, kernel);
+			pthread_barrier_wait(&stream->barrier);
+		}
+	}
+
+	return NULL;
+}
+
+static unsigned int available_cpus(int *cpus, unsigned int max)
+{
+	unsigned int count = 0;
+	cpu_set_t set;
+
+	if (sched_getaffinity(0, sizeof(set), &set))
+		return 0;
+
+	for (int i = 0; i < CPU_SETSIZE && count < max; i++) {
+		if (CPU_ISSET((size_t)i, &set)) {
+			if (cpus)
+				cpus[count] = i;
+
+			count++;
+		}
+	}
+
+	return count;
+}
+
+int rk_bench_mem_bandwidth(const rk_bench_mem_bandwidth_opts_t *opts,
+		rk_bench_mem_bandwidth_result_t *res)
+{
+	unsigned long long best[RK_MEM_KERNELS], start, elapsed;
+	size_t size = MEM_BANDWIDTH_SIZE, count, share, offset = 0;
+	rk_stream_t stream = { .runs = MEM_BANDWIDTH_RUNS };
+	unsigned int threads, ncpus;
+	double *arrays = NULL;
+	int *cpus = NULL;
+	int ret = -1, err = 0;
+
+	assert(res);
+
+	memset(res, 0, sizeof(rk_bench_mem_bandwidth_result_t));
+
+	if (opts && opts->size)
+		size = opts->size;
+
+	if (opts && opts->runs)
+		stream.runs = opts->runs;
+
+	ncpus = available_cpus(NULL, CPU_SETSIZE);
+	threads = opts && opts->threads ? opts->threads : ncpus;
+	count = size / sizeof(double);
+
+	if (!threads || count < threads) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	stream.threads = threads;
+	stream.workers = calloc(threads, sizeof(rk_stream_worker_t));
+	cpus = calloc(threads, sizeof(int));
+
+	/* pages are mapped by the threads using them */
+	arrays = mmap(NULL, 3 * count * sizeof(double),
+		PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	if (!stream.workers || !cpus || arrays == MAP_FAILED) {
+		if (arrays == MAP_FAILED)
+			arrays = NULL;
+
+		goto exit;
+	}
+
+	/* threads are only pinned if each one can have its own CPU */
+	if (opts && opts->pin && available_cpus(cpus, threads) == threads)
+		res->pinned = 1;
+
+	for (unsigned int i = 0; i < threads; i++) {
+		rk_stream_worker_t *worker = stream.workers + i;
+
+		share = (count - offset) / (threads - i);
+
+		worker->stream = &stream;
+		worker->a = arrays + offset;
+		worker->b = arrays + count + offset;
+		worker->c = arrays + 2 * count + offset;
+		worker->count = share;
+		worker->cpu = res->pinned ? cpus[i] : -1;
+
+		offset += share;
+	}
+
+	for (unsigned int i = 0; i < threads; i++) {
+		err = pthread_create(&stream.workers[i].thread, NULL,
+			stream_loop, stream.workers + i);
+		if (err)
+			break;
+
+		stream.workers[i].started = true;
+	}
+
+	if (!err)
+		err = pthread_barrier_init(&stream.barrier, NULL, threads + 1);
+
+	/* the barrier would wait forever for the threads which didn't start */
+	__atomic_store_n(&stream.go, err ? -1 : 1, __ATOMIC_RELEASE);
+
+	if (err) {
+		for (unsigned int i = 0; i < threads; i++) {
+			if (stream.workers[i].started)
+				pthread_join(stream.workers[i].thread, NULL);
+		}
+
+		errno = err;
+		goto exit;
+	}
+
+	for (int i = 0; i < RK_MEM_KERNELS; i++)
+		best[i] = ~0ULL;
+
+	for (unsigned long run = 0; run < stream.runs; run++) {
+		for (int kernel = 0; kernel < RK_MEM_KERNELS; kernel++) {
+			pthread_barrier_wait(&stream.barrier);
+			start = rk_now_ns_();
+			pthread_barrier_wait(&stream.barrier);
+			elapsed = rk_now_ns_() - start;
+
+			if (elapsed < best[kernel])
+				best[kernel] = elapsed;
+		}
+	}
+
+	for (unsigned int i = 0; i < threads; i++) {
+		pthread_join(stream.workers[i].thread, NULL);
+		res->pinned &= stream.workers[i].pinned;
+	}
+
+	pthread_barrier_destroy(&stream.barrier);
+
+	for (int kernel = 0; kernel < RK_MEM_KERNELS; kernel++) {
+		if (!best[kernel])
+			best[kernel] = 1;
+
+		res->mb_per_sec[kernel] = count * kernel_bytes[kernel] *
+			1000ULL / best[kernel];
+
+		if (res->mb_per_sec[kernel] > res->peak_mb_per_sec)
+			res->peak_mb_per_sec = res->mb_per_sec[kernel];
+	}
+
+	res->threads = threads;
+
+	if (res->peak_mb_per_sec > peak_mb_per_sec)
+		peak_mb_per_sec = res->peak_mb_per_sec;
+
+	ret = 0;
+
+exit:
+	if (arrays)
+		munmap(arrays, 3 * count * sizeof(double));
+
+	free(stream.workers);
+	free(cpus);
+
+	return ret;
+}
+
+void rk_bench_mem_bandwidth_report_(const char *file, const int lineno,
+		const rk_bench_mem_bandwidth_result_t *res)
+{
+	assert(res);
+
+	for (int kernel = 0; kernel < RK_MEM_KERNELS; kernel++) {
+		rk_result_(file, lineno, TINFO, "bandwidth %s: %llu MB/s on %u "
+			"%s threads", kernel_names[kernel],
+			res->mb_per_sec[kernel], res->threads,
+			res->pinned ? "pinned" : "unpinned");
+	}
+}
+
+double rk_bench_peak_percent(const rk_bench_stats_t *stats, size_t bytes)
+{
+	double mb_per_sec;
+
+	assert(stats);
+
+	if (!peak_mb_per_sec || !stats->median_ns)
+		return -1;
+
+	mb_per_sec = (double)bytes * 1000 / (double)stats->median_ns;
+
+	return mb_per_sec * 100 / (double)peak_mb_per_sec;
+}
@@ -0,0 +1,430 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) 2025 Andrea Cervesato <andrea.cervesato@mailbox.org>
+ */
+
+#define _GNU_SOURCE
+
+#include "riker_internal.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+/* Runs of each reference kernel, the median one is kept */
+#define CALIB_RUNS 5
+
+/* Iterations of the integer ALU loop */
+#define CALIB_ALU_LOOPS (4 * 1024 * 1024)
+
+/* Elements of each array of the stream triad, bigger than most caches */
+#define CALIB_STREAM_SIZE (2 * 1024 * 1024)
+
+/* Elements of the random access chain and number of accesses */
+#define CALIB_CHAIN_SIZE (4 * 1024 * 1024)
+#define CALIB_CHAIN_HOPS (256 * 1024)
+
+/* Round trips to the kernel */
+#define CALIB_SYSCALLS (100 * 1000)
+
+/*
+ * Duration of the reference kernels on the reference machine, a 2.4 GHz
+ * x86_64 server. Normalized scores are nanoseconds on this machine.
+ */
+static const unsigned long long reference_ns[RK_CALIB_COUNT] = {
+	[RK_CALIB_ALU] = 12000000,
+	[RK_CALIB_STREAM] = 8000000,
+	[RK_CALIB_LATENCY] = 40000000,
+	[RK_CALIB_SYSCALL] = 25000000,
+};
+
+static const char *const kernel_names[] = {
+	[RK_CALIB_ALU] = "alu",
+	[RK_CALIB_STREAM] = "stream",
+	[RK_CALIB_LATENCY] = "latency",
+	[RK_CALIB_SYSCALL] = "syscall",
+};
+
+static rk_calib_t calibration;
+static bool calibrated;
+
+/* results are stored, so the kernels can't be optimized away */
+static volatile unsigned long long sink;
+
+static unsigned long long run_alu(void *data)
+{
+	unsigned long long start, x = 1;
+
+	(void)data;
+
+	start = rk_now_ns_();
+
+	/* each iteration depends on the previous one */
+	for (unsigned long i = 0; i < CALIB_ALU_LOOPS; i++) {
+		x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+		x ^= x >> 29;
+	}
+
+	sink = x;
+
+	return rk_now_ns_() - start;
+}
+
+static unsigned long long run_stream(void *data)
+{
+	double *a = data;
+	double *b = a + CALIB_STREAM_SIZE;
+	double *c = b + CALIB_STREAM_SIZE;
+	unsigned long long start;
+
+	start = rk_now_ns_();
+
+	for (size_t i = 0; i < CALIB_STREAM_SIZE; i++)
+		a[i] = b[i] + 3 * c[i];
+
+	sink = (unsigned long long)a[CALIB_STREAM_SIZE / 2];
+
+	return rk_now_ns_() - start;
+}
+
+static unsigned long long run_latency(void *data)
+{
+	const size_t *chain = data;
+	unsigned long long start;
+	size_t next = 0;
+
+	start = rk_now_ns_();
+
+	for (unsigned long i = 0; i < CALIB_CHAIN_HOPS; i++)
+		next = chain[next];
+
+	sink = next;
+
+	return rk_now_ns_() - start;
+}
+
+static unsigned long long run_syscall(void *data)
+{
+	unsigned long long start;
+	long pid = 0;
+
+	(void)data;
+
+	start = rk_now_ns_();
+
+	for (unsigned long i = 0; i < CALIB_SYSCALLS; i++)
+		pid += syscall(SYS_getppid);
+
+	sink = (unsigned long long)pid;
+
+	return rk_now_ns_() - start;
+}
+
+static void *prepare_stream(void)
+{
+	double *data;
+
+	data = malloc(3 * CALIB_STREAM_SIZE * sizeof(double));
+	if (!data)
+		return NULL;
+
+	/* pages are mapped before they are measured */
+	for (size_t i = 0; i < 3 * CALIB_STREAM_SIZE; i++)
+		data[i] = (double)(i % 1024);
+
+	return data;
+}
+
+/*
+ * Build a single random cycle through the whole chain (Sattolo's
+ * algorithm), so hardware prefetchers can't predict the next access. The
+ * generator has a fixed seed, so all machines follow the same chain.
+ */
+static void *prepare_latency(void)
+{
+	uint64_t seed = 0x9e3779b97f4a7c15ULL;
+	size_t *chain, j, tmp;
+
+	chain = malloc(CALIB_CHAIN_SIZE * sizeof(size_t));
+	if (!chain)
+		return NULL;
+
+	for (size_t i = 0; i < CALIB_CHAIN_SIZE; i++)
+		chain[i] = i;
+
+	for (size_t i = CALIB_CHAIN_SIZE - 1; i > 0; i--) {
+		seed ^= seed << 13;
+		seed ^= seed >> 7;
+		seed ^= seed << 17;
+
+		j = (size_t)(seed % i);
+		tmp = chain[i];
+		chain[i] = chain[j];
+		chain[j] = tmp;
+	}
+
+	return chain;
+}
+
+static int measure(unsigned long long (*run)(void *data), void *data,
+		unsigned long long *median_ns)
+{
+	unsigned long long samples[CALIB_RUNS];
+	rk_bench_stats_t stats;
+
+	for (int i = 0; i < CALIB_RUNS; i++)
+		samples[i] = run(data);
+
+	if (rk_bench_stats(samples, CALIB_RUNS, &stats))
+		return -1;
+
+	/* a null duration would make the speed infinite */
+	*median_ns = stats.median_ns ? stats.median_ns : 1;
+
+	return 0;
+}
+
+static void compute_speed(rk_calib_t *calib)
+{
+	double log_sum = 0;
+
+	/* geometric mean, so no kernel dominates the others */
+	for (int i = 0; i < RK_CALIB_COUNT; i++) {
+		log_sum += log((double)reference_ns[i] /
+			(double)calib->kernel_ns[i]);
+	}
+
+	calib->speed = exp(log_sum / RK_CALIB_COUNT);
+}
+
+static void read_cpu_model(char *buf, size_t size)
+{
+	size_t len = 0;
+	char *line = NULL;
+	char *value;
+	FILE *file;
+
+	snprintf(buf, size, "unknown");
+
+	file = fopen("/proc/cpuinfo", "re");
+	if (!file)
+		return;
+
+	while (getline(&line, &len, file) > 0) {
+		if (strncmp(line, "model name", 10))
+			continue;
+
+		value = strchr(line, ':');
+		if (!value)
+			break;
+
+		value += strspn(value + 1, " \t") + 1;
+		value[strcspn(value, "\n")] = '\0';
+
+		snprintf(buf, size, "%s", value);
+		break;
+	}
+
+	free(line);
+	fclose(file);
+}
+
+int rk_calibrate(rk_calib_t *calib)
+{
+	void *stream, *chain;
+	int ret = -1;
+
+	assert(calib);
+
+	memset(calib, 0, sizeof(rk_calib_t));
+
+	read_cpu_model(calib->cpu, sizeof(calib->cpu));
+
+	stream = prepare_stream();
+	chain = prepare_latency();
+
+	if (!stream || !chain)
+		goto exit;
+
+	if (measure(run_alu, NULL, calib->kernel_ns + RK_CALIB_ALU))
+		goto exit;
+
+	if (measure(run_stream, stream, calib->kernel_ns + RK_CALIB_STREAM))
+		goto exit;
+
+	if (measure(run_latency, chain, calib->kernel_ns + RK_CALIB_LATENCY))
+		goto exit;
+
+	if (measure(run_syscall, NULL, calib->kernel_ns + RK_CALIB_SYSCALL))
+		goto exit;
+
+	compute_speed(calib);
+	ret = 0;
+
+exit:
+	free(stream);
+	free(chain);
+
+	return ret;
+}
+
+/*
+ * The file has a section for each CPU model, starting with a "cpu <model>"
+ * line, so it can be shared by a fleet mixing hosts of different kinds. Only
+ * the section of the CPU model running the suite is used.
+ */
+static int load_fingerprint(const char *path, rk_calib_t *calib)
+{
+	unsigned long long value;
+	char name[16];
+	int found = 0;
+	bool ours = false;
+	size_t size = 0;
+	char *line = NULL;
+	ssize_t len;
+	FILE *file;
+
+	file = fopen(path, "re");
+	if (!file)
+		return -1;
+
+	memset(calib, 0, sizeof(rk_calib_t));
+	read_cpu_model(calib->cpu, sizeof(calib->cpu));
+
+	/* each line is "<kernel> <duration in ns>", after a "cpu <model>" */
+	while ((len = getline(&line, &size, file)) > 0) {
+		if (line[len - 1] == '\n')
+			line[len - 1] = '\0';
+
+		if (!strncmp(line, "cpu ", 4)) {
+			ours = !strcmp(line + 4, calib->cpu);
+			continue;
+		}
+
+		if (!ours || sscanf(line, "%15s %llu", name, &value) != 2 ||
+				!value)
+			continue;
+
+		for (int i = 0; i < RK_CALIB_COUNT; i++) {
+			if (!strcmp(name, kernel_names[i])) {
+				calib->kernel_ns[i] = value;
+				found |= 1 << i;
+			}
+		}
+	}
+
+	free(line);
+	fclose(file);
+
+	if (found != (1 << RK_CALIB_COUNT) - 1)
+		return -1;
+
+	compute_speed(calib);
+
+	return 0;
+}
+
+/*
+ * Write the section of the CPU model, keeping the ones of the other models
+ * which are already inside the file.
+ */
+static void save_fingerprint(const char *path, const rk_calib_t *calib)
+{
+	size_t cpu_len = strlen(calib->cpu);
+	char tmp_path[4096];
+	bool ours = false;
+	size_t size = 0;
+	char *line = NULL;
+	FILE *file, *old;
+	int fd;
+
+	/* the file is replaced at once, so it's never left truncated */
+	snprintf(tmp_path, sizeof(tmp_path), "%s.XXXXXX", path);
+
+	fd = mkostemp(tmp_path, O_CLOEXEC);
+	if (fd == -1)
+		return;
+
+	/* other hosts sharing the file have to read it */
+	fchmod(fd, 0644);
+
+	file = fdopen(fd, "w");
+	if (!file) {
+		close(fd);
+		remove(tmp_path);
+		return;
+	}
+
+	fprintf(file, "cpu %s\n", calib->cpu);
+
+	for (int i = 0; i < RK_CALIB_COUNT; i++)
+		fprintf(file, "%s %llu\n", kernel_names[i], calib->kernel_ns[i]);
+
+	old = fopen(path, "re");
+	if (old) {
+		while (getline(&line, &size, old) > 0) {
+			if (!strncmp(line, "cpu ", 4)) {
+				ours = strcspn(line + 4, "\n") == cpu_len &&
+					!strncmp(line + 4, calib->cpu, cpu_len);
+			}
+
+			if (!ours)
+				fputs(line, file);
+		}
+
+		free(line);
+		fclose(old);
+	}
+
+	if (fclose(file) || rename(tmp_path, path))
+		remove(tmp_path);
+}
+
+void rk_calib_init_(void)
+{
+	const char *path = getenv("RIKER_CALIBRATION");
+	const char *source = path;
+
+	calibrated = false;
+
+	if (!path)
+		return;
+
+	if (load_fingerprint(path, &calibration)) {
+		if (rk_calibrate(&calibration)) {
+			rk_result_(__FILE__, __LINE__, TINFO, "Calibration "
+				"failed: %s", strerror(errno));
+			return;
+		}
+
+		save_fingerprint(path, &calibration);
+		source = "reference kernels";
+	}
+
+	calibrated = true;
+
+	rk_out_printf_("Calibration: %.2fx the reference machine (alu %llu ns, "
+		"stream %llu ns, latency %llu ns, syscall %llu ns) from %s\n",
+		calibration.speed, calibration.kernel_ns[RK_CALIB_ALU],
+		calibration.kernel_ns[RK_CALIB_STREAM],
+		calibration.kernel_ns[RK_CALIB_LATENCY],
+		calibration.kernel_ns[RK_CALIB_SYSCALL], source);
+}
+
+const rk_calib_t *rk_calibration(void)
+{
+	return calibrated ? &calibration : NULL;
+}
+
+double rk_bench_score(const rk_bench_stats_t *stats)
+{
+	assert(stats);
+
+	if (!calibrated)
+		return -1;
+
+	return (double)stats->median_ns * calibration.speed;
+}
@@ -0,0 +1,560 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) 2025 Andrea Cervesato <andrea.cervesato@mailbox.org>
+ */
+
+#define _GNU_SOURCE
+
+#include "riker_internal.h"
+#include <time.h>
+#include <errno.h>
+
+#ifdef RK_VIRTUAL_CLOCK
+
+#include <poll.h>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <sys/epoll.h>
+
+/*
+ * How often a sleeping thread checks whether all the threads of the process
+ * are sleeping, when some of them are not.
+ */
+#define CHECK_MS 10
+
+#define NSEC_PER_SEC 1000000000LL
+
+typedef int (*rk_clock_gettime_func)(clockid_t, struct timespec *);
+typedef int (*rk_gettimeofday_func)(struct timeval *, void *);
+typedef time_t (*rk_time_func)(time_t *);
+typedef int (*rk_nanosleep_func)(const struct timespec *, struct timespec *);
+typedef int (*rk_clock_nanosleep_func)(clockid_t, int,
+		const struct timespec *, struct timespec *);
+typedef int (*rk_poll_func)(struct pollfd *, nfds_t, int);
+typedef int (*rk_epoll_wait_func)(int, struct epoll_event *, int, int);
+
+typedef struct rk_sleeper
+{
+	struct rk_sleeper *next;
+	/* absolute deadline on the virtual monotonic clock */
+	long long deadline;
+} rk_sleeper_t;
+
+typedef struct
+{
+	long long offset;
+	rk_sleeper_t *sleepers;
+	long long grace_ms;
+	bool enabled;
+	char padding[7];
+} rk_vclock_t;
+
+static rk_clock_gettime_func real_clock_gettime;
+static rk_gettimeofday_func real_gettimeofday;
+static rk_time_func real_time;
+static rk_nanosleep_func real_nanosleep;
+static rk_clock_nanosleep_func real_clock_nanosleep;
+static rk_poll_func real_poll;
+static rk_epoll_wait_func real_epoll_wait;
+
+static rk_vclock_t vclock;
+static pthread_mutex_t vclock_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t vclock_cond = PTHREAD_COND_INITIALIZER;
+
+static void *resolve(const char *name)
+{
+	void *sym = dlsym(RTLD_NEXT, name);
+
+	assert(sym);
+
+	return sym;
+}
+
+static void __attribute__((constructor)) rk_clock_init(void)
+{
+	*(void **)&real_clock_gettime = resolve("clock_gettime");
+	*(void **)&real_gettimeofday = resolve("gettimeofday");
+	*(void **)&real_time = resolve("time");
+	*(void **)&real_nanosleep = resolve("nanosleep");
+	*(void **)&real_clock_nanosleep = resolve("clock_nanosleep");
+	*(void **)&real_poll = resolve("poll");
+	*(void **)&real_epoll_wait = resolve("epoll_wait");
+}
+
+static long long ts_to_ns(const struct timespec *ts)
+{
+	return (long long)ts->tv_sec * NSEC_PER_SEC + ts->tv_nsec;
+}
+
+static void ns_to_ts(long long ns, struct timespec *ts)
+{
+	ts->tv_sec = (time_t)(ns / NSEC_PER_SEC);
+	ts->tv_nsec = (long)(ns % NSEC_PER_SEC);
+}
+
+static bool is_shifted(clockid_t clk)
+{
+	switch (clk) {
+	case CLOCK_REALTIME:
+	case CLOCK_REALTIME_COARSE:
+	case CLOCK_MONOTONIC:
+	case CLOCK_MONOTONIC_COARSE:
+	case CLOCK_MONOTONIC_RAW:
+	case CLOCK_BOOTTIME:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static long long real_now(clockid_t clk)
+{
+	struct timespec ts;
+
+	if (!real_clock_gettime)
+		rk_clock_init();
+
+	real_clock_gettime(clk, &ts);
+
+	return ts_to_ns(&ts);
+}
+
+static long long virtual_now(clockid_t clk)
+{
+	return real_now(clk) + __atomic_load_n(&vclock.offset, __ATOMIC_ACQUIRE);
+}
+
+static size_t process_threads(void)
+{
+	char buf[1024];
+	char *ptr;
+	ssize_t len;
+	int fd;
+
+	fd = open("/proc/self/stat", O_RDONLY | O_CLOEXEC);
+	if (fd == -1)
+		return 0;
+
+	len = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+
+	if (len <= 0)
+		return 0;
+
+	buf[len] = '\0';
+
+	/* num_threads is the 17th field after the command name */
+	ptr = strrchr(buf, ')');
+	for (int i = 0; ptr && i < 18; i++)
+		ptr = strchr(ptr + 1, ' ');
+
+	return ptr ? strtoul(ptr + 1, NULL, 10) : 0;
+}
+
+/*
+ * Count the sleepers whose deadline is still ahead of `now` and store the
+ * earliest of those deadlines inside `first`. Sleepers which are already due
+ * are about to return, so they are running as far as the clock is concerned.
+ */
+static size_t pending_sleepers(long long now, long long *first)
+{
+	size_t count = 0;
+
+	*first = -1;
+
+	for (rk_sleeper_t *s = vclock.sleepers; s; s = s->next) {
+		if (s->deadline <= now)
+			continue;
+
+		if (*first == -1 || s->deadline < *first)
+			*first = s->deadline;
+
+		count++;
+	}
+
+	return count;
+}
+
+/*
+ * Move the virtual time forward to the earliest pending deadline, waking up
+ * the threads sleeping until then.
+ */
+static void jump_to_first(void)
+{
+	long long now = virtual_now(CLOCK_MONOTONIC);
+	long long first;
+
+	if (!pending_sleepers(now, &first))
+		return;
+
+	__atomic_fetch_add(&vclock.offset, first - now, __ATOMIC_ACQ_REL);
+	pthread_cond_broadcast(&vclock_cond);
+}
+
+/*
+ * Wait until the virtual time reaches `deadline` on the clock `clk`. While
+ * other threads are running, the time goes on at the real pace, unless the
+ * grace period is set. When `wait` is given, it's called to block for a real
+ * interval in milliseconds and if it returns a non-zero value, the sleep is
+ * interrupted.
+ */
+static int virtual_sleep(clockid_t clk, long long deadline,
+		int (*wait)(void *, int), void *data)
+{
+	rk_sleeper_t self, **pos;
+	struct timespec ts;
+	long long now, slice, offset, first;
+	int ret = 0;
+
+	pthread_mutex_lock(&vclock_lock);
+
+	self.deadline = deadline - virtual_now(clk) +
+		virtual_now(CLOCK_MONOTONIC);
+	self.next = vclock.sleepers;
+	vclock.sleepers = &self;
+
+	while ((now = virtual_now(clk)) < deadline) {
+		if (pending_sleepers(virtual_now(CLOCK_MONOTONIC), &first) >=
+				process_threads()) {
+			/* everyone is waiting a timer: jump to the first one */
+			jump_to_first();
+			continue;
+		}
+
+		slice = vclock.grace_ms ? vclock.grace_ms : CHECK_MS;
+		slice *= 1000000LL;
+		if (slice > deadline - now)
+			slice = deadline - now;
+
+		offset = vclock.offset;
+
+		if (wait) {
+			pthread_mutex_unlock(&vclock_lock);
+			ret = wait(data, (int)((slice + 999999) / 1000000));
+			pthread_mutex_lock(&vclock_lock);
+
+			if (ret)
+				break;
+		} else {
+			ns_to_ts(real_now(CLOCK_REALTIME) + slice, &ts);
+
+			if (pthread_cond_timedwait(&vclock_cond, &vclock_lock,
+					&ts) != ETIMEDOUT)
+				continue;
+		}
+
+		if (!vclock.grace_ms)
+			continue;
+
+		/* nobody else moved the time forward, so we do it */
+		if (vclock.offset == offset && virtual_now(clk) < deadline)
+			jump_to_first();
+	}
+
+	for (pos = &vclock.sleepers; *pos != &self; pos = &(*pos)->next)
+		;
+
+	*pos = self.next;
+
+	pthread_mutex_unlock(&vclock_lock);
+
+	return ret;
+}
+
+int clock_gettime(clockid_t clk, struct timespec *ts)
+{
+	int ret;
+
+	if (!real_clock_gettime)
+		rk_clock_init();
+
+	ret = real_clock_gettime(clk, ts);
+
+	if (!ret && vclock.enabled && is_shifted(clk))
+		ns_to_ts(ts_to_ns(ts) + vclock.offset, ts);
+
+	return ret;
+}
+
+int gettimeofday(struct timeval *restrict tv, void *restrict tz)
+{
+	long long now;
+
+	if (!real_gettimeofday)
+		rk_clock_init();
+
+	if (!vclock.enabled)
+		return real_gettimeofday(tv, tz);
+
+	now = virtual_now(CLOCK_REALTIME);
+	tv->tv_sec = (time_t)(now / NSEC_PER_SEC);
+	tv->tv_usec = (suseconds_t)((now % NSEC_PER_SEC) / 1000);
+
+	return 0;
+}
+
+time_t time(time_t *tloc)
+{
+	time_t now;
+
+	if (!real_time)
+		rk_clock_init();
+
+	if (!vclock.enabled)
+		return real_time(tloc);
+
+	now = (time_t)(virtual_now(CLOCK_REALTIME) / NSEC_PER_SEC);
+	if (tloc)
+		*tloc = now;
+
+	return now;
+}
+
+int clock_nanosleep(clockid_t clk, int flags, const struct timespec *req,
+		struct timespec *rem)
+{
+	long long deadline;
+
+	if (!real_clock_nanosleep)
+		rk_clock_init();
+
+	if (!vclock.enabled || !is_shifted(clk))
+		return real_clock_nanosleep(clk, flags, req, rem);
+
+	deadline = ts_to_ns(req);
+	if (!(flags & TIMER_ABSTIME))
+		deadline += virtual_now(clk);
+
+	virtual_sleep(clk, deadline, NULL, NULL);
+
+	if (rem)
+		memset(rem, 0, sizeof(*rem));
+
+	return 0;
+}
+
+int nanosleep(const struct timespec *req, struct timespec *rem)
+{
+	if (!real_nanosleep)
+		rk_clock_init();
+
+	if (!vclock.enabled)
+		return real_nanosleep(req, rem);
+
+	if (req->tv_nsec < 0 || req->tv_nsec >= NSEC_PER_SEC) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	return clock_nanosleep(CLOCK_MONOTONIC, 0, req, rem);
+}
+
+int usleep(useconds_t usec)
+{
+	struct timespec ts = {
+		.tv_sec = usec / 1000000,
+		.tv_nsec = (long)(usec % 1000000) * 1000,
+	};
+
+	return nanosleep(&ts, NULL);
+}
+
+unsigned int sleep(unsigned int seconds)
+{
+	struct timespec ts = { .tv_sec = seconds };
+
+	if (nanosleep(&ts, &ts) == -1)
+		return (unsigned int)ts.tv_sec;
+
+	return 0;
+}
+
+typedef struct
+{
+	struct pollfd *fds;
+	nfds_t nfds;
+	int ret;
+	char padding[4];
+} rk_poll_args_t;
+
+static int poll_wait(void *data, int timeout)
+{
+	rk_poll_args_t *args = data;
+
+	args->ret = real_poll(args->fds, args->nfds, timeout);
+
+	return args->ret;
+}
+
+int poll(struct pollfd *fds, nfds_t nfds, int timeout)
+{
+	rk_poll_args_t args = { .fds = fds, .nfds = nfds };
+
+	if (!real_poll)
+		rk_clock_init();
+
+	if (!vclock.enabled || timeout <= 0)
+		return real_poll(fds, nfds, timeout);
+
+	args.ret = real_poll(fds, nfds, 0);
+	if (args.ret)
+		return args.ret;
+
+	virtual_sleep(CLOCK_MONOTONIC,
+		virtual_now(CLOCK_MONOTONIC) + timeout * 1000000LL,
+		poll_wait, &args);
+
+	return args.ret;
+}
+
+typedef struct
+{
+	struct epoll_event *events;
+	int epfd;
+	int maxevents;
+	int ret;
+	char padding[4];
+} rk_epoll_args_t;
+
+static int epoll_wait_wait(void *data, int timeout)
+{
+	rk_epoll_args_t *args = data;
+
+	args->ret = real_epoll_wait(args->epfd, args->events, args->maxevents,
+			timeout);
+
+	return args->ret;
+}
+
+int epoll_wait(int epfd, struct epoll_event *events, int maxevents,
+		int timeout)
+{
+	rk_epoll_args_t args = {
+		.events = events,
+		.epfd = epfd,
+		.maxevents = maxevents,
+	};
+
+	if (!real_epoll_wait)
+		rk_clock_init();
+
+	if (!vclock.enabled || timeout <= 0)
+		return real_epoll_wait(epfd, events, maxevents, timeout);
+
+	args.ret = real_epoll_wait(epfd, events, maxevents, 0);
+	if (args.ret)
+		return args.ret;
+
+	virtual_sleep(CLOCK_MONOTONIC,
+		virtual_now(CLOCK_MONOTONIC) + timeout * 1000000LL,
+		epoll_wait_wait, &args);
+
+	return args.ret;
+}
+
+int rk_clock_enable(void)
+{
+	const char *grace = getenv("RIKER_CLOCK_GRACE_MS");
+
+	pthread_mutex_lock(&vclock_lock);
+	vclock.enabled = true;
+	vclock.grace_ms = grace ? strtoll(grace, NULL, 10) : 0;
+	if (vclock.grace_ms < 0)
+		vclock.grace_ms = 0;
+	pthread_mutex_unlock(&vclock_lock);
+
+	return 0;
+}
+
+void rk_clock_disable(void)
+{
+	pthread_mutex_lock(&vclock_lock);
+	vclock.enabled = false;
+	vclock.offset = 0;
+	pthread_cond_broadcast(&vclock_cond);
+	pthread_mutex_unlock(&vclock_lock);
+}
+
+void rk_clock_advance(unsigned long long ns)
+{
+	pthread_mutex_lock(&vclock_lock);
+
+	if (vclock.enabled) {
+		__atomic_fetch_add(&vclock.offset, (long long)ns,
+			__ATOMIC_ACQ_REL);
+		pthread_cond_broadcast(&vclock_cond);
+	}
+
+	pthread_mutex_unlock(&vclock_lock);
+}
+
+unsigned long long rk_now_ns_(void)
+{
+	return (unsigned long long)real_now(CLOCK_MONOTONIC);
+}
+
+int rk_sleep_until_ns_(unsigned long long deadline)
+{
+	struct timespec ts;
+	int ret;
+
+	if (!real_clock_nanosleep)
+		rk_clock_init();
+
+	ns_to_ts((long long)deadline, &ts);
+
+	do {
+		ret = real_clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts,
+				NULL);
+	} while (ret == EINTR);
+
+	return ret;
+}
+
+#else
+
+int __attribute__((const)) rk_clock_enable(void)
+{
+	return -1;
+}
+
+void rk_clock_disable(void)
+{
+}
+
+void rk_clock_advance(unsigned long long ns)
+{
+	(void)ns;
+}
+
+unsigned long long rk_now_ns_(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (unsigned long long)ts.tv_sec * 1000000000ULL +
+		(unsigned long long)ts.tv_nsec;
+}
+
+int rk_sleep_until_ns_(unsigned long long deadline)
+{
+	struct timespec ts = {
+		.tv_sec = (time_t)(deadline / 1000000000ULL),
+		.tv_nsec = (long)(deadline % 1000000000ULL),
+	};
+	int ret;
+
+	do {
+		ret = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+	} while (ret == EINTR);
+
+	return ret;
+}
+
+#endif
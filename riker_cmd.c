@@ -0,0 +1,245 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) 2025 Andrea Cervesato <andrea.cervesato@mailbox.org>
+ */
+
+#define _GNU_SOURCE
+
+#include "riker_internal.h"
+#include <poll.h>
+#include <spawn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+/* Size of the chunks given to the output callback */
+#define CMD_CHUNK_SIZE (1024 * 1024)
+
+static int map_output(int fd, const char **buf, size_t *len)
+{
+	struct stat st;
+	void *ptr;
+
+	if (fstat(fd, &st))
+		return -1;
+
+	*len = (size_t)st.st_size;
+	*buf = "";
+
+	if (!*len)
+		return 0;
+
+	ptr = mmap(NULL, *len, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (ptr == MAP_FAILED)
+		return -1;
+
+	*buf = ptr;
+
+	return 0;
+}
+
+static int stream_output(int out_fd, int err_fd, const rk_cmd_opts_t *opts)
+{
+	struct pollfd fds[2] = {
+		{ .fd = out_fd, .events = POLLIN },
+		{ .fd = err_fd, .events = POLLIN },
+	};
+	int stream_fds[2] = { STDOUT_FILENO, STDERR_FILENO };
+	int open_fds = 2;
+	ssize_t len;
+	char *buf;
+
+	buf = malloc(CMD_CHUNK_SIZE);
+	if (!buf)
+		return -1;
+
+	while (open_fds) {
+		if (poll(fds, 2, -1) == -1) {
+			if (errno == EINTR)
+				continue;
+
+			break;
+		}
+
+		for (int i = 0; i < 2; i++) {
+			if (!fds[i].revents)
+				continue;
+
+			len = read(fds[i].fd, buf, CMD_CHUNK_SIZE);
+			if (len > 0) {
+				opts->output(buf, (size_t)len, stream_fds[i],
+					opts->data);
+				continue;
+			}
+
+			if (len == -1 && errno == EINTR)
+				continue;
+
+			/* EOF or error: stop polling this stream */
+			fds[i].fd = -1;
+			open_fds--;
+		}
+	}
+
+	free(buf);
+
+	return 0;
+}
+
+static int open_output(int fds[2], const char *name, bool stream)
+{
+	if (stream)
+		return pipe2(fds, O_CLOEXEC);
+
+	fds[0] = memfd_create(name, MFD_CLOEXEC);
+	fds[1] = fds[0];
+
+	return fds[0] == -1 ? -1 : 0;
+}
+
+static void close_output(int fds[2])
+{
+	if (fds[0] != -1)
+		close(fds[0]);
+
+	if (fds[1] != -1 && fds[1] != fds[0])
+		close(fds[1]);
+
+	fds[0] = -1;
+	fds[1] = -1;
+}
+
+int rk_run_cmd(char *const argv[], const rk_cmd_opts_t *opts,
+		rk_cmd_result_t *res)
+{
+	posix_spawn_file_actions_t actions;
+	bool stream = opts && opts->output;
+	int out[2] = { -1, -1 };
+	int err[2] = { -1, -1 };
+	int status, ret;
+	pid_t pid;
+
+	assert(argv && argv[0]);
+	assert(res);
+
+	memset(res, 0, sizeof(rk_cmd_result_t));
+	res->out = "";
+	res->err = "";
+	res->out_fd = -1;
+	res->err_fd = -1;
+
+	if (open_output(out, "riker-stdout", stream) ||
+		open_output(err, "riker-stderr", stream)) {
+		ret = errno;
+		goto error;
+	}
+
+	/*
+	 * When output is captured, the memory files are the command's
+	 * stdout and stderr, so data never goes through our buffers.
+	 */
+	posix_spawn_file_actions_init(&actions);
+	posix_spawn_file_actions_adddup2(&actions, out[1], STDOUT_FILENO);
+	posix_spawn_file_actions_adddup2(&actions, err[1], STDERR_FILENO);
+
+	ret = posix_spawnp(&pid, argv[0], &actions, NULL, argv,
+			opts && opts->envp ? opts->envp : environ);
+
+	posix_spawn_file_actions_destroy(&actions);
+
+	if (ret)
+		goto error;
+
+	if (stream) {
+		close(out[1]);
+		close(err[1]);
+		out[1] = -1;
+		err[1] = -1;
+
+		stream_output(out[0], err[0], opts);
+	}
+
+	while (waitpid(pid, &status, 0) == -1) {
+		if (errno != EINTR) {
+			ret = errno;
+			goto error;
+		}
+	}
+
+	if (WIFSIGNALED(status)) {
+		res->exit_status = -1;
+		res->signal = WTERMSIG(status);
+	} else {
+		res->exit_status = WEXITSTATUS(status);
+	}
+
+	if (stream) {
+		close_output(out);
+		close_output(err);
+		return 0;
+	}
+
+	res->out_fd = out[0];
+	res->err_fd = err[0];
+
+	if (map_output(res->out_fd, &res->out, &res->out_len) ||
+		map_output(res->err_fd, &res->err, &res->err_len)) {
+		ret = errno;
+		rk_cmd_release(res);
+		errno = ret;
+		return -1;
+	}
+
+	return 0;
+
+error:
+	close_output(out);
+	close_output(err);
+	errno = ret;
+
+	return -1;
+}
+
+void rk_cmd_release(rk_cmd_result_t *res)
+{
+	assert(res);
+
+	if (res->out_len)
+		munmap((void *)(uintptr_t)res->out, res->out_len);
+
+	if (res->err_len)
+		munmap((void *)(uintptr_t)res->err, res->err_len);
+
+	if (res->out_fd != -1)
+		close(res->out_fd);
+
+	if (res->err_fd != -1)
+		close(res->err_fd);
+
+	res->out = "";
+	res->err = "";
+	res->out_len = 0;
+	res->err_len = 0;
+	res->out_fd = -1;
+	res->err_fd = -1;
+}
+
+unsigned long long rk_hash(const void *buf, size_t len)
+{
+	const unsigned char *ptr = buf;
+	unsigned long long hash = 0xcbf29ce484222325ULL;
+
+	/* FNV-1a */
+	for (size_t i = 0; i < len; i++) {
+		hash ^= ptr[i];
+		hash *= 0x100000001b3ULL;
+	}
+
+	return hash;
+}
@@ -0,0 +1,266 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) 2025 Andrea Cervesato <andrea.cervesato@mailbox.org>
+ */
+
+#define _GNU_SOURCE
+
+#include "riker_internal.h"
+#include <stdlib.h>
+
+#ifdef RK_COVERAGE
+
+#include <limits.h>
+#include <ftw.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/* Directory of the coverage counted outside of the tests */
+#define COVERAGE_SUITE "suite"
+
+/* Directory of the coverage of the whole suite */
+#define COVERAGE_MERGED "merged"
+
+/* Room for a test directory is left after RIKER_COVERAGE_DIR */
+#define COVERAGE_DIR_SIZE (PATH_MAX - NAME_MAX - 1)
+
+/*
+ * Provided by libgcov. Dumps of all the coverage counters of the process
+ * are merged with the .gcda files found under GCOV_PREFIX.
+ */
+void __gcov_dump(void);
+void __gcov_reset(void);
+
+static char coverage_dir[COVERAGE_DIR_SIZE];
+
+static bool coverage_enabled(void)
+{
+	return coverage_dir[0];
+}
+
+static void set_prefix(const char *name)
+{
+	char prefix[PATH_MAX];
+
+	snprintf(prefix, sizeof(prefix), "%s/%s", coverage_dir, name);
+	setenv("GCOV_PREFIX", prefix, 1);
+}
+
+int rk_coverage_init_(void)
+{
+	const char *dir = getenv("RIKER_COVERAGE_DIR");
+
+	coverage_dir[0] = '\0';
+
+	if (!dir || !*dir)
+		return 0;
+
+	if (strlen(dir) >= sizeof(coverage_dir)) {
+		rk_result_(__FILE__, __LINE__, TINFO, "RIKER_COVERAGE_DIR is "
+			"too long");
+		return 0;
+	}
+
+	if (mkdir(dir, 0755) && errno != EEXIST) {
+		rk_result_(__FILE__, __LINE__, TINFO, "Can't create %s: %s",
+			dir, strerror(errno));
+		return 0;
+	}
+
+	snprintf(coverage_dir, sizeof(coverage_dir), "%s", dir);
+
+	/* counters of the suite itself are dumped at exit */
+	set_prefix(COVERAGE_SUITE);
+
+	rk_out_printf_("Collecting coverage of each test inside %s\n",
+		coverage_dir);
+
+	return 1;
+}
+
+void rk_coverage_reset_(void)
+{
+	if (coverage_enabled())
+		__gcov_reset();
+}
+
+void rk_coverage_detach_(void)
+{
+	if (coverage_enabled())
+		__gcov_reset();
+
+	coverage_dir[0] = '\0';
+}
+
+void rk_coverage_begin_(void)
+{
+	if (!coverage_enabled())
+		return;
+
+	/* what ran before the test is accounted to the suite */
+	__gcov_dump();
+	__gcov_reset();
+}
+
+void rk_coverage_end_(const char *name)
+{
+	char dir[NAME_MAX + 1];
+	size_t i;
+
+	if (!coverage_enabled())
+		return;
+
+	/* test names become directory names */
+	for (i = 0; name[i] && i < sizeof(dir) - 1; i++) {
+		if (name[i] == '/' || name[i] == ' ')
+			dir[i] = '_';
+		else
+			dir[i] = name[i];
+	}
+
+	dir[i] = '\0';
+
+	set_prefix(dir);
+	__gcov_dump();
+	__gcov_reset();
+	set_prefix(COVERAGE_SUITE);
+}
+
+static int remove_entry(const char *path, const struct stat *st, int flag,
+		struct FTW *ftw)
+{
+	(void)st;
+	(void)ftw;
+
+	return flag == FTW_DP ? rmdir(path) : unlink(path);
+}
+
+static void remove_dir(const char *path)
+{
+	nftw(path, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+/*
+ * Run gcov-tool, or the tool defined by RIKER_GCOV_TOOL, writing the
+ * profile into `out`. Without `dir2` the profile of `dir1` is copied.
+ */
+static int gcov_tool(char *out, char *dir1, char *dir2)
+{
+	char gcov[] = "gcov-tool", merge[] = "merge", rewrite[] = "rewrite";
+	char opt_o[] = "-o";
+	char *tool = getenv("RIKER_GCOV_TOOL");
+	char *const argv[] = {
+		tool ? tool : gcov, dir2 ? merge : rewrite, opt_o, out, dir1,
+		dir2, NULL,
+	};
+	rk_cmd_result_t res;
+	int ret;
+
+	if (rk_run_cmd(argv, NULL, &res)) {
+		rk_result_(__FILE__, __LINE__, TINFO, "Can't run %s: %s",
+			argv[0], strerror(errno));
+		return -1;
+	}
+
+	ret = res.exit_status ? -1 : 0;
+
+	if (ret) {
+		rk_result_(__FILE__, __LINE__, TINFO, "%s %s failed: %.*s",
+			argv[0], argv[1], (int)res.err_len, res.err);
+	}
+
+	rk_cmd_release(&res);
+
+	return ret;
+}
+
+void rk_coverage_merge_(void)
+{
+	char merged[PATH_MAX], next[PATH_MAX], path[PATH_MAX];
+	struct dirent *entry;
+	size_t count = 0;
+	DIR *dir;
+
+	if (!coverage_enabled())
+		return;
+
+	/* coverage of the suite itself, which would be dumped at exit */
+	__gcov_dump();
+	__gcov_reset();
+
+	dir = opendir(coverage_dir);
+	if (!dir)
+		return;
+
+	snprintf(merged, sizeof(merged), "%s/" COVERAGE_MERGED, coverage_dir);
+	snprintf(next, sizeof(next), "%s/" COVERAGE_MERGED ".tmp",
+		coverage_dir);
+
+	remove_dir(merged);
+	remove_dir(next);
+
+	/* gcov-tool crashes when GCOV_PREFIX is defined */
+	unsetenv("GCOV_PREFIX");
+
+	/* per-test directories are kept for impact analysis */
+	while ((entry = readdir(dir))) {
+		if (entry->d_name[0] == '.' ||
+			!strcmp(entry->d_name, COVERAGE_MERGED) ||
+			!strcmp(entry->d_name, COVERAGE_MERGED ".tmp"))
+			continue;
+
+		snprintf(path, sizeof(path), "%s/%s", coverage_dir,
+			entry->d_name);
+
+		/* gcov-tool merges two directories at a time */
+		if (gcov_tool(next, path, count ? merged : NULL))
+			break;
+
+		remove_dir(merged);
+		rename(next, merged);
+		count++;
+	}
+
+	closedir(dir);
+	set_prefix(COVERAGE_SUITE);
+
+	if (count)
+		rk_out_printf_("Coverage of %zu directories merged inside %s\n",
+			count, merged);
+}
+
+#else
+
+int rk_coverage_init_(void)
+{
+	if (getenv("RIKER_COVERAGE_DIR")) {
+		rk_result_(__FILE__, __LINE__, TINFO, "Coverage is not "
+			"available, riker is built without b_coverage");
+	}
+
+	return 0;
+}
+
+void rk_coverage_reset_(void)
+{
+}
+
+void rk_coverage_detach_(void)
+{
+}
+
+void rk_coverage_begin_(void)
+{
+}
+
+void rk_coverage_end_(const char *name)
+{
+	(void)name;
+}
+
+void rk_coverage_merge_(void)
+{
+}
+
+#endif
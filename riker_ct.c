@@ -0,0 +1,213 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) 2025 Andrea Cervesato <andrea.cervesato@mailbox.org>
+ */
+
+#define _GNU_SOURCE
+
+#include "riker_internal.h"
+#include <math.h>
+#include <errno.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+/* Number of inputs generated before measuring them */
+#define CT_BATCH 1024
+
+/* Number of measurements executed before recording the samples */
+#define CT_WARMUP 1000
+
+/*
+ * Samples are cropped above these percentiles (in permille), since large
+ * measurements are mostly due to interrupts and preemption.
+ */
+static const unsigned int ct_crops[] = {
+	500, 750, 875, 938, 969, 984, 992, 996, 998, 999,
+};
+
+#define CT_TESTS (sizeof(ct_crops) / sizeof(ct_crops[0]) + 1)
+
+typedef struct
+{
+	double mean[2];
+	double m2[2];
+	double count[2];
+} rk_welch_t;
+
+static inline unsigned long long ct_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	unsigned int lo, hi;
+
+	__asm__ __volatile__("lfence\n\trdtsc\n\tlfence"
+		: "=a" (lo), "=d" (hi) : : "memory");
+
+	return ((unsigned long long)hi << 32) | lo;
+#else
+	return rk_now_ns_();
+#endif
+}
+
+static unsigned long long ct_random(unsigned long long *state)
+{
+	/* xorshift64 */
+	*state ^= *state << 13;
+	*state ^= *state >> 7;
+	*state ^= *state << 17;
+
+	return *state;
+}
+
+static int ct_compare(const void *a, const void *b)
+{
+	unsigned long long x = *(const unsigned long long *)a;
+	unsigned long long y = *(const unsigned long long *)b;
+
+	return (x > y) - (x < y);
+}
+
+static void welch_push(rk_welch_t *test, int cls, double value)
+{
+	double delta = value - test->mean[cls];
+
+	/* Welford's online algorithm */
+	test->count[cls]++;
+	test->mean[cls] += delta / test->count[cls];
+	test->m2[cls] += delta * (value - test->mean[cls]);
+}
+
+static double __attribute__((pure)) welch_t(const rk_welch_t *test)
+{
+	double var0, var1;
+
+	if (test->count[0] < 2 || test->count[1] < 2)
+		return 0;
+
+	var0 = test->m2[0] / (test->count[0] - 1);
+	var1 = test->m2[1] / (test->count[1] - 1);
+
+	if (var0 + var1 <= 0)
+		return 0;
+
+	return fabs(test->mean[0] - test->mean[1]) /
+		sqrt(var0 / test->count[0] + var1 / test->count[1]);
+}
+
+static void measure(rk_ct_func fn, const unsigned char *inputs, size_t size,
+		size_t count, unsigned long long *times)
+{
+	unsigned long long start;
+
+	for (size_t i = 0; i < count; i++) {
+		start = ct_cycles();
+		fn(inputs + i * size, size);
+		times[i] = ct_cycles() - start;
+	}
+}
+
+static double analyze(const unsigned long long *times,
+		const unsigned char *classes, unsigned long long *sorted,
+		size_t samples)
+{
+	rk_welch_t tests[CT_TESTS];
+	unsigned long long limit[CT_TESTS];
+	double t, max_t = 0;
+
+	memcpy(sorted, times, samples * sizeof(unsigned long long));
+	qsort(sorted, samples, sizeof(unsigned long long), ct_compare);
+
+	memset(tests, 0, sizeof(tests));
+
+	/* the first test uses all the samples */
+	limit[0] = sorted[samples - 1];
+	for (size_t j = 1; j < CT_TESTS; j++)
+		limit[j] = sorted[samples * ct_crops[j - 1] / 1000];
+
+	for (size_t i = 0; i < samples; i++) {
+		for (size_t j = 0; j < CT_TESTS; j++) {
+			if (times[i] <= limit[j])
+				welch_push(tests + j, classes[i], (double)times[i]);
+		}
+	}
+
+	for (size_t j = 0; j < CT_TESTS; j++) {
+		t = welch_t(tests + j);
+		if (t > max_t)
+			max_t = t;
+	}
+
+	return max_t;
+}
+
+int rk_constant_time_(rk_ct_func fn, rk_ct_gen gen, size_t size,
+		size_t samples, double *t)
+{
+	unsigned long long *times = NULL, *sorted = NULL;
+	unsigned char *inputs = NULL, *classes = NULL;
+	unsigned long long seed = rk_now_ns_() | 1;
+	cpu_set_t old_mask, mask;
+	bool pinned = false;
+	size_t batch, warmup;
+	int cpu, ret = -1;
+
+	assert(fn);
+	assert(gen);
+	assert(t);
+
+	if (samples < 2 || !size) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	/* all buffers are allocated before measuring anything */
+	times = malloc(samples * sizeof(unsigned long long));
+	sorted = malloc(samples * sizeof(unsigned long long));
+	classes = malloc(samples);
+	inputs = malloc(CT_BATCH * size);
+
+	if (!times || !sorted || !classes || !inputs)
+		goto exit;
+
+	/* measurements are more stable when we don't migrate across CPUs */
+	cpu = sched_getcpu();
+	if (cpu != -1 && !sched_getaffinity(0, sizeof(old_mask), &old_mask)) {
+		CPU_ZERO(&mask);
+		CPU_SET((size_t)cpu, &mask);
+
+		pinned = !sched_setaffinity(0, sizeof(mask), &mask);
+	}
+
+	/* both classes are interleaved at random */
+	for (size_t i = 0; i < samples; i++)
+		classes[i] = (unsigned char)(ct_random(&seed) & 1);
+
+	for (size_t i = 0; i < samples; i += batch) {
+		batch = samples - i < CT_BATCH ? samples - i : CT_BATCH;
+
+		for (size_t j = 0; j < batch; j++)
+			gen(inputs + j * size, size, classes[i + j]);
+
+		if (!i) {
+			/* warm up caches and branch predictors */
+			for (warmup = 0; warmup < CT_WARMUP; warmup += batch)
+				measure(fn, inputs, size, batch, times);
+		}
+
+		measure(fn, inputs, size, batch, times + i);
+	}
+
+	if (pinned)
+		sched_setaffinity(0, sizeof(old_mask), &old_mask);
+
+	*t = analyze(times, classes, sorted, samples);
+	ret = 0;
+
+exit:
+	free(times);
+	free(sorted);
+	free(classes);
+	free(inputs);
+
+	return ret;
+}
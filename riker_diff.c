@@ -0,0 +1,336 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) 2025 Andrea Cervesato <andrea.cervesato@mailbox.org>
+ */
+
+#include "riker_internal.h"
+#include <stdbool.h>
+
+/* Maximum number of edited lines before giving up with the diff */
+#define DIFF_MAX_EDITS 1000
+
+/* Lines of context around each hunk */
+#define DIFF_CONTEXT 3
+
+typedef struct
+{
+	const char *ptr;
+	size_t len;
+	unsigned long long hash;
+} rk_line_t;
+
+typedef struct
+{
+	rk_line_t *lines;
+	bool *changed;
+	size_t count;
+} rk_text_t;
+
+typedef struct
+{
+	rk_text_t a;
+	rk_text_t b;
+	long *vf;
+	long *vb;
+	long max_d;
+} rk_diff_t;
+
+typedef struct
+{
+	long x;
+	long y;
+	long u;
+	long v;
+	long d;
+} rk_snake_t;
+
+static int split_lines(rk_text_t *text, const char *buf, size_t len)
+{
+	const char *end = buf + len;
+	const char *pos;
+	size_t count = 0;
+
+	for (pos = buf; pos < end; count++) {
+		pos = memchr(pos, '\n', (size_t)(end - pos));
+		if (!pos)
+			pos = end;
+		else
+			pos++;
+	}
+
+	text->count = count;
+	text->lines = rk_arena_alloc((count + 1) * sizeof(rk_line_t), 0);
+	text->changed = rk_arena_alloc((count + 1) * sizeof(bool), 0);
+
+	if (!text->lines || !text->changed)
+		return -1;
+
+	memset(text->changed, 0, (count + 1) * sizeof(bool));
+
+	for (size_t i = 0; i < count; i++) {
+		pos = memchr(buf, '\n', (size_t)(end - buf));
+		pos = pos ? pos + 1 : end;
+
+		text->lines[i].ptr = buf;
+		text->lines[i].len = (size_t)(pos - buf);
+		text->lines[i].hash = rk_hash(buf, text->lines[i].len);
+
+		buf = pos;
+	}
+
+	return 0;
+}
+
+static bool __attribute__((pure)) line_eq(const rk_line_t *a,
+		const rk_line_t *b)
+{
+	return a->hash == b->hash && a->len == b->len &&
+		!memcmp(a->ptr, b->ptr, a->len);
+}
+
+/*
+ * Find the middle snake of the shortest edit script between a[a0, a1) and
+ * b[b0, b1), as described in "An O(ND) Difference Algorithm and Its
+ * Variations" by Eugene W. Myers. Forward and backward searches only need
+ * diagonals within max_d, so memory doesn't grow with the texts size.
+ * Returns -1 if the edit distance is higher than 2 * max_d.
+ */
+static int middle_snake(rk_diff_t *diff, long a0, long a1, long b0, long b1,
+		rk_snake_t *snake)
+{
+	const rk_line_t *a = diff->a.lines + a0;
+	const rk_line_t *b = diff->b.lines + b0;
+	long n = a1 - a0;
+	long m = b1 - b0;
+	long delta = n - m;
+	bool odd = delta & 1;
+	long *vf = diff->vf + diff->max_d + 1;
+	long *vb = diff->vb + diff->max_d + 1;
+	long max_d = (n + m + 1) / 2;
+	long x, y, xs, ys, k;
+
+	if (max_d > diff->max_d)
+		max_d = diff->max_d;
+
+	vf[1] = 0;
+	vb[1] = 0;
+
+	for (long d = 0; d <= max_d; d++) {
+		for (k = -d; k <= d; k += 2) {
+			if (k == -d || (k != d && vf[k - 1] < vf[k + 1]))
+				x = vf[k + 1];
+			else
+				x = vf[k - 1] + 1;
+
+			y = x - k;
+			xs = x;
+			ys = y;
+
+			while (x < n && y < m && line_eq(a + x, b + y)) {
+				x++;
+				y++;
+			}
+
+			vf[k] = x;
+
+			if (odd && delta - k > -d && delta - k < d &&
+				vf[k] + vb[delta - k] >= n) {
+				snake->x = xs;
+				snake->y = ys;
+				snake->u = x;
+				snake->v = y;
+				snake->d = 2 * d - 1;
+				return 0;
+			}
+		}
+
+		for (k = -d; k <= d; k += 2) {
+			if (k == -d || (k != d && vb[k - 1] < vb[k + 1]))
+				x = vb[k + 1];
+			else
+				x = vb[k - 1] + 1;
+
+			y = x - k;
+			xs = x;
+			ys = y;
+
+			while (x < n && y < m &&
+				line_eq(a + n - x - 1, b + m - y - 1)) {
+				x++;
+				y++;
+			}
+
+			vb[k] = x;
+
+			if (!odd && delta - k >= -d && delta - k <= d &&
+				vb[k] + vf[delta - k] >= n) {
+				snake->x = n - x;
+				snake->y = m - y;
+				snake->u = n - xs;
+				snake->v = m - ys;
+				snake->d = 2 * d;
+				return 0;
+			}
+		}
+	}
+
+	return -1;
+}
+
+static int compare(rk_diff_t *diff, long a0, long a1, long b0, long b1)
+{
+	rk_snake_t snake;
+
+	while (a0 < a1 && b0 < b1 &&
+		line_eq(diff->a.lines + a0, diff->b.lines + b0)) {
+		a0++;
+		b0++;
+	}
+
+	while (a0 < a1 && b0 < b1 &&
+		line_eq(diff->a.lines + a1 - 1, diff->b.lines + b1 - 1)) {
+		a1--;
+		b1--;
+	}
+
+	if (a0 == a1) {
+		while (b0 < b1)
+			diff->b.changed[b0++] = true;
+
+		return 0;
+	}
+
+	if (b0 == b1) {
+		while (a0 < a1)
+			diff->a.changed[a0++] = true;
+
+		return 0;
+	}
+
+	if (middle_snake(diff, a0, a1, b0, b1, &snake))
+		return -1;
+
+	if (compare(diff, a0, a0 + snake.x, b0, b0 + snake.y))
+		return -1;
+
+	return compare(diff, a0 + snake.u, a1, b0 + snake.v, b1);
+}
+
+static void print_line(char type, const rk_line_t *line)
+{
+	int len = (int)line->len;
+
+	if (len && line->ptr[len - 1] == '\n')
+		len--;
+
+	rk_out_printf_("%c%.*s\n", type, len, line->ptr);
+}
+
+static void print_hunks(rk_diff_t *diff)
+{
+	size_t na = diff->a.count;
+	size_t nb = diff->b.count;
+	size_t i = 0, j = 0;
+	size_t hi, hj, ei, ej, ctx;
+
+	while (i < na || j < nb) {
+		/* skip unchanged lines up to the next change */
+		while (i < na && j < nb && !diff->a.changed[i] &&
+			!diff->b.changed[j]) {
+			i++;
+			j++;
+		}
+
+		if (i == na && j == nb)
+			break;
+
+		hi = i > DIFF_CONTEXT ? i - DIFF_CONTEXT : 0;
+		hj = j - (i - hi);
+
+		/* extend the hunk while changes are close to each other */
+		ei = i;
+		ej = j;
+		ctx = 0;
+
+		while ((ei < na || ej < nb) && ctx <= 2 * DIFF_CONTEXT) {
+			if ((ei < na && diff->a.changed[ei]) ||
+				(ej < nb && diff->b.changed[ej])) {
+				while (ei < na && diff->a.changed[ei])
+					ei++;
+				while (ej < nb && diff->b.changed[ej])
+					ej++;
+				ctx = 0;
+			} else {
+				ei++;
+				ej++;
+				ctx++;
+			}
+		}
+
+		if (ctx > DIFF_CONTEXT) {
+			ei -= ctx - DIFF_CONTEXT;
+			ej -= ctx - DIFF_CONTEXT;
+		}
+
+		if (ei > na)
+			ei = na;
+		if (ej > nb)
+			ej = nb;
+
+		/* empty ranges start at the line before them */
+		rk_out_printf_("@@ -%zu,%zu +%zu,%zu @@\n",
+			ei > hi ? hi + 1 : hi, ei - hi,
+			ej > hj ? hj + 1 : hj, ej - hj);
+
+		while (hi < ei || hj < ej) {
+			if (hi < ei && diff->a.changed[hi]) {
+				print_line('-', diff->a.lines + hi++);
+			} else if (hj < ej && diff->b.changed[hj]) {
+				print_line('+', diff->b.lines + hj++);
+			} else {
+				print_line(' ', diff->a.lines + hi++);
+				hj++;
+			}
+		}
+
+		i = ei;
+		j = ej;
+	}
+}
+
+void rk_diff_(const char *a_name, const char *a, size_t a_len,
+		const char *b_name, const char *b, size_t b_len)
+{
+	rk_diff_t diff = { .max_d = DIFF_MAX_EDITS / 2 + 1 };
+	rk_arena_mark_t mark = rk_arena_mark_();
+	size_t size, line = 1;
+
+	if (split_lines(&diff.a, a, a_len) || split_lines(&diff.b, b, b_len))
+		goto exit;
+
+	size = (size_t)(2 * diff.max_d + 3) * sizeof(long);
+
+	diff.vf = rk_arena_alloc(size, 0);
+	diff.vb = rk_arena_alloc(size, 0);
+	if (!diff.vf || !diff.vb)
+		goto exit;
+
+	memset(diff.vf, 0, size);
+	memset(diff.vb, 0, size);
+
+	if (compare(&diff, 0, (long)diff.a.count, 0, (long)diff.b.count)) {
+		while (line <= diff.a.count && line <= diff.b.count &&
+			line_eq(diff.a.lines + line - 1, diff.b.lines + line - 1))
+			line++;
+
+		rk_out_printf_("More than %d lines differ, first difference at "
+			"line %zu\n", DIFF_MAX_EDITS, line);
+		goto exit;
+	}
+
+	rk_out_printf_("--- %s\n+++ %s\n", a_name, b_name);
+	print_hunks(&diff);
+
+exit:
+	rk_arena_rewind_(mark);
+}
@@ -0,0 +1,175 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) 2025 Andrea Cervesato <andrea.cervesato@mailbox.org>
+ */
+
+#define _GNU_SOURCE
+
+#include "riker_internal.h"
+#include <stdlib.h>
+#include <stdbool.h>
+
+typedef struct
+{
+	char *name;
+	unsigned long long rss_kb;
+	unsigned long long duration_us;
+} rk_history_entry_t;
+
+typedef struct
+{
+	rk_history_entry_t *entries;
+	size_t count;
+	size_t size;
+	bool changed;
+	char padding[7];
+} rk_history_t;
+
+static rk_history_t history;
+
+static rk_history_entry_t *__attribute__((pure)) find(const char *name)
+{
+	for (size_t i = 0; i < history.count; i++) {
+		if (!strcmp(history.entries[i].name, name))
+			return history.entries + i;
+	}
+
+	return NULL;
+}
+
+static rk_history_entry_t *add(const char *name)
+{
+	rk_history_entry_t *entry;
+
+	if (history.count == history.size) {
+		entry = realloc(history.entries, (history.size + 64) *
+				sizeof(rk_history_entry_t));
+		if (!entry)
+			return NULL;
+
+		history.entries = entry;
+		history.size += 64;
+	}
+
+	entry = history.entries + history.count;
+	entry->name = strdup(name);
+	if (!entry->name)
+		return NULL;
+
+	history.count++;
+
+	return entry;
+}
+
+void rk_history_load_(void)
+{
+	const char *path = getenv("RIKER_HISTORY");
+	unsigned long long rss_kb, duration_us;
+	rk_history_entry_t *entry;
+	size_t size = 0;
+	char *line = NULL;
+	ssize_t len;
+	int offset;
+	FILE *file;
+
+	if (!path)
+		return;
+
+	file = fopen(path, "re");
+	if (!file)
+		return;
+
+	/* each line is "<peak RSS in kB> <duration in us> <test name>" */
+	while ((len = getline(&line, &size, file)) > 0) {
+		if (line[len - 1] == '\n')
+			line[len - 1] = '\0';
+
+		if (sscanf(line, "%llu %llu %n", &rss_kb, &duration_us,
+				&offset) != 2 || !line[offset])
+			continue;
+
+		entry = find(line + offset);
+		if (!entry)
+			entry = add(line + offset);
+
+		if (entry) {
+			entry->rss_kb = rss_kb;
+			entry->duration_us = duration_us;
+		}
+	}
+
+	free(line);
+	fclose(file);
+}
+
+int rk_history_get_(const char *name, unsigned long long *rss_kb,
+		unsigned long long *duration_us)
+{
+	rk_history_entry_t *entry;
+
+	/* a generated name would follow the position of the test */
+	if (!name)
+		return -1;
+
+	entry = find(name);
+	if (!entry)
+		return -1;
+
+	*rss_kb = entry->rss_kb;
+	*duration_us = entry->duration_us;
+
+	return 0;
+}
+
+void rk_history_set_(const char *name, unsigned long long rss_kb,
+		unsigned long long duration_us)
+{
+	rk_history_entry_t *entry;
+
+	if (!name)
+		return;
+
+	entry = find(name);
+	if (!entry)
+		entry = add(name);
+
+	if (!entry)
+		return;
+
+	entry->rss_kb = rss_kb;
+	entry->duration_us = duration_us;
+	history.changed = true;
+}
+
+void rk_history_save_(void)
+{
+	const char *path = getenv("RIKER_HISTORY");
+	char tmp_path[4096];
+	FILE *file;
+
+	if (!path || !history.changed)
+		goto exit;
+
+	/* the journal is replaced at once, so it's never left truncated */
+	snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+	file = fopen(tmp_path, "we");
+	if (!file)
+		goto exit;
+
+	for (size_t i = 0; i < history.count; i++) {
+		fprintf(file, "%llu %llu %s\n", history.entries[i].rss_kb,
+			history.entries[i].duration_us,
+			history.entries[i].name);
+	}
+
+	if (fclose(file) || rename(tmp_path, path))
+		remove(tmp_path);
+
+exit:
+	for (size_t i = 0; i < history.count; i++)
+		free(history.entries[i].name);
+
+	free(history.entries);
+	memset(&history, 0, sizeof(rk_history_t));
+}
@@ -0,0 +1,434 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) 2025 Andrea Cervesato <andrea.cervesato@mailbox.org>
+ */
+
+#ifndef RIKER_INTERNAL_H
+#define RIKER_INTERNAL_H
+
+/* The library never provides main(), that's up to the testing binary */
+#define TEST_CUSTOM_MAIN 1
+
+#include "riker.h"
+#include <stdbool.h>
+
+/**
+ * @brief Phase of the testing session.
+ */
+typedef enum
+{
+	SUITE_SETUP = 0,
+	SUITE_RUN,
+	SUITE_TEARDOWN,
+	TEST_RUN,
+	TEST_SETUP,
+	TEST_TEARDOWN,
+} rk_session_state_t;
+
+/**
+ * @brief Results counters. The session ones are in shared memory, so forked
+ * tests can update them.
+ */
+typedef struct
+{
+	size_t passed;
+	size_t failed;
+	size_t skipped;
+	size_t errors;
+} rk_counters_t;
+
+/**
+ * @brief Set the test which is currently running and its phase.
+ *
+ * @param test Test which is running.
+ * @param state Current phase of the test.
+ */
+void rk_session_set_(rk_test_t *test, rk_session_state_t state);
+
+/**
+ * @brief Count the results of the following checks into other counters.
+ *
+ * @param counters Counters to update, NULL to restore the session ones.
+ */
+void rk_session_count_(rk_counters_t *counters);
+
+/**
+ * @brief Read the counters which the results of the running test go to.
+ *
+ * @param counters Copy of the counters.
+ */
+void rk_session_results_(rk_counters_t *counters);
+
+/**
+ * @brief Add results to the session counters.
+ *
+ * @param counters Results to add.
+ */
+void rk_session_add_(const rk_counters_t *counters);
+
+/**
+ * @brief Run a list of asynchronous tests concurrently.
+ *
+ * @param tests List of tests having the `async` callback.
+ * @param count Number of tests inside the list.
+ */
+void rk_run_async_(rk_test_t *tests, size_t count);
+
+/**
+ * @brief Reset the lock contention counters before running a new test.
+ */
+void rk_lock_reset_(void);
+
+/**
+ * @brief Print the most contended locks of the test which just completed.
+ */
+void rk_lock_report_(void);
+
+/**
+ * @brief Read the monotonic clock, bypassing the virtual clock.
+ *
+ * @return Current time in nanoseconds.
+ */
+unsigned long long rk_now_ns_(void);
+
+/**
+ * @brief Sleep until an absolute time of the monotonic clock, bypassing the
+ * virtual clock.
+ *
+ * @param deadline Wake up time in nanoseconds, as given by @ref rk_now_ns_.
+ * @return 0 on success, an error number otherwise.
+ */
+int rk_sleep_until_ns_(unsigned long long deadline);
+
+/**
+ * @brief Allocate the resource records of the testing suite.
+ *
+ * @param count Number of tests inside the testing suite.
+ */
+void rk_res_init_(size_t count);
+
+/**
+ * @brief Start collecting resources of a test.
+ *
+ * @param index Index of the test inside the testing suite.
+ * @param name Name of the test. It can be NULL.
+ */
+void rk_res_start_(size_t index, const char *name);
+
+/**
+ * @brief Move to a new phase of the test which is running.
+ *
+ * @param block New phase, as defined by @ref rk_io_block_t, or -1 when the
+ * test has completed.
+ */
+void rk_res_phase_(int block);
+
+/**
+ * @brief Stop recording resources inside a process which is going to run
+ * tests again, leaving the records of the testing suite untouched.
+ */
+void rk_res_detach_(void);
+
+/**
+ * @brief Print the resource table if RIKER_RESOURCES is set and release the
+ * resource records.
+ */
+void rk_res_report_(void);
+
+/**
+ * @brief Name of a test, as shown inside reports.
+ *
+ * @param test Test.
+ * @param index Index of the test inside the testing suite.
+ * @param buf Buffer where the name is written.
+ * @param size Size of the buffer.
+ * @return The name of the test.
+ */
+const char *rk_test_name_(const rk_test_t *test, size_t index, char *buf,
+		size_t size);
+
+typedef void (*rk_run_func_)(size_t index);
+
+/**
+ * @brief Check if a test runs on the pool of threads.
+ *
+ * @param test Test.
+ * @param threads Number of threads of the pool, 0 if there's no pool.
+ * @return true if the test runs on the pool.
+ */
+bool rk_test_pooled_(const rk_test_t *test, unsigned int threads)
+		__attribute__ ((pure));
+
+/**
+ * @brief Run a test once for each ISA level supported by the CPU, forcing
+ * the registered dispatch points, then print the speedup table.
+ *
+ * @param test Test to run.
+ * @param index Index of the test inside the testing suite.
+ * @param run Function running the test.
+ */
+void rk_isa_sweep_(rk_test_t *test, size_t index,
+		void (*run)(rk_test_t *test, size_t index));
+
+/**
+ * @brief Run the synchronous tests of a suite inside forked processes.
+ *
+ * Tests are admitted according to their peak memory, as recorded by the
+ * history journal, so that running tests fit inside the memory budget.
+ * Consecutive tests which are known to be short share the same process.
+ *
+ * @param tests List of tests.
+ * @param count Number of tests inside the list.
+ * @param jobs Maximum number of tests running at the same time.
+ * @param threads Number of threads of the pool, whose tests are skipped.
+ * @param run Function running the test at the given index.
+ */
+void rk_run_parallel_(rk_test_t *tests, size_t count, unsigned int jobs,
+		unsigned int threads, rk_run_func_ run);
+
+/**
+ * @brief Run the tests flagged as @ref RK_TEST_THREAD_SAFE on a pool of
+ * threads, inside the current process. See @ref rk_test_pooled_.
+ *
+ * Tests are split between the threads, which steal tests from the others
+ * once they completed their own ones.
+ *
+ * @param tests List of tests.
+ * @param count Number of tests inside the list.
+ * @param threads Number of threads of the pool.
+ * @param run Function running the test at the given index.
+ */
+void rk_run_pool_(rk_test_t *tests, size_t count, unsigned int threads,
+		rk_run_func_ run);
+
+/**
+ * @brief Position inside the arena of the thread.
+ */
+typedef struct
+{
+	void *chunk;
+	size_t offset;
+} rk_arena_mark_t;
+
+/**
+ * @brief Read the current position of the arena.
+ *
+ * @return Position to give to @ref rk_arena_rewind_.
+ */
+rk_arena_mark_t rk_arena_mark_(void) __attribute__ ((pure));
+
+/**
+ * @brief Release the memory allocated after a position of the arena.
+ *
+ * @param mark Position returned by @ref rk_arena_mark_.
+ */
+void rk_arena_rewind_(rk_arena_mark_t mark);
+
+/**
+ * @brief Release the memory allocated by the test which completed, keeping
+ * the chunks for the next one.
+ */
+void rk_arena_reset_(void);
+
+/**
+ * @brief Unmap the chunks of the arena of the thread.
+ */
+void rk_arena_release_(void);
+
+/**
+ * @brief Map a chunk of memory from the allocator of the arena, outside of
+ * the arena itself. Such chunks outlive the tests and they're never reset.
+ *
+ * @param size Size of the chunk.
+ * @return Pointer to the chunk, NULL on error.
+ */
+void *rk_arena_chunk_(size_t size) __attribute__ ((malloc));
+
+/**
+ * @brief Unmap a chunk returned by @ref rk_arena_chunk_.
+ *
+ * @param chunk Chunk to unmap.
+ * @param size Size of the chunk.
+ */
+void rk_arena_unchunk_(void *chunk, size_t size);
+
+/**
+ * @brief Logical CPU, as described by sysfs.
+ */
+typedef struct
+{
+	/** @brief CPU number. */
+	int cpu;
+	/** @brief Physical package (socket). */
+	int package;
+	/** @brief Core ID, unique inside the package only. */
+	int core_id;
+	/** @brief Physical core, unique inside the topology. */
+	int core;
+	/** @brief First CPU sharing the last level cache. */
+	int llc;
+} rk_cpu_t;
+
+/**
+ * @brief CPUs where the process is allowed to run.
+ */
+typedef struct
+{
+	rk_cpu_t *cpus;
+	size_t count;
+	unsigned int packages;
+	unsigned int cores;
+	unsigned int llcs;
+	char padding[4];
+} rk_topology_t;
+
+/**
+ * @brief Read the topology of the CPUs where the process can run.
+ *
+ * @param topo Topology to fill, released by @ref rk_topology_free_.
+ * @return 0 on success, -1 on error.
+ */
+int rk_topology_read_(rk_topology_t *topo);
+
+/**
+ * @brief Release a topology.
+ *
+ * @param topo Topology read by @ref rk_topology_read_.
+ */
+void rk_topology_free_(rk_topology_t *topo);
+
+/**
+ * @brief Print packages, cores and cache domains of a topology.
+ *
+ * @param topo Topology read by @ref rk_topology_read_.
+ */
+void rk_topology_report_(const rk_topology_t *topo);
+
+/**
+ * @brief Load the machine fingerprint defined by RIKER_CALIBRATION, or
+ * measure it if it's missing.
+ */
+void rk_calib_init_(void);
+
+/**
+ * @brief Start collecting coverage of each test inside RIKER_COVERAGE_DIR.
+ *
+ * @return 1 if coverage is collected, 0 otherwise.
+ */
+int rk_coverage_init_(void);
+
+/**
+ * @brief Drop the coverage counted by the parent of a forked test.
+ */
+void rk_coverage_reset_(void);
+
+/**
+ * @brief Drop and stop collecting coverage inside a process whose results
+ * are not accounted.
+ */
+void rk_coverage_detach_(void);
+
+/**
+ * @brief Account the coverage counted so far to the suite, before a test
+ * starts.
+ */
+void rk_coverage_begin_(void);
+
+/**
+ * @brief Write the coverage of a test inside its own directory.
+ *
+ * @param name Name of the test.
+ */
+void rk_coverage_end_(const char *name);
+
+/**
+ * @brief Merge the coverage of the suite and of all the tests.
+ */
+void rk_coverage_merge_(void);
+
+/**
+ * @brief Open the output file defined by RIKER_OUTPUT and choose colors
+ * according to RIKER_COLOR and NO_COLOR.
+ */
+void rk_out_init_(void);
+
+/**
+ * @brief Append a message to the output of the thread.
+ *
+ * @param fmt String to print, including string formatters.
+ * @param va Arguments for the string formatters.
+ */
+void rk_out_vprintf_(const char *fmt, va_list va)
+		__attribute__ ((format (printf, 1, 0)));
+
+/**
+ * @brief Append a message to the output of the thread.
+ *
+ * @param fmt String to print, including string formatters.
+ */
+void rk_out_printf_(const char *fmt, ...)
+		__attribute__ ((format (printf, 1, 2)));
+
+/**
+ * @brief Append raw data to the output of the thread.
+ *
+ * @param buf Data to append.
+ * @param len Length of the data.
+ */
+void rk_out_write_(const char *buf, size_t len);
+
+/**
+ * @brief Write the output of the thread to the sink with a single writev().
+ */
+void rk_out_flush_(void);
+
+/**
+ * @brief Write the output of a forked test to its standard output, which
+ * is collected by the parent, keeping the colors chosen by the parent.
+ */
+void rk_out_redirect_(void);
+
+/**
+ * @brief Flush and release the output buffer of the thread.
+ */
+void rk_out_release_(void);
+
+/**
+ * @brief Free the regular expressions compiled by the thread.
+ */
+void rk_regex_release_(void);
+
+/**
+ * @brief Load the history journal defined by RIKER_HISTORY.
+ */
+void rk_history_load_(void);
+
+/**
+ * @brief Read the history of a test.
+ *
+ * @param name Name of the test, NULL for unnamed tests which have no
+ * history.
+ * @param rss_kb Peak RSS of the last run in kB.
+ * @param duration_us Duration of the last run in microseconds.
+ * @return 0 on success, -1 if the test has no history.
+ */
+int rk_history_get_(const char *name, unsigned long long *rss_kb,
+		unsigned long long *duration_us);
+
+/**
+ * @brief Update the history of a test.
+ *
+ * @param name Name of the test, NULL for unnamed tests which have no
+ * history.
+ * @param rss_kb Peak RSS in kB.
+ * @param duration_us Duration in microseconds.
+ */
+void rk_history_set_(const char *name, unsigned long long rss_kb,
+		unsigned long long duration_us);
+
+/**
+ * @brief Write the history journal and release it.
+ */
+void rk_history_save_(void);
+
+#endif
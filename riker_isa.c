@@ -0,0 +1,321 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) 2025 Andrea Cervesato <andrea.cervesato@mailbox.org>
+ */
+
+#include "riker_internal.h"
+#include <stdbool.h>
+
+/* Number of dispatch points which can be registered */
+#define ISA_MAX_POINTS 64
+
+/* Number of kernels shown by the speedup table */
+#define ISA_MAX_KERNELS 32
+
+/* Width of the kernel name column inside the speedup table */
+#define ISA_NAME_WIDTH 24
+
+typedef struct
+{
+	const char *name;
+	rk_isa_select_func select;
+	rk_isa_query_func query;
+	void *data;
+	/* ISA level to give back after a sweep, RK_ISA_COUNT if unknown */
+	rk_isa_t saved;
+	char padding[4];
+} rk_isa_point_t;
+
+typedef struct
+{
+	char name[ISA_NAME_WIDTH + 1];
+	char padding[7];
+	unsigned long long median_ns[RK_ISA_COUNT];
+} rk_isa_kernel_t;
+
+typedef struct
+{
+	rk_isa_point_t points[ISA_MAX_POINTS];
+	rk_isa_kernel_t kernels[ISA_MAX_KERNELS];
+	size_t npoints;
+	size_t nkernels;
+	rk_isa_t current;
+	bool forced;
+	char padding[3];
+} rk_isa_registry_t;
+
+static rk_isa_registry_t registry;
+
+static const char *const isa_names[] = {
+	[RK_ISA_SCALAR] = "scalar",
+	[RK_ISA_SSE2] = "sse2",
+	[RK_ISA_AVX2] = "avx2",
+	[RK_ISA_AVX512] = "avx512",
+};
+
+int rk_isa_register(const char *name, rk_isa_select_func select,
+		rk_isa_query_func query, void *data)
+{
+	rk_isa_point_t *point = NULL;
+
+	assert(name);
+	assert(select);
+
+	for (size_t i = 0; i < registry.npoints; i++) {
+		if (!strcmp(registry.points[i].name, name)) {
+			point = registry.points + i;
+			break;
+		}
+	}
+
+	if (!point) {
+		if (registry.npoints == ISA_MAX_POINTS) {
+			errno = ENOSPC;
+			return -1;
+		}
+
+		point = registry.points + registry.npoints++;
+	}
+
+	point->name = name;
+	point->select = select;
+	point->query = query;
+	point->data = data;
+
+	return 0;
+}
+
+const char *rk_isa_name(rk_isa_t isa)
+{
+	if (isa >= RK_ISA_COUNT)
+		return "unknown";
+
+	return isa_names[isa];
+}
+
+int rk_isa_supported(rk_isa_t isa)
+{
+	switch (isa) {
+	case RK_ISA_SCALAR:
+		return 1;
+#if defined(__x86_64__) || defined(__i386__)
+	case RK_ISA_SSE2:
+		return __builtin_cpu_supports("sse2");
+	case RK_ISA_AVX2:
+		return __builtin_cpu_supports("avx2");
+	case RK_ISA_AVX512:
+		return __builtin_cpu_supports("avx512f");
+#else
+	case RK_ISA_SSE2:
+	case RK_ISA_AVX2:
+	case RK_ISA_AVX512:
+#endif
+	case RK_ISA_COUNT:
+	default:
+		return 0;
+	}
+}
+
+static rk_isa_t highest_isa(void)
+{
+	rk_isa_t isa = RK_ISA_SCALAR;
+
+	for (int i = RK_ISA_SCALAR; i < RK_ISA_COUNT; i++) {
+		if (rk_isa_supported((rk_isa_t)i))
+			isa = (rk_isa_t)i;
+	}
+
+	return isa;
+}
+
+rk_isa_t rk_isa_current(void)
+{
+	if (registry.forced)
+		return registry.current;
+
+	return highest_isa();
+}
+
+/*
+ * Force all the dispatch points to an ISA level. Returns the number of
+ * dispatch points having kernels for it.
+ */
+static size_t force_isa(rk_isa_t isa)
+{
+	size_t selected = 0;
+
+	for (size_t i = 0; i < registry.npoints; i++) {
+		rk_isa_point_t *point = registry.points + i;
+
+		if (!point->select(isa, point->data))
+			selected++;
+	}
+
+	return selected;
+}
+
+static void save_points(void)
+{
+	for (size_t i = 0; i < registry.npoints; i++) {
+		rk_isa_point_t *point = registry.points + i;
+
+		point->saved = point->query ? point->query(point->data) :
+			RK_ISA_COUNT;
+	}
+}
+
+/*
+ * Give back to each dispatch point the ISA level it used before the sweep,
+ * or the highest one it accepts when it's unknown.
+ */
+static void restore_points(void)
+{
+	for (size_t i = 0; i < registry.npoints; i++) {
+		rk_isa_point_t *point = registry.points + i;
+
+		if (point->saved < RK_ISA_COUNT &&
+				!point->select(point->saved, point->data))
+			continue;
+
+		for (int j = highest_isa(); j >= RK_ISA_SCALAR; j--) {
+			if (rk_isa_supported((rk_isa_t)j) &&
+					!point->select((rk_isa_t)j, point->data))
+				break;
+		}
+	}
+}
+
+void rk_isa_report(const char *name, const rk_bench_stats_t *stats)
+{
+	rk_isa_kernel_t *kernel = NULL;
+
+	assert(name);
+	assert(stats);
+
+	if (!registry.forced)
+		return;
+
+	for (size_t i = 0; i < registry.nkernels; i++) {
+		if (!strncmp(registry.kernels[i].name, name, ISA_NAME_WIDTH)) {
+			kernel = registry.kernels + i;
+			break;
+		}
+	}
+
+	if (!kernel) {
+		if (registry.nkernels == ISA_MAX_KERNELS)
+			return;
+
+		kernel = registry.kernels + registry.nkernels++;
+		memset(kernel, 0, sizeof(rk_isa_kernel_t));
+		snprintf(kernel->name, sizeof(kernel->name), "%s", name);
+	}
+
+	kernel->median_ns[rk_isa_current()] = stats->median_ns;
+}
+
+static void print_speedup(void)
+{
+	unsigned long long base, ns;
+	double speedup;
+
+	if (!registry.nkernels)
+		return;
+
+	rk_out_printf_("\nISA speedup:\n%-*s", ISA_NAME_WIDTH, "kernel");
+	for (int i = RK_ISA_SCALAR; i < RK_ISA_COUNT; i++)
+		rk_out_printf_(" %20s", isa_names[i]);
+	rk_out_printf_("\n");
+
+	for (size_t i = 0; i < registry.nkernels; i++) {
+		rk_isa_kernel_t *kernel = registry.kernels + i;
+
+		base = kernel->median_ns[RK_ISA_SCALAR];
+
+		rk_out_printf_("%-*s", ISA_NAME_WIDTH, kernel->name);
+
+		for (int j = RK_ISA_SCALAR; j < RK_ISA_COUNT; j++) {
+			ns = kernel->median_ns[j];
+
+			if (!ns) {
+				rk_out_printf_(" %20s", "-");
+			} else if (!base) {
+				rk_out_printf_(" %11llu ns      ", ns);
+			} else {
+				speedup = (double)base / (double)ns;
+				rk_out_printf_(" %11llu ns %5.2fx", ns,
+					speedup);
+			}
+		}
+
+		rk_out_printf_("\n");
+	}
+
+	rk_out_printf_("\n");
+
+	registry.nkernels = 0;
+}
+
+static void print_variants(const char *name, const rk_counters_t *results,
+		const bool *ran)
+{
+	rk_out_printf_("\nISA variants of %s:\n", name);
+
+	for (int i = RK_ISA_SCALAR; i < RK_ISA_COUNT; i++) {
+		if (!ran[i])
+			continue;
+
+		rk_out_printf_("%-8s passed %zu, failed %zu, skipped %zu, "
+			"errors %zu\n", isa_names[i], results[i].passed,
+			results[i].failed, results[i].skipped,
+			results[i].errors);
+	}
+}
+
+void rk_isa_sweep_(rk_test_t *test, size_t index,
+		void (*run)(rk_test_t *test, size_t index))
+{
+	rk_counters_t results[RK_ISA_COUNT], before, after;
+	bool ran[RK_ISA_COUNT] = { false };
+	char name[64];
+
+	rk_test_name_(test, index, name, sizeof(name));
+
+	save_points();
+
+	for (int i = RK_ISA_SCALAR; i < RK_ISA_COUNT; i++) {
+		rk_isa_t isa = (rk_isa_t)i;
+
+		if (!rk_isa_supported(isa))
+			continue;
+
+		/* nothing to test if no dispatch point has kernels for it */
+		if (!force_isa(isa) && registry.npoints && isa != RK_ISA_SCALAR) {
+			rk_result_(__FILE__, __LINE__, TINFO,
+				"%s: no kernels for %s", name, isa_names[i]);
+			continue;
+		}
+
+		registry.current = isa;
+		registry.forced = true;
+
+		rk_result_(__FILE__, __LINE__, TINFO, "%s: running %s variant",
+			name, isa_names[i]);
+
+		rk_session_results_(&before);
+		run(test, index);
+		rk_session_results_(&after);
+
+		results[i].passed = after.passed - before.passed;
+		results[i].failed = after.failed - before.failed;
+		results[i].skipped = after.skipped - before.skipped;
+		results[i].errors = after.errors - before.errors;
+		ran[i] = true;
+	}
+
+	registry.forced = false;
+	restore_points();
+
+	print_variants(name, results, ran);
+	print_speedup();
+}
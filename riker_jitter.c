@@ -0,0 +1,152 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) 2025 Andrea Cervesato <andrea.cervesato@mailbox.org>
+ */
+
+#define _GNU_SOURCE
+
+#include "riker_internal.h"
+#include <sched.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+/* Histogram has buckets of 1us up to this latency, then an overflow one */
+#define JITTER_BUCKETS 10000
+
+typedef struct
+{
+	const rk_jitter_opts_t *opts;
+	rk_jitter_result_t *res;
+	unsigned long *histogram;
+} rk_jitter_args_t;
+
+static void setup_thread(const rk_jitter_opts_t *opts,
+		rk_jitter_result_t *res)
+{
+	struct sched_param param = { .sched_priority = opts->priority };
+	cpu_set_t mask;
+
+	if (opts->cpu >= 0) {
+		CPU_ZERO(&mask);
+		CPU_SET((size_t)opts->cpu, &mask);
+
+		res->pinned = !sched_setaffinity(0, sizeof(mask), &mask);
+	}
+
+	/* without privileges we keep running with the default policy */
+	if (opts->priority > 0) {
+		res->realtime = !pthread_setschedparam(pthread_self(),
+				SCHED_FIFO, &param);
+	}
+}
+
+static unsigned long long __attribute__((pure)) percentile(
+		const unsigned long *histogram, unsigned long count,
+		unsigned long permille)
+{
+	unsigned long target = (count * permille + 999) / 1000;
+	unsigned long seen = 0;
+
+	for (size_t i = 0; i <= JITTER_BUCKETS; i++) {
+		seen += histogram[i];
+		if (seen >= target)
+			return (i + 1) * 1000ULL;
+	}
+
+	return (JITTER_BUCKETS + 1) * 1000ULL;
+}
+
+static void *periodic_loop(void *data)
+{
+	rk_jitter_args_t *args = data;
+	const rk_jitter_opts_t *opts = args->opts;
+	rk_jitter_result_t *res = args->res;
+	unsigned long long interval = opts->interval_us * 1000ULL;
+	unsigned long long next, now, latency, total = 0;
+	size_t bucket;
+
+	setup_thread(opts, res);
+
+	res->min_ns = ~0ULL;
+	next = rk_now_ns_() + interval;
+
+	for (unsigned long i = 0; i < opts->loops; i++) {
+		rk_sleep_until_ns_(next);
+
+		now = rk_now_ns_();
+		latency = now > next ? now - next : 0;
+
+		bucket = (size_t)(latency / 1000);
+		if (bucket > JITTER_BUCKETS)
+			bucket = JITTER_BUCKETS;
+
+		args->histogram[bucket]++;
+		total += latency;
+
+		if (latency < res->min_ns)
+			res->min_ns = latency;
+
+		if (latency > res->max_ns)
+			res->max_ns = latency;
+
+		res->loops++;
+
+		if (opts->work)
+			opts->work(opts->data);
+
+		/* skip the periods we missed, instead of waking up at once */
+		next += interval;
+		now = rk_now_ns_();
+
+		while (next <= now) {
+			next += interval;
+			res->overruns++;
+		}
+	}
+
+	if (res->loops) {
+		res->avg_ns = total / res->loops;
+		res->p99_ns = percentile(args->histogram, res->loops, 990);
+	} else {
+		res->min_ns = 0;
+	}
+
+	return NULL;
+}
+
+int rk_jitter(const rk_jitter_opts_t *opts, rk_jitter_result_t *res)
+{
+	rk_jitter_args_t args = { .opts = opts, .res = res };
+	pthread_t thread;
+	int ret;
+
+	assert(opts);
+	assert(res);
+
+	memset(res, 0, sizeof(rk_jitter_result_t));
+
+	if (!opts->interval_us) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	/* memset() makes sure pages are mapped before the loop starts */
+	args.histogram = malloc((JITTER_BUCKETS + 1) * sizeof(unsigned long));
+	if (!args.histogram)
+		return -1;
+
+	memset(args.histogram, 0, (JITTER_BUCKETS + 1) * sizeof(unsigned long));
+
+	/* a dedicated thread keeps the caller's policy and affinity */
+	ret = pthread_create(&thread, NULL, periodic_loop, &args);
+	if (ret) {
+		free(args.histogram);
+		errno = ret;
+		return -1;
+	}
+
+	pthread_join(thread, NULL);
+	free(args.histogram);
+
+	return 0;
+}
@@ -0,0 +1,352 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) 2025 Andrea Cervesato <andrea.cervesato@mailbox.org>
+ */
+
+#define _GNU_SOURCE
+
+#include "riker_internal.h"
+#include <sched.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+/* Registers of each thread are kept in their own cache line */
+#define LITMUS_LINE 64
+
+/* Spins on the barrier before giving the CPU to the other threads */
+#define LITMUS_SPINS 100000
+
+/* Maximum delay of a thread, in pause instructions, after the barrier */
+#define LITMUS_SKEW 8
+
+/*
+ * Sense reversing barrier. Threads spin instead of sleeping, so all of
+ * them leave the barrier within a few cycles.
+ */
+typedef struct
+{
+	unsigned int count;
+	unsigned int sense;
+	unsigned int threads;
+	unsigned int spins;
+} rk_litmus_barrier_t;
+
+typedef struct rk_litmus rk_litmus_t;
+
+typedef struct
+{
+	rk_litmus_t *litmus;
+	long *regs;
+	pthread_t thread;
+	unsigned int id;
+	int cpu;
+	bool started;
+	bool pinned;
+	char padding[6];
+} rk_litmus_worker_t;
+
+struct rk_litmus
+{
+	const rk_litmus_opts_t *opts;
+	rk_litmus_result_t *res;
+	rk_litmus_worker_t *workers;
+	char *regs;
+	rk_litmus_barrier_t barrier;
+	int go;
+	char padding[4];
+};
+
+static void cpu_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__)
+	__asm__ __volatile__("yield");
+#endif
+}
+
+static void barrier_wait(rk_litmus_barrier_t *barrier, unsigned int *sense)
+{
+	unsigned int spins = 0;
+
+	*sense = !*sense;
+
+	if (__atomic_add_fetch(&barrier->count, 1, __ATOMIC_ACQ_REL) ==
+		barrier->threads) {
+		__atomic_store_n(&barrier->count, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&barrier->sense, *sense, __ATOMIC_RELEASE);
+		return;
+	}
+
+	/* threads sharing a CPU would spin until the end of their slice */
+	while (__atomic_load_n(&barrier->sense, __ATOMIC_ACQUIRE) != *sense) {
+		if (spins < barrier->spins) {
+			cpu_relax();
+			spins++;
+		} else {
+			sched_yield();
+		}
+	}
+}
+
+static void record_outcome(rk_litmus_t *litmus)
+{
+	const rk_litmus_opts_t *opts = litmus->opts;
+	rk_litmus_result_t *res = litmus->res;
+	long regs[RK_LITMUS_MAX_THREADS * RK_LITMUS_REGS];
+	size_t size = res->threads * RK_LITMUS_REGS * sizeof(long);
+	rk_litmus_outcome_t *outcome = NULL;
+
+	for (unsigned int i = 0; i < res->threads; i++) {
+		memcpy(regs + i * RK_LITMUS_REGS, litmus->workers[i].regs,
+			RK_LITMUS_REGS * sizeof(long));
+	}
+
+	for (size_t i = 0; i < res->noutcomes; i++) {
+		if (!memcmp(res->outcomes[i].regs, regs, size)) {
+			outcome = res->outcomes + i;
+			break;
+		}
+	}
+
+	if (!outcome) {
+		if (res->noutcomes < RK_LITMUS_MAX_OUTCOMES) {
+			outcome = res->outcomes + res->noutcomes++;
+			memcpy(outcome->regs, regs, size);
+
+			if (opts->forbidden)
+				outcome->forbidden = !!opts->forbidden(regs);
+		} else if (opts->forbidden && opts->forbidden(regs)) {
+			res->forbidden++;
+		}
+	}
+
+	if (!outcome) {
+		res->dropped++;
+		return;
+	}
+
+	outcome->count++;
+
+	if (outcome->forbidden)
+		res->forbidden++;
+}
+
+static void *litmus_loop(void *arg)
+{
+	rk_litmus_worker_t *worker = arg;
+	rk_litmus_t *litmus = worker->litmus;
+	const rk_litmus_opts_t *opts = litmus->opts;
+	rk_litmus_func func = opts->threads[worker->id];
+	unsigned long skew;
+	unsigned int sense = 0;
+	cpu_set_t mask;
+	int go;
+
+	if (worker->cpu >= 0) {
+		CPU_ZERO(&mask);
+		CPU_SET((size_t)worker->cpu, &mask);
+
+		worker->pinned = !sched_setaffinity(0, sizeof(mask), &mask);
+	}
+
+	/* wait until all the threads started, or one of them failed to */
+	while (!(go = __atomic_load_n(&litmus->go, __ATOMIC_ACQUIRE)))
+		sched_yield();
+
+	if (go < 0)
+		return NULL;
+
+	for (unsigned long i = 0; i < opts->iterations; i++) {
+		/* the first thread prepares the iteration, others wait for it */
+		if (!worker->id && opts->init)
+			opts->init(opts->state);
+
+		barrier_wait(&litmus->barrier, &sense);
+
+		/* start offsets rotate, so each thread runs first in turn */
+		skew = (i * (2 * worker->id + 1)) % LITMUS_SKEW;
+		for (unsigned long j = 0; j < skew; j++)
+			cpu_relax();
+
+		func(opts->state, worker->regs);
+
+		barrier_wait(&litmus->barrier, &sense);
+
+		if (!worker->id)
+			record_outcome(litmus);
+	}
+
+	return NULL;
+}
+
+/*
+ * Assign CPUs on different cores first, so threads don't share the store
+ * buffer, then other CPUs. Threads are not pinned when there are not
+ * enough CPUs for all of them.
+ */
+static bool assign_cpus(rk_litmus_t *litmus, unsigned int threads)
+{
+	rk_topology_t topo;
+	bool *used, busy;
+	unsigned int count = 0;
+
+	if (rk_topology_read_(&topo))
+		return false;
+
+	used = calloc(topo.count, sizeof(bool));
+	if (!used || topo.count < threads)
+		goto exit;
+
+	for (int pass = 0; pass < 2 && count < threads; pass++) {
+		for (size_t i = 0; i < topo.count && count < threads; i++) {
+			busy = used[i];
+
+			for (unsigned int j = 0; j < count && !pass && !busy; j++) {
+				busy = topo.cpus[i].core ==
+					topo.cpus[(size_t)litmus->workers[j].cpu].core;
+			}
+
+			if (busy)
+				continue;
+
+			used[i] = true;
+			litmus->workers[count++].cpu = (int)i;
+		}
+	}
+
+	for (unsigned int i = 0; i < threads; i++)
+		litmus->workers[i].cpu = topo.cpus[litmus->workers[i].cpu].cpu;
+
+exit:
+	free(used);
+	rk_topology_free_(&topo);
+
+	return count == threads;
+}
+
+int rk_litmus(const rk_litmus_opts_t *opts, rk_litmus_result_t *res)
+{
+	rk_litmus_t litmus = { .opts = opts, .res = res };
+	unsigned long long start;
+	unsigned int threads = 0;
+	bool pinned;
+	int ret = 0;
+
+	assert(opts);
+	assert(res);
+
+	memset(res, 0, sizeof(rk_litmus_result_t));
+
+	while (threads < RK_LITMUS_MAX_THREADS && opts->threads[threads])
+		threads++;
+
+	if (!threads || !opts->iterations) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	res->threads = threads;
+
+	litmus.workers = calloc(threads, sizeof(rk_litmus_worker_t));
+	litmus.regs = aligned_alloc(LITMUS_LINE, threads * LITMUS_LINE);
+
+	if (!litmus.workers || !litmus.regs) {
+		ret = -1;
+		goto exit;
+	}
+
+	memset(litmus.regs, 0, threads * LITMUS_LINE);
+
+	for (unsigned int i = 0; i < threads; i++) {
+		litmus.workers[i].litmus = &litmus;
+		litmus.workers[i].regs = (long *)(void *)(litmus.regs +
+			i * LITMUS_LINE);
+		litmus.workers[i].id = i;
+		litmus.workers[i].cpu = -1;
+	}
+
+	pinned = assign_cpus(&litmus, threads);
+
+	if (!pinned) {
+		for (unsigned int i = 0; i < threads; i++)
+			litmus.workers[i].cpu = -1;
+	}
+
+	litmus.barrier.threads = threads;
+	litmus.barrier.spins = pinned ? LITMUS_SPINS : 0;
+
+	start = rk_now_ns_();
+
+	for (unsigned int i = 0; i < threads; i++) {
+		ret = pthread_create(&litmus.workers[i].thread, NULL,
+			litmus_loop, litmus.workers + i);
+		if (ret)
+			break;
+
+		litmus.workers[i].started = true;
+	}
+
+	/* the barrier would wait forever for the threads which didn't start */
+	__atomic_store_n(&litmus.go, ret ? -1 : 1, __ATOMIC_RELEASE);
+
+	for (unsigned int i = 0; i < threads; i++) {
+		if (litmus.workers[i].started)
+			pthread_join(litmus.workers[i].thread, NULL);
+	}
+
+	if (ret) {
+		errno = ret;
+		ret = -1;
+		goto exit;
+	}
+
+	res->duration_ns = rk_now_ns_() - start;
+	res->iterations = opts->iterations;
+	res->pinned = pinned;
+
+	for (unsigned int i = 0; i < threads; i++)
+		res->pinned &= litmus.workers[i].pinned;
+
+exit:
+	free(litmus.workers);
+	free(litmus.regs);
+
+	return ret;
+}
+
+void rk_litmus_report_(const char *file, const int lineno,
+		const rk_litmus_result_t *res)
+{
+	char line[256];
+	size_t pos;
+
+	assert(res);
+
+	rk_result_(file, lineno, TINFO, "litmus: %lu iterations on %u %s "
+		"threads in %llu ms, %zu outcomes", res->iterations,
+		res->threads, res->pinned ? "pinned" : "unpinned",
+		res->duration_ns / 1000000, res->noutcomes);
+
+	for (size_t i = 0; i < res->noutcomes; i++) {
+		const rk_litmus_outcome_t *outcome = res->outcomes + i;
+
+		pos = 0;
+
+		for (unsigned int t = 0; t < res->threads; t++) {
+			for (unsigned int r = 0; r < RK_LITMUS_REGS; r++) {
+				pos += (size_t)snprintf(line + pos,
+					sizeof(line) - pos, "%u:r%u=%ld ", t, r,
+					outcome->regs[t * RK_LITMUS_REGS + r]);
+			}
+		}
+
+		rk_result_(file, lineno, TINFO, "%s-> %lu%s", line,
+			outcome->count, outcome->forbidden ? " forbidden" : "");
+	}
+
+	if (res->dropped) {
+		rk_result_(file, lineno, TINFO, "%lu iterations with other "
+			"outcomes", res->dropped);
+	}
+}
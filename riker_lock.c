@@ -0,0 +1,340 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) 2025 Andrea Cervesato <andrea.cervesato@mailbox.org>
+ */
+
+#define _GNU_SOURCE
+
+#include "riker_internal.h"
+
+#ifdef RK_LOCK_CONTENTION
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+/* Number of lock addresses we can track. Must be a power of two. */
+#define LOCK_SLOTS 1024
+
+/* Number of locks printed by the per-test report */
+#define LOCK_REPORT_TOP 5
+
+/*
+ * Condition variables count the waits inside `acquired` and their time
+ * inside `wait_ns`, which is waiting for an event rather than for a lock.
+ */
+typedef struct
+{
+	uintptr_t addr;
+	unsigned long long wait_ns;
+	unsigned long long acquired;
+	unsigned long long contended;
+	bool cond;
+	char padding[7];
+} rk_lock_stat_t;
+
+typedef int (*rk_mutex_func)(pthread_mutex_t *);
+typedef int (*rk_rwlock_func)(pthread_rwlock_t *);
+typedef int (*rk_cond_wait_func)(pthread_cond_t *, pthread_mutex_t *);
+
+static rk_lock_stat_t lock_stats[LOCK_SLOTS];
+
+static rk_mutex_func real_mutex_lock;
+static rk_mutex_func real_mutex_trylock;
+static rk_rwlock_func real_rwlock_rdlock;
+static rk_rwlock_func real_rwlock_tryrdlock;
+static rk_rwlock_func real_rwlock_wrlock;
+static rk_rwlock_func real_rwlock_trywrlock;
+static rk_cond_wait_func real_cond_wait;
+
+/* Avoid accounting locks taken by the accounting itself */
+static __thread bool in_hook;
+
+static void *resolve(const char *name)
+{
+	void *sym = dlsym(RTLD_NEXT, name);
+
+	assert(sym);
+
+	return sym;
+}
+
+static void __attribute__((constructor)) rk_lock_init(void)
+{
+	*(void **)&real_mutex_lock = resolve("pthread_mutex_lock");
+	*(void **)&real_mutex_trylock = resolve("pthread_mutex_trylock");
+	*(void **)&real_rwlock_rdlock = resolve("pthread_rwlock_rdlock");
+	*(void **)&real_rwlock_tryrdlock = resolve("pthread_rwlock_tryrdlock");
+	*(void **)&real_rwlock_wrlock = resolve("pthread_rwlock_wrlock");
+	*(void **)&real_rwlock_trywrlock = resolve("pthread_rwlock_trywrlock");
+	*(void **)&real_cond_wait = resolve("pthread_cond_wait");
+}
+
+static rk_lock_stat_t *lookup(const void *lock)
+{
+	uintptr_t addr = (uintptr_t)lock;
+	uintptr_t expected;
+	size_t pos = (size_t)((addr >> 4) * 0x9e3779b97f4a7c15ULL);
+
+	for (size_t i = 0; i < LOCK_SLOTS; i++) {
+		rk_lock_stat_t *stat = lock_stats + ((pos + i) & (LOCK_SLOTS - 1));
+
+		expected = __atomic_load_n(&stat->addr, __ATOMIC_ACQUIRE);
+		if (expected == addr)
+			return stat;
+
+		if (expected)
+			continue;
+
+		if (__atomic_compare_exchange_n(&stat->addr, &expected, addr,
+				false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+			return stat;
+
+		if (expected == addr)
+			return stat;
+	}
+
+	/* table is full: lock won't be tracked */
+	return NULL;
+}
+
+static void account(const void *lock, unsigned long long wait_ns,
+		bool contended)
+{
+	rk_lock_stat_t *stat = lookup(lock);
+
+	if (!stat)
+		return;
+
+	__atomic_fetch_add(&stat->acquired, 1, __ATOMIC_RELAXED);
+
+	if (contended) {
+		__atomic_fetch_add(&stat->contended, 1, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&stat->wait_ns, wait_ns, __ATOMIC_RELAXED);
+	}
+}
+
+int pthread_mutex_lock(pthread_mutex_t *mutex)
+{
+	unsigned long long start;
+	int ret;
+
+	if (!real_mutex_lock)
+		rk_lock_init();
+
+	if (in_hook)
+		return real_mutex_lock(mutex);
+
+	in_hook = true;
+
+	ret = real_mutex_trylock(mutex);
+	if (ret != EBUSY) {
+		if (!ret)
+			account(mutex, 0, false);
+
+		in_hook = false;
+		return ret;
+	}
+
+	start = rk_now_ns_();
+	ret = real_mutex_lock(mutex);
+	if (!ret)
+		account(mutex, rk_now_ns_() - start, true);
+
+	in_hook = false;
+
+	return ret;
+}
+
+static int rwlock_lock(pthread_rwlock_t *rwlock, rk_rwlock_func trylock,
+		rk_rwlock_func lock)
+{
+	unsigned long long start;
+	int ret;
+
+	if (in_hook)
+		return lock(rwlock);
+
+	in_hook = true;
+
+	ret = trylock(rwlock);
+	if (ret != EBUSY) {
+		if (!ret)
+			account(rwlock, 0, false);
+
+		in_hook = false;
+		return ret;
+	}
+
+	start = rk_now_ns_();
+	ret = lock(rwlock);
+	if (!ret)
+		account(rwlock, rk_now_ns_() - start, true);
+
+	in_hook = false;
+
+	return ret;
+}
+
+int pthread_rwlock_rdlock(pthread_rwlock_t *rwlock)
+{
+	if (!real_rwlock_rdlock)
+		rk_lock_init();
+
+	return rwlock_lock(rwlock, real_rwlock_tryrdlock, real_rwlock_rdlock);
+}
+
+int pthread_rwlock_wrlock(pthread_rwlock_t *rwlock)
+{
+	if (!real_rwlock_wrlock)
+		rk_lock_init();
+
+	return rwlock_lock(rwlock, real_rwlock_trywrlock, real_rwlock_wrlock);
+}
+
+int pthread_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex)
+{
+	rk_lock_stat_t *stat;
+	unsigned long long start;
+	int ret;
+
+	if (!real_cond_wait)
+		rk_lock_init();
+
+	if (in_hook)
+		return real_cond_wait(cond, mutex);
+
+	start = rk_now_ns_();
+	ret = real_cond_wait(cond, mutex);
+
+	in_hook = true;
+
+	stat = lookup(cond);
+	if (stat) {
+		stat->cond = true;
+		__atomic_fetch_add(&stat->acquired, 1, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&stat->wait_ns, rk_now_ns_() - start,
+			__ATOMIC_RELAXED);
+	}
+
+	in_hook = false;
+
+	return ret;
+}
+
+unsigned long long rk_contention_wait_ns(void)
+{
+	unsigned long long total = 0;
+
+	/* waiting on a condition variable isn't contention */
+	for (size_t i = 0; i < LOCK_SLOTS; i++) {
+		if (!lock_stats[i].cond) {
+			total += __atomic_load_n(&lock_stats[i].wait_ns,
+				__ATOMIC_RELAXED);
+		}
+	}
+
+	return total;
+}
+
+void rk_lock_reset_(void)
+{
+	memset(lock_stats, 0, sizeof(lock_stats));
+}
+
+/* Select the locks, or the condition variables, which waited the longest */
+static bool select_top(rk_lock_stat_t **top, bool cond)
+{
+	rk_lock_stat_t *stat;
+	size_t j;
+
+	memset(top, 0, LOCK_REPORT_TOP * sizeof(rk_lock_stat_t *));
+
+	for (size_t i = 0; i < LOCK_SLOTS; i++) {
+		stat = lock_stats + i;
+		if (!stat->addr || stat->cond != cond)
+			continue;
+
+		if (!cond && !stat->contended)
+			continue;
+
+		if (cond && !stat->acquired)
+			continue;
+
+		for (j = 0; j < LOCK_REPORT_TOP; j++) {
+			if (!top[j] || top[j]->wait_ns < stat->wait_ns)
+				break;
+		}
+
+		if (j == LOCK_REPORT_TOP)
+			continue;
+
+		memmove(top + j + 1, top + j,
+			(LOCK_REPORT_TOP - j - 1) * sizeof(rk_lock_stat_t *));
+		top[j] = stat;
+	}
+
+	return top[0] != NULL;
+}
+
+static void print_symbol(uintptr_t addr)
+{
+	Dl_info info;
+
+	rk_out_printf_("  0x%lx", (unsigned long)addr);
+
+	if (dladdr((void *)addr, &info) && info.dli_sname) {
+		rk_out_printf_(" (%s+0x%lx)", info.dli_sname,
+			(unsigned long)(addr - (uintptr_t)info.dli_saddr));
+	}
+}
+
+void rk_lock_report_(void)
+{
+	rk_lock_stat_t *top[LOCK_REPORT_TOP];
+	rk_lock_stat_t *stat;
+
+	if (select_top(top, false)) {
+		rk_out_printf_("Contended locks:\n");
+
+		for (size_t i = 0; i < LOCK_REPORT_TOP && top[i]; i++) {
+			stat = top[i];
+
+			print_symbol(stat->addr);
+			rk_out_printf_(" acquired: %llu contended: %llu "
+				"wait: %llu ns\n", stat->acquired,
+				stat->contended, stat->wait_ns);
+		}
+	}
+
+	if (select_top(top, true)) {
+		rk_out_printf_("Condition waits:\n");
+
+		for (size_t i = 0; i < LOCK_REPORT_TOP && top[i]; i++) {
+			stat = top[i];
+
+			print_symbol(stat->addr);
+			rk_out_printf_(" waits: %llu wait: %llu ns\n",
+				stat->acquired, stat->wait_ns);
+		}
+	}
+}
+
+#else
+
+unsigned long long __attribute__((const)) rk_contention_wait_ns(void)
+{
+	return 0;
+}
+
+void rk_lock_reset_(void)
+{
+}
+
+void rk_lock_report_(void)
+{
+}
+
+#endif
@@ -0,0 +1,357 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) 2025 Andrea Cervesato <andrea.cervesato@mailbox.org>
+ */
+
+#define _GNU_SOURCE
+
+#include "riker_internal.h"
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+/* Size of the chunks buffering the output of a thread */
+#define OUT_CHUNK_SIZE (64 * 1024)
+
+/* Chunks written by a single writev(), the buffer is flushed once full */
+#define OUT_MAX_CHUNKS 16
+
+/* Messages printed when the buffer can't be allocated are truncated */
+#define OUT_LINE_SIZE 1024
+
+/*
+ * Destination of the output. When the sink is a terminal, output is flushed
+ * at the end of each line, so it's shown while the test is running.
+ */
+typedef struct
+{
+	rk_output_func func;
+	void *data;
+	int fd;
+	bool owned;
+	bool color;
+	bool batch;
+	char padding[1];
+} rk_sink_t;
+
+/*
+ * Output of the thread, written at once when the test completes. Chunks are
+ * mapped by the allocator of the arena, so reporting never calls malloc(),
+ * and they're kept after a flush, so the next test reuses them.
+ */
+typedef struct
+{
+	char *chunks[OUT_MAX_CHUNKS];
+	size_t used[OUT_MAX_CHUNKS];
+	unsigned int current;
+	char padding[4];
+} rk_out_t;
+
+static rk_sink_t sink = { .fd = STDOUT_FILENO, .batch = true };
+
+static __thread rk_out_t out;
+
+/*
+ * Colors are used on terminals only, unless RIKER_COLOR is "always" or
+ * "never". NO_COLOR disables them, as defined by https://no-color.org.
+ * The callback sink (fd -1) never gets them.
+ */
+static bool use_color(int fd)
+{
+	const char *mode = getenv("RIKER_COLOR");
+	const char *no_color = getenv("NO_COLOR");
+
+	if (fd == -1)
+		return false;
+
+	if (mode && !strcmp(mode, "always"))
+		return true;
+
+	if (mode && !strcmp(mode, "never"))
+		return false;
+
+	if (no_color && *no_color)
+		return false;
+
+	return isatty(fd);
+}
+
+static void set_sink(int fd, bool owned, rk_output_func func, void *data)
+{
+	rk_out_flush_();
+
+	if (sink.owned && sink.fd != fd)
+		close(sink.fd);
+
+	sink.func = func;
+	sink.data = data;
+	sink.fd = fd;
+	sink.owned = owned;
+	sink.color = use_color(fd);
+	sink.batch = fd == -1 || !isatty(fd);
+}
+
+static void emit(struct iovec *iov, int count)
+{
+	ssize_t ret;
+	size_t len;
+
+	if (sink.func) {
+		for (int i = 0; i < count; i++)
+			sink.func(iov[i].iov_base, iov[i].iov_len, sink.data);
+
+		return;
+	}
+
+	/* output printed through stdio by the tests comes first */
+	if (sink.fd == STDOUT_FILENO)
+		fflush(stdout);
+
+	while (count) {
+		ret = writev(sink.fd, iov, count);
+		if (ret == -1 && errno == EINTR)
+			continue;
+
+		if (ret <= 0)
+			return;
+
+		/* a partial write continues from where it stopped */
+		for (len = (size_t)ret; count && len >= iov->iov_len; count--) {
+			len -= iov->iov_len;
+			iov++;
+		}
+
+		if (count) {
+			iov->iov_base = (char *)iov->iov_base + len;
+			iov->iov_len -= len;
+		}
+	}
+}
+
+void rk_out_flush_(void)
+{
+	struct iovec iov[OUT_MAX_CHUNKS];
+	int count = 0;
+
+	for (unsigned int i = 0; i <= out.current; i++) {
+		if (!out.used[i])
+			continue;
+
+		iov[count].iov_base = out.chunks[i];
+		iov[count].iov_len = out.used[i];
+		count++;
+
+		out.used[i] = 0;
+	}
+
+	out.current = 0;
+
+	if (count)
+		emit(iov, count);
+	else if (!sink.func && sink.fd == STDOUT_FILENO)
+		fflush(stdout);
+}
+
+/* Room left inside the current chunk, moving to the next one if needed */
+static size_t reserve(size_t size)
+{
+	unsigned int next = out.current;
+
+	if (out.chunks[next] && OUT_CHUNK_SIZE - out.used[next] >= size)
+		return OUT_CHUNK_SIZE - out.used[next];
+
+	if (out.chunks[next] && out.used[next]) {
+		if (next + 1 == OUT_MAX_CHUNKS) {
+			rk_out_flush_();
+			next = 0;
+		} else {
+			next++;
+		}
+	}
+
+	if (!out.chunks[next]) {
+		out.chunks[next] = rk_arena_chunk_(OUT_CHUNK_SIZE);
+		if (!out.chunks[next])
+			return 0;
+	}
+
+	out.current = next;
+
+	return OUT_CHUNK_SIZE - out.used[next];
+}
+
+void rk_out_vprintf_(const char *fmt, va_list va)
+{
+	char line[OUT_LINE_SIZE];
+	struct iovec iov;
+	size_t room = 0, len = 0;
+	char *dst = line;
+	va_list copy;
+	int ret = -1;
+
+	/* formatted again inside the next chunk when it doesn't fit */
+	for (size_t size = 1; ret < 0 || (size_t)ret >= room; size = len + 1) {
+		room = reserve(size);
+
+		if (!room) {
+			vsnprintf(line, sizeof(line), fmt, va);
+
+			iov.iov_base = line;
+			iov.iov_len = strlen(line);
+			emit(&iov, 1);
+			return;
+		}
+
+		dst = out.chunks[out.current] + out.used[out.current];
+
+		va_copy(copy, va);
+		ret = vsnprintf(dst, room, fmt, copy);
+		va_end(copy);
+
+		if (ret < 0)
+			return;
+
+		len = (size_t)ret;
+
+		/* messages bigger than a chunk are truncated */
+		if (len >= room && room == OUT_CHUNK_SIZE) {
+			len = room - 1;
+			break;
+		}
+	}
+
+	out.used[out.current] += len;
+
+	if (!sink.batch && len && dst[len - 1] == '\n')
+		rk_out_flush_();
+}
+
+void rk_out_printf_(const char *fmt, ...)
+{
+	va_list va;
+
+	va_start(va, fmt);
+	rk_out_vprintf_(fmt, va);
+	va_end(va);
+}
+
+void rk_out_write_(const char *buf, size_t len)
+{
+	struct iovec iov;
+	size_t room;
+
+	while (len) {
+		room = reserve(len < OUT_CHUNK_SIZE ? len : OUT_CHUNK_SIZE);
+
+		if (!room) {
+			iov.iov_base = (char *)(uintptr_t)buf;
+			iov.iov_len = len;
+			emit(&iov, 1);
+			return;
+		}
+
+		if (room > len)
+			room = len;
+
+		memcpy(out.chunks[out.current] + out.used[out.current], buf,
+			room);
+
+		out.used[out.current] += room;
+		buf += room;
+		len -= room;
+	}
+}
+
+void rk_out_release_(void)
+{
+	rk_out_flush_();
+
+	for (unsigned int i = 0; i < OUT_MAX_CHUNKS; i++) {
+		if (out.chunks[i])
+			rk_arena_unchunk_(out.chunks[i], OUT_CHUNK_SIZE);
+
+		out.chunks[i] = NULL;
+	}
+}
+
+/* tests calling exit() would lose the output of the current test */
+static void flush_at_exit(void)
+{
+	rk_out_flush_();
+}
+
+void rk_out_init_(void)
+{
+	static bool registered;
+	const char *path = getenv("RIKER_OUTPUT");
+
+	if (!registered)
+		registered = !atexit(flush_at_exit);
+
+	if (path && *path && rk_output_file(path)) {
+		rk_result_(__FILE__, __LINE__, TINFO, "Can't open %s: %s",
+			path, strerror(errno));
+	}
+
+	/* the environment may have changed since the sink was chosen */
+	sink.color = use_color(sink.func ? -1 : sink.fd);
+	sink.batch = sink.func || !isatty(sink.fd);
+}
+
+void rk_out_redirect_(void)
+{
+	rk_out_flush_();
+
+	/* the parent owns the sink, colors are the ones it has chosen */
+	sink.func = NULL;
+	sink.data = NULL;
+	sink.fd = STDOUT_FILENO;
+	sink.owned = false;
+	sink.batch = true;
+}
+
+int rk_output_fd(int fd)
+{
+	if (fd < 0 || fcntl(fd, F_GETFD) == -1) {
+		errno = EBADF;
+		return -1;
+	}
+
+	set_sink(fd, false, NULL, NULL);
+
+	return 0;
+}
+
+int rk_output_file(const char *path)
+{
+	int fd;
+
+	assert(path);
+
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd == -1)
+		return -1;
+
+	set_sink(fd, true, NULL, NULL);
+
+	return 0;
+}
+
+int rk_output_callback(rk_output_func func, void *data)
+{
+	if (!func) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	set_sink(-1, false, func, data);
+
+	return 0;
+}
+
+int rk_output_color(void)
+{
+	return sink.color;
+}
@@ -0,0 +1,1049 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) 2025 Andrea Cervesato <andrea.cervesato@mailbox.org>
+ */
+
+#define _GNU_SOURCE
+
+#include "riker_internal.h"
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+/* Share of MemAvailable given to the tests, in percent */
+#define PARALLEL_MEM_FRACTION 75
+
+/* Size of the buffer used to copy the output of the tests */
+#define PARALLEL_COPY_SIZE 4096
+
+/* Tests shorter than this share a process, unless RIKER_BATCH_US is set */
+#define BATCH_SHORT_US 1000
+
+/* Tests are added to a batch until it's expected to last this long */
+#define BATCH_TARGET_US 20000
+
+/* Maximum number of tests inside a batch */
+#define BATCH_MAX 256
+
+/*
+ * Tests run by the same process: a single test or a batch of consecutive
+ * short tests.
+ */
+typedef struct
+{
+	unsigned long long rss_kb;
+	unsigned long long duration_us;
+	/* position of the first test inside the run order */
+	size_t first;
+	size_t count;
+	bool known;
+	bool exclusive;
+	bool batch;
+	char padding[5];
+} rk_job_t;
+
+/*
+ * Progress of a test, written by the forked process inside shared memory,
+ * so it's available even if the process crashed.
+ */
+typedef struct
+{
+	rk_counters_t results;
+	unsigned long long duration_us;
+	/*
+	 * RSS of the process when it was forked, written for the first test of
+	 * the job only. Pages shared with the parent are counted by ru_maxrss.
+	 */
+	unsigned long long base_kb;
+	/* output written by the process before the test started */
+	off_t offset;
+	bool started;
+	bool done;
+	char padding[6];
+} rk_progress_t;
+
+typedef struct
+{
+	rk_job_t *job;
+	unsigned long long start_ns;
+	pid_t pid;
+	int out_fd;
+	/* CPU where the test is pinned, -1 when it's not pinned */
+	int cpu;
+	/* core reserved by an exclusive test, -1 when it's not reserved */
+	int core;
+} rk_slot_t;
+
+/*
+ * Tests placed on each CPU. CPUs of the cores reserved by exclusive tests
+ * are marked as reserved, so no other test is placed on them.
+ */
+typedef struct
+{
+	rk_topology_t topo;
+	unsigned int *load;
+	bool *reserved;
+	bool available;
+	char padding[7];
+} rk_placement_t;
+
+typedef struct
+{
+	rk_test_t *tests;
+	/* indexes of the synchronous tests, in the order of the suite */
+	size_t *order;
+	size_t ntests;
+	rk_progress_t *progress;
+	rk_job_t *job_list;
+	size_t njobs;
+	rk_job_t **pending;
+	size_t npending;
+	rk_slot_t *slots;
+	rk_placement_t place;
+	rk_run_func_ run;
+	unsigned long long rlimit_kb;
+	unsigned int jobs;
+	char padding[4];
+} rk_parallel_t;
+
+static unsigned long long __attribute__((pure)) parse_size(const char *str)
+{
+	char *end;
+	unsigned long long size = strtoull(str, &end, 10);
+
+	switch (*end) {
+	case 'g':
+	case 'G':
+		size *= 1024;
+		/* fallthrough */
+	case 'm':
+	case 'M':
+		size *= 1024;
+		/* fallthrough */
+	case 'k':
+	case 'K':
+		size *= 1024;
+		break;
+	default:
+		break;
+	}
+
+	return size;
+}
+
+static unsigned long long mem_available_kb(void)
+{
+	unsigned long long value = 0;
+	char line[128];
+	FILE *file;
+
+	file = fopen("/proc/meminfo", "re");
+	if (!file)
+		return 0;
+
+	while (fgets(line, sizeof(line), file)) {
+		if (sscanf(line, "MemAvailable: %llu kB", &value) == 1)
+			break;
+	}
+
+	fclose(file);
+
+	return value;
+}
+
+static unsigned long long rss_kb(void)
+{
+	unsigned long long value = 0;
+	char line[128];
+	FILE *file;
+
+	file = fopen("/proc/self/status", "re");
+	if (!file)
+		return 0;
+
+	while (fgets(line, sizeof(line), file)) {
+		if (sscanf(line, "VmRSS: %llu kB", &value) == 1)
+			break;
+	}
+
+	fclose(file);
+
+	return value;
+}
+
+/*
+ * Memory given to the tests running at the same time. It's RIKER_MEM_LIMIT
+ * when defined, otherwise a fraction of the available memory, which can be
+ * changed by RIKER_MEM_FRACTION. Zero means no limit.
+ */
+static unsigned long long memory_budget_kb(void)
+{
+	const char *limit = getenv("RIKER_MEM_LIMIT");
+	const char *fraction = getenv("RIKER_MEM_FRACTION");
+	unsigned long long percent = PARALLEL_MEM_FRACTION;
+
+	if (limit)
+		return parse_size(limit) / 1024;
+
+	if (fraction) {
+		percent = strtoull(fraction, NULL, 10);
+		if (!percent || percent > 100)
+			percent = PARALLEL_MEM_FRACTION;
+	}
+
+	return mem_available_kb() * percent / 100;
+}
+
+static int compare_jobs(const void *a, const void *b)
+{
+	const rk_job_t *x = a;
+	const rk_job_t *y = b;
+
+	/* unknown tests first, then the longest ones */
+	if (x->known != y->known)
+		return x->known ? 1 : -1;
+
+	if (x->duration_us != y->duration_us)
+		return x->duration_us < y->duration_us ? 1 : -1;
+
+	return (x->first > y->first) - (x->first < y->first);
+}
+
+static bool __attribute__((pure)) core_is_free(const rk_placement_t *place,
+		int core)
+{
+	for (size_t i = 0; i < place->topo.count; i++) {
+		if (place->topo.cpus[i].core != core)
+			continue;
+
+		if (place->load[i] || place->reserved[i])
+			return false;
+	}
+
+	return true;
+}
+
+/* Number of busy CPUs sharing the last level cache with the given one */
+static unsigned int __attribute__((pure)) llc_busy(const rk_placement_t *place,
+		size_t index)
+{
+	unsigned int busy = 0;
+
+	for (size_t i = 0; i < place->topo.count; i++) {
+		if (place->topo.cpus[i].llc != place->topo.cpus[index].llc)
+			continue;
+
+		busy += place->load[i] || place->reserved[i];
+	}
+
+	return busy;
+}
+
+/* Number of exclusive tests sharing the last level cache with the given CPU */
+static unsigned int __attribute__((pure)) llc_reserved(
+		const rk_placement_t *place, size_t index)
+{
+	unsigned int reserved = 0;
+
+	for (size_t i = 0; i < place->topo.count; i++) {
+		if (place->topo.cpus[i].llc != place->topo.cpus[index].llc)
+			continue;
+
+		reserved += place->reserved[i];
+	}
+
+	return reserved;
+}
+
+static bool __attribute__((pure)) siblings_busy(const rk_placement_t *place,
+		size_t index)
+{
+	for (size_t i = 0; i < place->topo.count; i++) {
+		if (i == index ||
+			place->topo.cpus[i].core != place->topo.cpus[index].core)
+			continue;
+
+		if (place->load[i])
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * Exclusive tests take the first CPU of a free physical core, inside the
+ * least busy cache domain. Returns the index of the CPU or -1 when no core
+ * is free.
+ */
+static int __attribute__((pure)) find_core(const rk_placement_t *place)
+{
+	unsigned int busy, best_busy = 0;
+	int best = -1;
+
+	for (size_t i = 0; i < place->topo.count; i++) {
+		const rk_cpu_t *cpu = place->topo.cpus + i;
+		bool first = true;
+
+		for (size_t j = 0; j < i && first; j++)
+			first = place->topo.cpus[j].core != cpu->core;
+
+		if (!first || !core_is_free(place, cpu->core))
+			continue;
+
+		busy = llc_busy(place, i);
+
+		if (best == -1 || busy < best_busy) {
+			best = (int)i;
+			best_busy = busy;
+		}
+	}
+
+	return best;
+}
+
+/*
+ * Other tests take the least loaded CPU which isn't reserved, preferring
+ * cache domains without exclusive tests and cores whose siblings are idle.
+ * Returns the index of the CPU or -1 when all CPUs are reserved.
+ */
+static int __attribute__((pure)) find_cpu(const rk_placement_t *place)
+{
+	unsigned long long score, best_score = 0;
+	int best = -1;
+
+	for (size_t i = 0; i < place->topo.count; i++) {
+		if (place->reserved[i])
+			continue;
+
+		score = (unsigned long long)place->load[i] << 32 |
+			(unsigned long long)llc_reserved(place, i) << 1 |
+			siblings_busy(place, i);
+
+		if (best == -1 || score < best_score) {
+			best = (int)i;
+			best_score = score;
+		}
+	}
+
+	return best;
+}
+
+static bool __attribute__((pure)) can_place(const rk_placement_t *place,
+		const rk_job_t *job)
+{
+	if (!place->available)
+		return true;
+
+	if (job->exclusive)
+		return find_core(place) != -1;
+
+	return find_cpu(place) != -1;
+}
+
+static void place_job(rk_placement_t *place, rk_slot_t *slot,
+		const rk_job_t *job)
+{
+	int index;
+
+	slot->cpu = -1;
+	slot->core = -1;
+
+	if (!place->available)
+		return;
+
+	if (job->exclusive) {
+		index = find_core(place);
+		if (index == -1)
+			return;
+
+		slot->core = place->topo.cpus[index].core;
+
+		for (size_t i = 0; i < place->topo.count; i++) {
+			if (place->topo.cpus[i].core == slot->core)
+				place->reserved[i] = true;
+		}
+	} else {
+		index = find_cpu(place);
+		if (index == -1)
+			return;
+
+		place->load[index]++;
+	}
+
+	slot->cpu = index;
+}
+
+static void release_job(rk_placement_t *place, const rk_slot_t *slot)
+{
+	if (slot->core != -1) {
+		for (size_t i = 0; i < place->topo.count; i++) {
+			if (place->topo.cpus[i].core == slot->core)
+				place->reserved[i] = false;
+		}
+	} else if (slot->cpu != -1) {
+		place->load[slot->cpu]--;
+	}
+}
+
+static void placement_init(rk_placement_t *place)
+{
+	memset(place, 0, sizeof(rk_placement_t));
+
+	if (rk_topology_read_(&place->topo))
+		return;
+
+	place->load = calloc(place->topo.count, sizeof(unsigned int));
+	place->reserved = calloc(place->topo.count, sizeof(bool));
+
+	place->available = place->topo.count && place->load &&
+		place->reserved;
+}
+
+static void placement_free(rk_placement_t *place)
+{
+	rk_topology_free_(&place->topo);
+	free(place->load);
+	free(place->reserved);
+}
+
+/*
+ * Pick the first pending test whose predicted memory fits inside the budget.
+ * When nothing is running, the first test is always picked, so tests which
+ * need more than the whole budget still run, alone. Exclusive tests also
+ * need a free physical core and no test is picked while they wait for one.
+ */
+static rk_job_t *pick(rk_parallel_t *par, unsigned long long used_kb,
+		unsigned long long budget_kb, bool idle)
+{
+	rk_job_t *job;
+
+	for (size_t i = 0; i < par->npending; i++) {
+		job = par->pending[i];
+
+		if (!idle && budget_kb && used_kb + job->rss_kb > budget_kb)
+			continue;
+
+		/* later tests would keep cores busy and starve the benchmark */
+		if (!can_place(&par->place, job))
+			return NULL;
+
+		memmove(par->pending + i, par->pending + i + 1,
+			(par->npending - i - 1) * sizeof(rk_job_t *));
+		par->npending--;
+
+		return job;
+	}
+
+	return NULL;
+}
+
+static size_t __attribute__((pure)) test_index(const rk_parallel_t *par,
+		const rk_job_t *job, size_t pos)
+{
+	return par->order[job->first + pos];
+}
+
+/* Put a job back at the head of the queue, so it's the next one to run */
+static void unpick(rk_parallel_t *par, rk_job_t *job)
+{
+	memmove(par->pending + 1, par->pending,
+		par->npending * sizeof(rk_job_t *));
+	par->pending[0] = job;
+	par->npending++;
+}
+
+/* Report an error for each test which is still waiting to run */
+static void drop_pending(rk_parallel_t *par, int err)
+{
+	rk_job_t *job;
+	char name[64];
+	size_t index;
+
+	for (size_t i = 0; i < par->npending; i++) {
+		job = par->pending[i];
+
+		for (size_t j = 0; j < job->count; j++) {
+			index = test_index(par, job, j);
+			rk_test_name_(par->tests + index, index, name,
+				sizeof(name));
+			rk_error("Can't fork %s: %s", name, strerror(err));
+		}
+	}
+
+	par->npending = 0;
+}
+
+static void run_job(rk_parallel_t *par, const rk_job_t *job)
+{
+	unsigned long long start;
+	rk_progress_t *progress;
+	size_t index;
+
+	for (size_t i = 0; i < job->count; i++) {
+		index = test_index(par, job, i);
+		progress = par->progress + index;
+
+		rk_out_flush_();
+
+		/* output of a crashed test can be dropped when it runs again */
+		progress->offset = lseek(STDOUT_FILENO, 0, SEEK_CUR);
+		progress->started = true;
+
+		rk_session_count_(&progress->results);
+
+		start = rk_now_ns_();
+		par->run(index);
+		progress->duration_us = (rk_now_ns_() - start) / 1000;
+		progress->done = true;
+	}
+
+	rk_out_flush_();
+}
+
+static int spawn(rk_parallel_t *par, rk_slot_t *slot, rk_job_t *job)
+{
+	struct rlimit rl;
+	cpu_set_t set;
+	pid_t pid;
+	int fd;
+
+	for (size_t i = 0; i < job->count; i++) {
+		memset(par->progress + test_index(par, job, i), 0,
+			sizeof(rk_progress_t));
+	}
+
+	/* output is collected and printed at once when the test completes */
+	fd = memfd_create("riker-test", MFD_CLOEXEC);
+	if (fd == -1)
+		return -1;
+
+	rk_out_flush_();
+	fflush(stderr);
+
+	pid = fork();
+	if (pid == -1) {
+		close(fd);
+		return -1;
+	}
+
+	if (!pid) {
+		dup2(fd, STDOUT_FILENO);
+		rk_out_redirect_();
+
+		/* counters inherited from the parent are dumped by the parent */
+		rk_coverage_reset_();
+
+		par->progress[test_index(par, job, 0)].base_kb = rss_kb();
+
+		if (slot->cpu != -1) {
+			CPU_ZERO(&set);
+			CPU_SET((size_t)par->place.topo.cpus[slot->cpu].cpu, &set);
+			sched_setaffinity(0, sizeof(set), &set);
+		}
+
+		if (par->rlimit_kb) {
+			rl.rlim_cur = par->rlimit_kb * 1024;
+			rl.rlim_max = par->rlimit_kb * 1024;
+			setrlimit(RLIMIT_AS, &rl);
+		}
+
+		run_job(par, job);
+		_exit(0);
+	}
+
+	slot->job = job;
+	slot->pid = pid;
+	slot->out_fd = fd;
+	slot->start_ns = rk_now_ns_();
+
+	return 0;
+}
+
+/*
+ * Copy the output of a process, up to the given length, and write it at
+ * once. A negative length copies the whole output.
+ */
+static void copy_output(int fd, off_t length)
+{
+	char buf[PARALLEL_COPY_SIZE];
+	ssize_t len;
+	size_t size;
+
+	if (lseek(fd, 0, SEEK_SET) == -1)
+		return;
+
+	for (off_t copied = 0; length < 0 || copied < length; copied += len) {
+		size = sizeof(buf);
+		if (length >= 0 && (off_t)size > length - copied)
+			size = (size_t)(length - copied);
+
+		len = read(fd, buf, size);
+		if (len <= 0)
+			break;
+
+		rk_out_write_(buf, (size_t)len);
+	}
+
+	rk_out_flush_();
+}
+
+/*
+ * Run a part of a batch again inside a process whose output and results are
+ * dropped: the first `prefix` tests of the batch, then the test at `pos`.
+ * Returns true if the process crashed or exited before running all of them.
+ */
+static bool probe(rk_parallel_t *par, const rk_job_t *job, size_t prefix,
+		size_t pos)
+{
+	rk_counters_t results;
+	int status, fd, fds[2];
+	char done = 0;
+	pid_t pid;
+
+	/* tests calling exit(0) are told apart from the completed ones */
+	if (pipe2(fds, O_CLOEXEC))
+		return false;
+
+	rk_out_flush_();
+	fflush(stderr);
+
+	pid = fork();
+	if (pid == -1) {
+		close(fds[0]);
+		close(fds[1]);
+		return false;
+	}
+
+	if (!pid) {
+		close(fds[0]);
+
+		fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+		if (fd != -1)
+			dup2(fd, STDOUT_FILENO);
+
+		rk_out_redirect_();
+
+		rk_session_count_(&results);
+		rk_res_detach_();
+		rk_coverage_detach_();
+
+		for (size_t i = 0; i < prefix; i++)
+			par->run(test_index(par, job, i));
+
+		par->run(test_index(par, job, pos));
+
+		rk_out_flush_();
+
+		done = 1;
+		if (write(fds[1], &done, 1) != 1)
+			_exit(1);
+
+		_exit(0);
+	}
+
+	close(fds[1]);
+
+	while (read(fds[0], &done, 1) == -1 && errno == EINTR)
+		;
+
+	close(fds[0]);
+
+	while (waitpid(pid, &status, 0) == -1) {
+		if (errno != EINTR)
+			return false;
+	}
+
+	return !done || WIFSIGNALED(status) || WEXITSTATUS(status);
+}
+
+/*
+ * Search the test which makes the one at `pos` crash, or exit before it
+ * completed, when they run inside the same process, assuming this happens
+ * only after a certain test of the batch ran. Returns the position of the
+ * test, or `pos` if the test fails this way by itself.
+ */
+static size_t bisect(rk_parallel_t *par, const rk_job_t *job, size_t pos)
+{
+	size_t low = 0, high = pos, mid;
+
+	if (probe(par, job, 0, pos))
+		return pos;
+
+	/* crash can't be reproduced */
+	if (!probe(par, job, pos, pos))
+		return job->count;
+
+	/* running `low` tests doesn't crash, running `high` tests does */
+	while (high - low > 1) {
+		mid = low + (high - low) / 2;
+
+		if (probe(par, job, mid, pos))
+			high = mid;
+		else
+			low = mid;
+	}
+
+	return high - 1;
+}
+
+/*
+ * A test of the batch crashed or exited: tests before it are kept, the
+ * others run again inside a process each, so the failure is reported like
+ * the test ran alone.
+ */
+static void split_batch(rk_parallel_t *par, rk_slot_t *slot, size_t pos)
+{
+	rk_job_t *job = slot->job;
+	char name[64], culprit[64];
+	size_t count, found;
+	rk_job_t *single;
+
+	copy_output(slot->out_fd,
+		par->progress[test_index(par, job, pos)].offset);
+
+	found = bisect(par, job, pos);
+
+	rk_test_name_(par->tests + test_index(par, job, pos),
+		test_index(par, job, pos), name, sizeof(name));
+
+	if (found < pos) {
+		rk_test_name_(par->tests + test_index(par, job, found),
+			test_index(par, job, found), culprit, sizeof(culprit));
+
+		rk_result_(__FILE__, __LINE__, TINFO, "%s doesn't complete "
+			"after %s in the same process, running them in "
+			"separate processes", name, culprit);
+	} else if (found == job->count) {
+		rk_result_(__FILE__, __LINE__, TINFO, "%s didn't complete "
+			"inside a batch, running it in a separate process",
+			name);
+	}
+
+	/* new jobs run first, while their memory is still known */
+	count = job->count - pos;
+
+	memmove(par->pending + count, par->pending,
+		par->npending * sizeof(rk_job_t *));
+
+	for (size_t i = 0; i < count; i++) {
+		single = par->job_list + par->njobs++;
+		*single = *job;
+		single->first = job->first + pos + i;
+		single->count = 1;
+		single->batch = false;
+		single->duration_us = 0;
+
+		par->pending[i] = single;
+	}
+
+	par->npending += count;
+	job->count = pos;
+}
+
+/*
+ * Peak memory used by the tests of a job: the high-water RSS of the process
+ * minus what it inherited from the parent when it was forked.
+ */
+static unsigned long long peak_kb(rk_parallel_t *par, const rk_job_t *job,
+		const struct rusage *usage)
+{
+	unsigned long long maxrss = (unsigned long long)usage->ru_maxrss;
+	unsigned long long base = par->progress[test_index(par, job, 0)].base_kb;
+
+	return maxrss > base ? maxrss - base : 0;
+}
+
+static void reap(rk_parallel_t *par)
+{
+	rk_progress_t *progress = NULL;
+	struct rusage usage;
+	rk_slot_t *slot = NULL;
+	rk_job_t *job;
+	char name[64];
+	int status;
+	size_t pos;
+	pid_t pid;
+
+	do {
+		pid = wait4(-1, &status, 0, &usage);
+	} while (pid == -1 && errno == EINTR);
+
+	if (pid == -1)
+		return;
+
+	for (unsigned int i = 0; i < par->jobs; i++) {
+		if (par->slots[i].pid == pid) {
+			slot = par->slots + i;
+			break;
+		}
+	}
+
+	if (!slot)
+		return;
+
+	job = slot->job;
+
+	for (pos = 0; pos < job->count; pos++) {
+		progress = par->progress + test_index(par, job, pos);
+		if (!progress->done)
+			break;
+	}
+
+	/* exit(0) inside a test would skip the rest of the batch as well */
+	if (job->count > 1 && pos < job->count) {
+		split_batch(par, slot, pos);
+	} else {
+		copy_output(slot->out_fd, -1);
+
+		rk_test_name_(par->tests + test_index(par, job, 0),
+			test_index(par, job, 0), name, sizeof(name));
+
+		if (WIFSIGNALED(status)) {
+			rk_error("%s killed by signal %d (%s)", name,
+				WTERMSIG(status), strsignal(WTERMSIG(status)));
+		} else if (WEXITSTATUS(status)) {
+			rk_error("%s exited with %d", name,
+				WEXITSTATUS(status));
+		} else if (pos < job->count) {
+			rk_error("%s exited before completing", name);
+		}
+
+		/* a crashed test keeps the results of its checks and memory */
+		if (job->count == 1 && !progress->done) {
+			rk_session_add_(&progress->results);
+			rk_history_set_(par->tests[test_index(par, job, 0)].name,
+				peak_kb(par, job, &usage),
+				(rk_now_ns_() - slot->start_ns) / 1000);
+		}
+	}
+
+	close(slot->out_fd);
+
+	for (size_t i = 0; i < job->count; i++) {
+		progress = par->progress + test_index(par, job, i);
+		if (!progress->done)
+			continue;
+
+		rk_session_add_(&progress->results);
+
+		/* processes running a batch are accounted to all its tests */
+		rk_history_set_(par->tests[test_index(par, job, i)].name,
+			peak_kb(par, job, &usage),
+			progress->duration_us);
+	}
+
+	release_job(&par->place, slot);
+
+	slot->pid = 0;
+	slot->out_fd = -1;
+}
+
+static unsigned long long batch_threshold_us(void)
+{
+	const char *threshold = getenv("RIKER_BATCH_US");
+
+	if (!threshold)
+		return BATCH_SHORT_US;
+
+	return strtoull(threshold, NULL, 10);
+}
+
+/*
+ * Create the jobs of the tests. Consecutive tests which are known to be
+ * shorter than the threshold are grouped, so fork() and wait() don't last
+ * more than the tests themselves.
+ */
+static size_t create_jobs(rk_parallel_t *par, unsigned long long default_kb)
+{
+	unsigned long long threshold = batch_threshold_us();
+	unsigned long long rss_kb, duration_us;
+	rk_job_t *job = NULL;
+	size_t batched = 0;
+	bool known, exclusive, batch;
+
+	for (size_t i = 0; i < par->ntests; i++) {
+		rss_kb = default_kb;
+		duration_us = 0;
+
+		known = !rk_history_get_(par->tests[par->order[i]].name,
+			&rss_kb, &duration_us);
+		exclusive = par->tests[par->order[i]].flags & RK_TEST_EXCLUSIVE;
+		batch = known && !exclusive && duration_us < threshold;
+
+		if (batch && job && job->batch && job->count < BATCH_MAX &&
+			job->duration_us + duration_us <= BATCH_TARGET_US) {
+			job->count++;
+			job->duration_us += duration_us;
+
+			if (rss_kb > job->rss_kb)
+				job->rss_kb = rss_kb;
+
+			batched += job->count == 2 ? 2 : 1;
+			continue;
+		}
+
+		job = par->job_list + par->njobs++;
+		job->first = i;
+		job->count = 1;
+		job->rss_kb = rss_kb;
+		job->duration_us = duration_us;
+		job->known = known;
+		job->exclusive = exclusive;
+		job->batch = batch;
+	}
+
+	return batched;
+}
+
+void rk_run_parallel_(rk_test_t *tests, size_t count, unsigned int jobs,
+		unsigned int threads, rk_run_func_ run)
+{
+	unsigned long long budget_kb, used_kb = 0;
+	unsigned int running = 0;
+	rk_parallel_t par;
+	size_t batched;
+	int failed;
+	char name[64];
+	rk_job_t *job;
+
+	memset(&par, 0, sizeof(rk_parallel_t));
+
+	par.tests = tests;
+	par.run = run;
+	par.jobs = jobs;
+
+	/* tests of a crashed batch are added as new jobs, once each */
+	par.order = calloc(count, sizeof(size_t));
+	par.job_list = calloc(count * 2, sizeof(rk_job_t));
+	par.pending = calloc(count * 2, sizeof(rk_job_t *));
+	par.slots = calloc(jobs, sizeof(rk_slot_t));
+
+	if (!par.order || !par.job_list || !par.pending || !par.slots) {
+		rk_error("calloc() error: %s", strerror(errno));
+		goto exit;
+	}
+
+	par.progress = mmap(NULL, count * sizeof(rk_progress_t),
+		PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+	if (par.progress == MAP_FAILED) {
+		par.progress = NULL;
+		rk_error("mmap() error: %s", strerror(errno));
+		goto exit;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		if (tests[i].run && !rk_test_pooled_(tests + i, threads))
+			par.order[par.ntests++] = i;
+	}
+
+	budget_kb = memory_budget_kb();
+
+	if (getenv("RIKER_RLIMIT_AS"))
+		par.rlimit_kb = budget_kb;
+
+	rk_history_load_();
+	placement_init(&par.place);
+
+	/* unknown tests evenly share the budget between the jobs */
+	batched = create_jobs(&par, budget_kb / jobs);
+
+	/* longest tests first, so the last ones to complete are short */
+	qsort(par.job_list, par.njobs, sizeof(rk_job_t), compare_jobs);
+
+	for (size_t i = 0; i < par.njobs; i++)
+		par.pending[i] = par.job_list + i;
+
+	par.npending = par.njobs;
+
+	rk_out_printf_("Running %zu tests on %u jobs, memory budget %llu MB\n",
+		par.ntests, jobs, budget_kb / 1024);
+
+	if (batched) {
+		rk_out_printf_("Batching %zu short tests into %zu processes\n",
+			batched, batched + par.njobs - par.ntests);
+	}
+
+	if (par.place.available)
+		rk_topology_report_(&par.place.topo);
+
+	while (par.npending || running) {
+		failed = 0;
+
+		while (running < jobs && !failed) {
+			job = pick(&par, used_kb, budget_kb, !running);
+			if (!job)
+				break;
+
+			for (unsigned int i = 0; i < jobs; i++) {
+				rk_slot_t *slot = par.slots + i;
+
+				if (slot->pid)
+					continue;
+
+				place_job(&par.place, slot, job);
+
+				/* tried again once a running test completes */
+				if (spawn(&par, slot, job)) {
+					failed = errno;
+					release_job(&par.place, slot);
+					unpick(&par, job);
+					break;
+				}
+
+				if (slot->core != -1) {
+					rk_test_name_(tests + test_index(&par,
+						job, 0), test_index(&par, job, 0),
+						name, sizeof(name));
+					rk_out_printf_("Placing %s on core %d, "
+						"CPU %d\n", name, slot->core,
+						par.place.topo.cpus[slot->cpu].cpu);
+				}
+
+				used_kb += job->rss_kb;
+				running++;
+				break;
+			}
+		}
+
+		/* nothing would release what fork() is missing */
+		if (!running) {
+			if (failed)
+				drop_pending(&par, failed);
+
+			break;
+		}
+
+		reap(&par);
+
+		/* release the memory of the slots which completed */
+		used_kb = 0;
+		running = 0;
+
+		for (unsigned int i = 0; i < jobs; i++) {
+			if (!par.slots[i].pid)
+				continue;
+
+			used_kb += par.slots[i].job->rss_kb;
+			running++;
+		}
+	}
+
+	rk_history_save_();
+	placement_free(&par.place);
+
+exit:
+	if (par.progress)
+		munmap(par.progress, count * sizeof(rk_progress_t));
+
+	free(par.order);
+	free(par.job_list);
+	free(par.pending);
+	free(par.slots);
+}
@@ -0,0 +1,174 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) 2025 Andrea Cervesato <andrea.cervesato@mailbox.org>
+ */
+
+#include "riker_internal.h"
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+/*
+ * Tests assigned to a worker. The owner takes tests from the tail, other
+ * workers steal them from the head once they run out of tests. A spinlock
+ * is used, so the pool doesn't show up in the lock contention report.
+ */
+typedef struct
+{
+	size_t *tests;
+	size_t head;
+	size_t tail;
+	bool lock;
+	char padding[7];
+} rk_deque_t;
+
+typedef struct rk_pool rk_pool_t;
+
+typedef struct
+{
+	rk_pool_t *pool;
+	rk_deque_t deque;
+	pthread_t thread;
+	unsigned int id;
+	char padding[4];
+} rk_worker_t;
+
+struct rk_pool
+{
+	rk_worker_t *workers;
+	rk_run_func_ run;
+	unsigned int count;
+	char padding[4];
+};
+
+static void deque_lock(rk_deque_t *deque)
+{
+	while (__atomic_test_and_set(&deque->lock, __ATOMIC_ACQUIRE))
+		sched_yield();
+}
+
+static void deque_unlock(rk_deque_t *deque)
+{
+	__atomic_clear(&deque->lock, __ATOMIC_RELEASE);
+}
+
+static bool deque_pop(rk_deque_t *deque, size_t *index, bool steal)
+{
+	bool found = false;
+
+	deque_lock(deque);
+
+	if (deque->head < deque->tail) {
+		if (steal)
+			*index = deque->tests[deque->head++];
+		else
+			*index = deque->tests[--deque->tail];
+
+		found = true;
+	}
+
+	deque_unlock(deque);
+
+	return found;
+}
+
+static void *worker_loop(void *arg)
+{
+	rk_worker_t *worker = arg;
+	rk_pool_t *pool = worker->pool;
+	rk_worker_t *victim;
+	size_t index;
+	bool found;
+
+	for (;;) {
+		found = deque_pop(&worker->deque, &index, false);
+
+		/* tests are never added, so empty deques stay empty */
+		for (unsigned int i = 1; !found && i < pool->count; i++) {
+			victim = pool->workers + (worker->id + i) % pool->count;
+			found = deque_pop(&victim->deque, &index, true);
+		}
+
+		if (!found)
+			break;
+
+		pool->run(index);
+	}
+
+	rk_arena_release_();
+	rk_regex_release_();
+	rk_out_release_();
+
+	return NULL;
+}
+
+void rk_run_pool_(rk_test_t *tests, size_t count, unsigned int threads,
+		rk_run_func_ run)
+{
+	rk_pool_t pool = { .run = run, .count = threads };
+	size_t *indexes, ntests = 0, start = 0, share;
+	unsigned int started = 0;
+	int ret;
+
+	for (size_t i = 0; i < count; i++) {
+		if (rk_test_pooled_(tests + i, threads))
+			ntests++;
+	}
+
+	if (!ntests)
+		return;
+
+	indexes = calloc(ntests, sizeof(size_t));
+	pool.workers = calloc(threads, sizeof(rk_worker_t));
+
+	if (!indexes || !pool.workers) {
+		rk_error("calloc() error: %s", strerror(errno));
+		goto exit;
+	}
+
+	ntests = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		if (rk_test_pooled_(tests + i, threads))
+			indexes[ntests++] = i;
+	}
+
+	rk_out_printf_("Running %zu thread-safe tests on %u threads\n", ntests,
+		threads);
+
+	rk_out_flush_();
+
+	/* consecutive tests are given to the same worker */
+	for (unsigned int i = 0; i < threads; i++) {
+		rk_worker_t *worker = pool.workers + i;
+
+		share = (ntests - start) / (threads - i);
+
+		worker->pool = &pool;
+		worker->id = i;
+		worker->deque.tests = indexes + start;
+		worker->deque.tail = share;
+
+		start += share;
+	}
+
+	for (; started < threads; started++) {
+		ret = pthread_create(&pool.workers[started].thread, NULL,
+			worker_loop, pool.workers + started);
+		if (ret) {
+			rk_error("pthread_create() error: %s", strerror(ret));
+			break;
+		}
+	}
+
+	/* tests of the workers which didn't start are stolen by the others */
+	if (!started)
+		worker_loop(pool.workers);
+
+	for (unsigned int i = 0; i < started; i++)
+		pthread_join(pool.workers[i].thread, NULL);
+
+exit:
+	free(indexes);
+	free(pool.workers);
+}
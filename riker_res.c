@@ -0,0 +1,509 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) 2025 Andrea Cervesato <andrea.cervesato@mailbox.org>
+ */
+
+#include "riker_internal.h"
+#include <time.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <stdbool.h>
+#include <sys/mman.h>
+
+/* CPU clock of a thread, as built by the kernel's MAKE_THREAD_CPUCLOCK() */
+#define THREAD_CPUCLOCK(tid) ((clockid_t)((~(unsigned int)(tid) << 3) | 6))
+
+/* Width of the test name column inside the resource table */
+#define RES_NAME_WIDTH 24
+
+/* Busiest threads of a test reported in their own rows */
+#define RES_THREADS 4
+
+typedef struct
+{
+	unsigned long long cpu_ns;
+	unsigned long long wait_ns;
+	unsigned long long slices;
+	long tid;
+} rk_sched_t;
+
+typedef struct
+{
+	rk_sched_t *entries;
+	size_t count;
+	size_t size;
+	unsigned long long cpu_ns;
+} rk_sched_list_t;
+
+typedef struct
+{
+	const char *name;
+	rk_io_t io[RK_IO_TOTAL];
+	unsigned long long wall_ns;
+	rk_sched_t sched;
+	/* busiest threads, sorted by on-CPU time */
+	rk_sched_t threads[RES_THREADS];
+	size_t nthreads;
+	size_t index;
+	bool used;
+	bool exited;
+	char padding[6];
+} rk_res_record_t;
+
+typedef struct
+{
+	rk_res_record_t *records;
+	rk_res_record_t *current;
+	size_t count;
+	rk_io_t start;
+	size_t start_len;
+	size_t self_len;
+	size_t self_reads;
+	rk_sched_list_t sched_start;
+	rk_sched_list_t sched_end;
+	unsigned long long start_ns;
+	int block;
+	bool available;
+	char padding[3];
+} rk_res_t;
+
+static rk_res_t res = { .block = -1, .available = true };
+
+static const char *const io_fields[] = {
+	"rchar", "wchar", "syscr", "syscw", "read_bytes", "write_bytes",
+};
+
+/*
+ * Read I/O counters of the process. Reading /proc/self/io is accounted as
+ * I/O of the process as well, so the number of bytes read is returned to
+ * be removed from the next measurement.
+ */
+static int read_io(rk_io_t *io, size_t *len)
+{
+	unsigned long long *values = (unsigned long long *)io;
+	char buf[512], *line, *value;
+	ssize_t ret;
+	int fd;
+
+	memset(io, 0, sizeof(rk_io_t));
+
+	fd = open("/proc/self/io", O_RDONLY | O_CLOEXEC);
+	if (fd == -1)
+		return -1;
+
+	ret = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+
+	if (ret <= 0)
+		return -1;
+
+	buf[ret] = '\0';
+	*len = (size_t)ret;
+
+	for (line = buf; line && *line; line = strchr(line, '\n')) {
+		if (*line == '\n')
+			line++;
+
+		value = strchr(line, ':');
+		if (!value)
+			break;
+
+		for (size_t i = 0; i < RK_IO_FIELDS; i++) {
+			size_t field_len = strlen(io_fields[i]);
+
+			if ((size_t)(value - line) == field_len &&
+				!strncmp(line, io_fields[i], field_len)) {
+				values[i] = strtoull(value + 1, NULL, 10);
+				break;
+			}
+		}
+	}
+
+	return 0;
+}
+
+static void io_delta(const rk_io_t *now, rk_io_t *delta)
+{
+	const unsigned long long *a = (const unsigned long long *)now;
+	const unsigned long long *b = (const unsigned long long *)&res.start;
+	unsigned long long *d = (unsigned long long *)delta;
+	unsigned long long len = res.start_len + res.self_len;
+	unsigned long long reads = 1 + res.self_reads;
+
+	for (size_t i = 0; i < RK_IO_FIELDS; i++)
+		d[i] = a[i] > b[i] ? a[i] - b[i] : 0;
+
+	/* remove the read() of the starting snapshot and of rk_io_usage() */
+	delta->rchar = delta->rchar > len ? delta->rchar - len : 0;
+	delta->syscr = delta->syscr > reads ? delta->syscr - reads : 0;
+}
+
+static void io_add(rk_io_t *io, const rk_io_t *delta)
+{
+	unsigned long long *a = (unsigned long long *)io;
+	const unsigned long long *d = (const unsigned long long *)delta;
+
+	for (size_t i = 0; i < RK_IO_FIELDS; i++)
+		a[i] += d[i];
+}
+
+static int read_task_sched(long tid, rk_sched_t *sched)
+{
+	char path[64], buf[128];
+	struct timespec ts;
+	ssize_t ret;
+	int fd;
+
+	snprintf(path, sizeof(path), "/proc/self/task/%ld/schedstat", tid);
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd == -1)
+		return -1;
+
+	ret = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+
+	if (ret <= 0)
+		return -1;
+
+	buf[ret] = '\0';
+
+	if (sscanf(buf, "%llu %llu %llu", &sched->cpu_ns, &sched->wait_ns,
+			&sched->slices) != 3)
+		return -1;
+
+	/*
+	 * schedstat on-CPU time is updated on scheduler events only, while the
+	 * thread CPU clock includes the time of the running timeslice.
+	 */
+	if (!clock_gettime(THREAD_CPUCLOCK(tid), &ts)) {
+		sched->cpu_ns = (unsigned long long)ts.tv_sec * 1000000000ULL +
+			(unsigned long long)ts.tv_nsec;
+	}
+
+	sched->tid = tid;
+
+	return 0;
+}
+
+/*
+ * Read the scheduler statistics of all the threads of the process: time
+ * spent on a CPU, time spent waiting on a run queue and number of timeslices.
+ */
+static void read_sched(rk_sched_list_t *list)
+{
+	struct dirent *ent;
+	rk_sched_t *ptr;
+	DIR *dir;
+
+	list->count = 0;
+
+	dir = opendir("/proc/self/task");
+	if (!dir)
+		return;
+
+	while ((ent = readdir(dir))) {
+		if (ent->d_name[0] == '.')
+			continue;
+
+		if (list->count == list->size) {
+			ptr = realloc(list->entries, (list->size + 16) *
+					sizeof(rk_sched_t));
+			if (!ptr)
+				break;
+
+			list->entries = ptr;
+			list->size += 16;
+		}
+
+		if (!read_task_sched(strtol(ent->d_name, NULL, 10),
+				list->entries + list->count))
+			list->count++;
+	}
+
+	closedir(dir);
+}
+
+/*
+ * Read the CPU time of the whole process, which includes the threads which
+ * already exited.
+ */
+static void read_process(rk_sched_list_t *list)
+{
+	struct timespec ts;
+
+	if (!clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts)) {
+		list->cpu_ns = (unsigned long long)ts.tv_sec * 1000000000ULL +
+			(unsigned long long)ts.tv_nsec;
+	}
+}
+
+/* Keep the thread among the busiest ones of the record, if it's one */
+static void add_thread(rk_res_record_t *rec, const rk_sched_t *thread)
+{
+	size_t pos = rec->nthreads < RES_THREADS ? rec->nthreads++ :
+		RES_THREADS;
+
+	while (pos && rec->threads[pos - 1].cpu_ns < thread->cpu_ns) {
+		if (pos < RES_THREADS)
+			rec->threads[pos] = rec->threads[pos - 1];
+		pos--;
+	}
+
+	if (pos < RES_THREADS)
+		rec->threads[pos] = *thread;
+}
+
+/*
+ * Threads created by the test are accounted since they started. Threads
+ * which exited during the test are left in the CPU time of the process, but
+ * their run queue time and timeslices are lost. The process CPU time is read
+ * after the threads at start and before them at the end, so the threads
+ * can't account less CPU time than the process unless one of them exited.
+ */
+static bool sched_delta(rk_res_record_t *rec)
+{
+	rk_sched_t *delta = &rec->sched;
+	const rk_sched_t *end, *start;
+	rk_sched_t thread;
+	size_t found = 0;
+	unsigned long long cpu_ns;
+
+	memset(delta, 0, sizeof(rk_sched_t));
+	rec->nthreads = 0;
+
+	for (size_t i = 0; i < res.sched_end.count; i++) {
+		end = res.sched_end.entries + i;
+		start = NULL;
+
+		for (size_t j = 0; j < res.sched_start.count; j++) {
+			if (res.sched_start.entries[j].tid == end->tid) {
+				start = res.sched_start.entries + j;
+				found++;
+				break;
+			}
+		}
+
+		thread.tid = end->tid;
+		thread.cpu_ns = end->cpu_ns - (start ? start->cpu_ns : 0);
+		thread.wait_ns = end->wait_ns - (start ? start->wait_ns : 0);
+		thread.slices = end->slices - (start ? start->slices : 0);
+
+		delta->cpu_ns += thread.cpu_ns;
+		delta->wait_ns += thread.wait_ns;
+		delta->slices += thread.slices;
+
+		add_thread(rec, &thread);
+	}
+
+	cpu_ns = res.sched_end.cpu_ns - res.sched_start.cpu_ns;
+
+	if (found == res.sched_start.count && cpu_ns <= delta->cpu_ns)
+		return false;
+
+	delta->cpu_ns = cpu_ns;
+
+	return true;
+}
+
+void rk_res_init_(size_t count)
+{
+	void *ptr;
+
+	if (!count)
+		return;
+
+	/* shared memory lets forked tests write their own record */
+	ptr = mmap(NULL, count * sizeof(rk_res_record_t),
+		PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+	if (ptr == MAP_FAILED)
+		return;
+
+	res.records = ptr;
+	res.count = count;
+}
+
+void rk_res_start_(size_t index, const char *name)
+{
+	if (index >= res.count)
+		return;
+
+	res.current = res.records + index;
+	res.current->name = name;
+	res.current->index = index;
+	res.current->used = true;
+	res.block = -1;
+
+	res.start_ns = rk_now_ns_();
+	read_sched(&res.sched_start);
+	read_process(&res.sched_start);
+}
+
+static void account_io(void)
+{
+	rk_io_t now, delta;
+	size_t len = 0;
+
+	if (!res.available)
+		return;
+
+	if (read_io(&now, &len)) {
+		res.available = false;
+		return;
+	}
+
+	if (res.block >= 0) {
+		io_delta(&now, &delta);
+		io_add(res.current->io + res.block, &delta);
+	}
+
+	res.start = now;
+	res.start_len = len;
+	res.self_len = 0;
+	res.self_reads = 0;
+}
+
+void rk_res_phase_(int block)
+{
+	if (!res.current)
+		return;
+
+	account_io();
+	res.block = block;
+
+	if (block >= 0)
+		return;
+
+	read_process(&res.sched_end);
+	read_sched(&res.sched_end);
+	res.current->exited = sched_delta(res.current);
+
+	res.current->wall_ns = rk_now_ns_() - res.start_ns;
+
+	res.current = NULL;
+}
+
+int rk_io_usage(rk_io_block_t block, rk_io_t *io)
+{
+	rk_io_t now, delta;
+	size_t len;
+
+	assert(io);
+
+	memset(io, 0, sizeof(rk_io_t));
+
+	if (!res.current || !res.available) {
+		errno = ENODATA;
+		return -1;
+	}
+
+	for (int i = 0; i < RK_IO_TOTAL; i++) {
+		if (block == RK_IO_TOTAL || block == (rk_io_block_t)i)
+			io_add(io, res.current->io + i);
+	}
+
+	/* the phase which is running hasn't been accounted yet */
+	if (res.block == (int)block ||
+		(block == RK_IO_TOTAL && res.block >= 0)) {
+		if (read_io(&now, &len))
+			return -1;
+
+		io_delta(&now, &delta);
+		io_add(io, &delta);
+
+		res.self_len += len;
+		res.self_reads++;
+	}
+
+	return 0;
+}
+
+void rk_res_detach_(void)
+{
+	res.records = NULL;
+	res.current = NULL;
+	res.count = 0;
+}
+
+void rk_res_report_(void)
+{
+	unsigned long long busy;
+	char blocked[24];
+	rk_io_t total;
+	char name[32];
+
+	if (!getenv("RIKER_RESOURCES") || !res.records)
+		goto exit;
+
+	rk_out_printf_("\nResources:\n%-*s", RES_NAME_WIDTH, "test");
+	for (size_t i = 0; i < RK_IO_FIELDS; i++)
+		rk_out_printf_(" %12s", io_fields[i]);
+	rk_out_printf_(" %10s %10s %10s %10s %8s\n", "wall_us", "cpu_us",
+		"runq_us", "blocked_us", "slices");
+
+	for (size_t i = 0; i < res.count; i++) {
+		rk_res_record_t *rec = res.records + i;
+		unsigned long long *values = (unsigned long long *)&total;
+
+		if (!rec->used)
+			continue;
+
+		memset(&total, 0, sizeof(rk_io_t));
+		for (int j = 0; j < RK_IO_TOTAL; j++)
+			io_add(&total, rec->io + j);
+
+		if (rec->name)
+			snprintf(name, sizeof(name), "%s", rec->name);
+		else
+			snprintf(name, sizeof(name), "test %zu", rec->index + 1);
+
+		/*
+		 * threads time can be higher than wall time, and the run queue
+		 * time of the threads which exited is unknown
+		 */
+		busy = rec->sched.cpu_ns + rec->sched.wait_ns;
+
+		if (rec->exited) {
+			snprintf(blocked, sizeof(blocked), "-");
+		} else {
+			snprintf(blocked, sizeof(blocked), "%llu",
+				(rec->wall_ns > busy ? rec->wall_ns - busy : 0) /
+				1000);
+		}
+
+		rk_out_printf_("%-*.*s", RES_NAME_WIDTH, RES_NAME_WIDTH, name);
+		for (size_t j = 0; j < RK_IO_FIELDS; j++)
+			rk_out_printf_(" %12llu", values[j]);
+		rk_out_printf_(" %10llu %10llu %10llu %10s %8llu\n",
+			rec->wall_ns / 1000, rec->sched.cpu_ns / 1000,
+			rec->sched.wait_ns / 1000, blocked, rec->sched.slices);
+
+		/* tests running more threads have a row for the busiest ones */
+		for (size_t j = 0; rec->nthreads > 1 && j < rec->nthreads; j++) {
+			snprintf(name, sizeof(name), "  tid %ld",
+				rec->threads[j].tid);
+
+			rk_out_printf_("%-*s%*s %10s %10llu %10llu %10s %8llu\n",
+				RES_NAME_WIDTH, name, (int)RK_IO_FIELDS * 13, "",
+				"", rec->threads[j].cpu_ns / 1000,
+				rec->threads[j].wait_ns / 1000, "",
+				rec->threads[j].slices);
+		}
+	}
+
+exit:
+	free(res.sched_start.entries);
+	free(res.sched_end.entries);
+	memset(&res.sched_start, 0, sizeof(rk_sched_list_t));
+	memset(&res.sched_end, 0, sizeof(rk_sched_list_t));
+
+	if (res.records)
+		munmap(res.records, res.count * sizeof(rk_res_record_t));
+
+	res.records = NULL;
+	res.current = NULL;
+	res.count = 0;
+}
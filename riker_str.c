@@ -0,0 +1,259 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) 2025 Andrea Cervesato <andrea.cervesato@mailbox.org>
+ */
+
+#include "riker_internal.h"
+#include <limits.h>
+#include <stdlib.h>
+#include <regex.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* Number of compiled regular expressions kept in cache by each thread */
+#define REGEX_CACHE_SIZE 16
+
+/* Longest buffer whose end fits inside a signed regoff_t */
+#define REGEX_MAX_LEN (((size_t)1 << (sizeof(regoff_t) * CHAR_BIT - 1)) - 1)
+
+typedef struct
+{
+	char *pattern;
+	regex_t regex;
+	int error;
+	char padding[4];
+} rk_regex_entry_t;
+
+/*
+ * regexec() serializes the threads matching the same compiled pattern, so
+ * each thread compiles the patterns it uses.
+ */
+static __thread rk_regex_entry_t regex_cache[REGEX_CACHE_SIZE];
+static __thread size_t regex_next;
+
+static const char *__attribute__((pure)) memmem_scalar(const char *haystack,
+		size_t haystack_len, const char *needle, size_t needle_len)
+{
+	const char *end = haystack + haystack_len - needle_len + 1;
+	const char *pos = haystack;
+
+	if (needle_len > haystack_len)
+		return NULL;
+
+	while (pos < end) {
+		pos = memchr(pos, needle[0], (size_t)(end - pos));
+		if (!pos)
+			return NULL;
+
+		if (pos[needle_len - 1] == needle[needle_len - 1] &&
+			!memcmp(pos + 1, needle + 1, needle_len - 2))
+			return pos;
+
+		pos++;
+	}
+
+	return NULL;
+}
+
+#ifdef __SSE2__
+
+/*
+ * Compare 16 positions at once against the first and the last byte of the
+ * needle, then fully compare only the positions where both bytes match.
+ */
+static const char *__attribute__((pure)) memmem_sse2(const char *haystack,
+		size_t haystack_len, const char *needle, size_t needle_len)
+{
+	const __m128i first = _mm_set1_epi8(needle[0]);
+	const __m128i last = _mm_set1_epi8(needle[needle_len - 1]);
+	size_t positions = haystack_len - needle_len + 1;
+	const char *pos;
+	size_t i;
+
+	for (i = 0; i + 16 <= positions; i += 16) {
+		const __m128i block_first = _mm_loadu_si128(
+			(const __m128i *)(const void *)(haystack + i));
+		const __m128i block_last = _mm_loadu_si128(
+			(const __m128i *)(const void *)(haystack + i +
+				needle_len - 1));
+		unsigned int mask = (unsigned int)_mm_movemask_epi8(
+			_mm_and_si128(_mm_cmpeq_epi8(first, block_first),
+				_mm_cmpeq_epi8(last, block_last)));
+
+		while (mask) {
+			unsigned int bit = (unsigned int)__builtin_ctz(mask);
+
+			pos = haystack + i + bit;
+			if (!memcmp(pos + 1, needle + 1, needle_len - 2))
+				return pos;
+
+			mask &= mask - 1;
+		}
+	}
+
+	return memmem_scalar(haystack + i, haystack_len - i, needle,
+		needle_len);
+}
+
+#endif
+
+const char *rk_memmem_(const char *haystack, size_t haystack_len,
+		const char *needle, size_t needle_len)
+{
+	if (!needle_len)
+		return haystack;
+
+	if (needle_len > haystack_len)
+		return NULL;
+
+	if (needle_len == 1)
+		return memchr(haystack, needle[0], haystack_len);
+
+#ifdef __SSE2__
+	return memmem_sse2(haystack, haystack_len, needle, needle_len);
+#else
+	return memmem_scalar(haystack, haystack_len, needle, needle_len);
+#endif
+}
+
+size_t rk_line_of_(const char *buf, size_t offset)
+{
+	const char *end = buf + offset;
+	size_t line = 1;
+
+	while ((buf = memchr(buf, '\n', (size_t)(end - buf)))) {
+		line++;
+		buf++;
+	}
+
+	return line;
+}
+
+size_t rk_count_(const char *buf, size_t len, const char *needle,
+		size_t needle_len)
+{
+	const char *end = buf + len;
+	const char *pos = buf;
+	size_t count = 0;
+
+	if (!needle_len)
+		return 0;
+
+	while ((pos = rk_memmem_(pos, (size_t)(end - pos), needle,
+			needle_len))) {
+		count++;
+		pos += needle_len;
+	}
+
+	return count;
+}
+
+size_t rk_nearest_(const char *buf, size_t len, const char *needle,
+		size_t needle_len, size_t *offset)
+{
+	size_t low = 0, high = needle_len;
+	const char *pos;
+
+	*offset = 0;
+
+	/* binary search of the longest needle prefix found inside buf */
+	while (low < high) {
+		size_t mid = low + (high - low + 1) / 2;
+
+		pos = rk_memmem_(buf, len, needle, mid);
+		if (pos) {
+			low = mid;
+			*offset = (size_t)(pos - buf);
+		} else {
+			high = mid - 1;
+		}
+	}
+
+	return low;
+}
+
+static rk_regex_entry_t *compile(const char *pattern)
+{
+	rk_regex_entry_t *entry;
+
+	for (size_t i = 0; i < REGEX_CACHE_SIZE; i++) {
+		entry = regex_cache + i;
+
+		if (entry->pattern && !strcmp(entry->pattern, pattern))
+			return entry;
+	}
+
+	entry = regex_cache + regex_next;
+	regex_next = (regex_next + 1) % REGEX_CACHE_SIZE;
+
+	if (entry->pattern) {
+		if (!entry->error)
+			regfree(&entry->regex);
+
+		free(entry->pattern);
+	}
+
+	entry->pattern = strdup(pattern);
+	if (!entry->pattern)
+		return NULL;
+
+	entry->error = regcomp(&entry->regex, pattern,
+			REG_EXTENDED | REG_NEWLINE);
+
+	return entry;
+}
+
+int rk_regex_(const char *buf, size_t len, const char *pattern,
+		size_t *offset)
+{
+	rk_regex_entry_t *entry;
+	regmatch_t match;
+	int ret;
+
+	/*
+	 * regexec() reports the offsets of a match as regoff_t, an int, which
+	 * can't hold positions past the first 2 GiB of the buffer
+	 */
+	if (len > REGEX_MAX_LEN) {
+		errno = EOVERFLOW;
+		return -1;
+	}
+
+	entry = compile(pattern);
+	if (!entry || entry->error) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	/* REG_STARTEND lets us match buffers which aren't NULL terminated */
+	match.rm_so = 0;
+	match.rm_eo = (regoff_t)len;
+
+	ret = regexec(&entry->regex, buf, 1, &match, REG_STARTEND);
+	if (ret)
+		return 0;
+
+	*offset = (size_t)match.rm_so;
+
+	return 1;
+}
+
+void rk_regex_release_(void)
+{
+	for (size_t i = 0; i < REGEX_CACHE_SIZE; i++) {
+		rk_regex_entry_t *entry = regex_cache + i;
+
+		if (!entry->pattern)
+			continue;
+
+		if (!entry->error)
+			regfree(&entry->regex);
+
+		free(entry->pattern);
+		entry->pattern = NULL;
+	}
+
+	regex_next = 0;
+}
@@ -0,0 +1,578 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) 2025 Andrea Cervesato <andrea.cervesato@mailbox.org>
+ */
+
+#define _GNU_SOURCE
+
+#include "riker_internal.h"
+#include <poll.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <sys/un.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+/* Maximum number of clients connected to a stub at the same time */
+#define STUB_CLIENTS 64
+
+/* Size of the buffer holding the requests of a client */
+#define STUB_REQUEST_SIZE (64 * 1024)
+
+/* Bandwidth limited responses are sent in slices of this duration */
+#define STUB_SLICE_NS 10000000ULL
+
+/*
+ * Client of the stub. Requests are buffered until they are complete, then
+ * they are answered in order: the response of a client is sent when it's
+ * due, without delaying the other clients.
+ */
+typedef struct
+{
+	char *buf;
+	size_t len;
+	const rk_stub_rule_t *rule;
+	size_t sent;
+	size_t quota;
+	unsigned long long due_ns;
+	int fd;
+	bool blocked;
+	char padding[3];
+} rk_stub_conn_t;
+
+struct rk_service_stub
+{
+	const rk_stub_rule_t *rules;
+	unsigned long latency_us;
+	unsigned long bandwidth;
+	char *traffic;
+	size_t traffic_len;
+	size_t traffic_size;
+	size_t requests;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	char address[sizeof(((struct sockaddr_un *)0)->sun_path)];
+	char tmpdir[32];
+	int domain;
+	int listen_fd;
+	int wake[2];
+	int port;
+};
+
+static void record(rk_service_stub_t *stub, const char *buf, size_t len)
+{
+	size_t size;
+	char *ptr;
+
+	pthread_mutex_lock(&stub->lock);
+
+	if (stub->traffic_len + len > stub->traffic_size) {
+		size = stub->traffic_size ? stub->traffic_size : 4096;
+		while (size < stub->traffic_len + len)
+			size *= 2;
+
+		ptr = realloc(stub->traffic, size);
+		if (!ptr) {
+			pthread_mutex_unlock(&stub->lock);
+			return;
+		}
+
+		stub->traffic = ptr;
+		stub->traffic_size = size;
+	}
+
+	memcpy(stub->traffic + stub->traffic_len, buf, len);
+	stub->traffic_len += len;
+	stub->requests++;
+
+	pthread_mutex_unlock(&stub->lock);
+}
+
+/*
+ * Length of the request at the head of the buffer, as terminated by the end
+ * of `rule`, 0 if the request is not complete yet.
+ */
+static size_t __attribute__((pure)) request_len(const rk_stub_rule_t *rule,
+		const char *buf, size_t len)
+{
+	const char *end = rule->end ? rule->end : "\n";
+	size_t end_len = strlen(end);
+	size_t pos = rule->request ? strlen(rule->request) : 0;
+	const char *found;
+
+	if (!end_len || pos > len)
+		return 0;
+
+	found = memmem(buf + pos, len - pos, end, end_len);
+	if (!found)
+		return 0;
+
+	return (size_t)(found - buf) + end_len;
+}
+
+/*
+ * Match the request at the head of the buffer: the first rule whose prefix
+ * matches, or could match once more data is received, is used. Returns -1
+ * for unknown requests, 0 if the request is not complete yet.
+ */
+static int match(rk_service_stub_t *stub, rk_stub_conn_t *conn)
+{
+	const rk_stub_rule_t *rule;
+	size_t req_len, len;
+
+	for (rule = stub->rules; rule->response; rule++) {
+		req_len = rule->request ? strlen(rule->request) : 0;
+		len = req_len < conn->len ? req_len : conn->len;
+
+		if (rule->request && memcmp(conn->buf, rule->request, len))
+			continue;
+
+		len = request_len(rule, conn->buf, conn->len);
+		if (!len)
+			break;
+
+		record(stub, conn->buf, len);
+
+		conn->len -= len;
+		memmove(conn->buf, conn->buf + len, conn->len);
+		conn->rule = rule;
+
+		return 1;
+	}
+
+	/* a full buffer won't receive the rest of the request */
+	if (rule->response && conn->len < STUB_REQUEST_SIZE)
+		return 0;
+
+	return -1;
+}
+
+/*
+ * Send the response of the client as far as the socket, the latency and the
+ * bandwidth allow it. Returns 1 once the response has been sent.
+ */
+static int respond(rk_service_stub_t *stub, rk_stub_conn_t *conn,
+		unsigned long long now)
+{
+	const char *data = conn->rule->response;
+	size_t len = conn->rule->response_len ?
+		conn->rule->response_len : strlen(data);
+	size_t slice;
+	ssize_t ret;
+
+	while (conn->sent < len) {
+		if (!conn->quota) {
+			if (now < conn->due_ns)
+				return 0;
+
+			slice = len - conn->sent;
+			if (stub->bandwidth) {
+				slice = stub->bandwidth /
+					(1000000000ULL / STUB_SLICE_NS);
+				if (!slice)
+					slice = 1;
+				if (slice > len - conn->sent)
+					slice = len - conn->sent;
+			}
+
+			conn->quota = slice;
+
+			/* the next slice waits for this one to be sent */
+			if (stub->bandwidth) {
+				conn->due_ns = now + slice * 1000000000ULL /
+					stub->bandwidth;
+			}
+		}
+
+		ret = send(conn->fd, data + conn->sent, conn->quota,
+			MSG_NOSIGNAL | MSG_DONTWAIT);
+		if (ret == -1) {
+			if (errno == EINTR)
+				continue;
+
+			if (errno == EAGAIN) {
+				conn->blocked = true;
+				return 0;
+			}
+
+			return -1;
+		}
+
+		conn->sent += (size_t)ret;
+		conn->quota -= (size_t)ret;
+	}
+
+	conn->rule = NULL;
+	conn->sent = 0;
+
+	return 1;
+}
+
+/* Answer the complete requests of the client, -1 if it has to be closed */
+static int progress(rk_service_stub_t *stub, rk_stub_conn_t *conn,
+		unsigned long long now)
+{
+	int ret;
+
+	while (1) {
+		if (!conn->rule) {
+			ret = match(stub, conn);
+			if (ret <= 0)
+				return ret;
+
+			if (conn->due_ns < now)
+				conn->due_ns = now;
+
+			conn->due_ns += stub->latency_us * 1000ULL;
+		}
+
+		if (conn->blocked)
+			return 0;
+
+		ret = respond(stub, conn, now);
+		if (ret <= 0)
+			return ret;
+	}
+}
+
+static int receive(rk_stub_conn_t *conn)
+{
+	ssize_t len;
+
+	do {
+		len = recv(conn->fd, conn->buf + conn->len,
+			STUB_REQUEST_SIZE - conn->len, MSG_DONTWAIT);
+	} while (len == -1 && errno == EINTR);
+
+	if (len == -1 && (errno == EAGAIN))
+		return 0;
+
+	/* client went away */
+	if (len <= 0)
+		return -1;
+
+	conn->len += (size_t)len;
+
+	return 0;
+}
+
+static void release(rk_stub_conn_t *conn)
+{
+	close(conn->fd);
+	free(conn->buf);
+}
+
+static void *serve(void *arg)
+{
+	rk_service_stub_t *stub = arg;
+	struct pollfd fds[STUB_CLIENTS + 2];
+	rk_stub_conn_t conns[STUB_CLIENTS];
+	unsigned long long now, next;
+	struct timespec timeout;
+	nfds_t nfds = 2;
+	size_t count = 0;
+	int fd;
+
+	fds[0].fd = stub->wake[0];
+	fds[0].events = POLLIN;
+	fds[1].fd = stub->listen_fd;
+	fds[1].events = POLLIN;
+
+	while (1) {
+		now = rk_now_ns_();
+		next = 0;
+
+		for (size_t i = 0; i < count; i++) {
+			rk_stub_conn_t *conn = conns + i;
+
+			/* client went away or it sent an unknown request */
+			if (progress(stub, conn, now)) {
+				release(conn);
+				conns[i] = conns[--count];
+				i--;
+				continue;
+			}
+
+			fds[i + 2].fd = conn->fd;
+			fds[i + 2].events = 0;
+			fds[i + 2].revents = 0;
+
+			if (conn->len < STUB_REQUEST_SIZE)
+				fds[i + 2].events |= POLLIN;
+
+			if (conn->blocked)
+				fds[i + 2].events |= POLLOUT;
+			else if (conn->rule && (!next || conn->due_ns < next))
+				next = conn->due_ns;
+		}
+
+		nfds = count + 2;
+
+		/* ppoll() is not moved forward by the virtual clock */
+		if (next) {
+			next = next > now ? next - now : 0;
+			timeout.tv_sec = (time_t)(next / 1000000000ULL);
+			timeout.tv_nsec = (long)(next % 1000000000ULL);
+		}
+
+		if (ppoll(fds, nfds, next ? &timeout : NULL, NULL) == -1) {
+			if (errno == EINTR)
+				continue;
+
+			break;
+		}
+
+		/* rk_service_stub_stop() has been called */
+		if (fds[0].revents)
+			break;
+
+		for (size_t i = 0; i < count; i++) {
+			rk_stub_conn_t *conn = conns + i;
+
+			if (fds[i + 2].revents & POLLOUT)
+				conn->blocked = false;
+
+			if (!(fds[i + 2].revents & ~POLLOUT))
+				continue;
+
+			if (receive(conn)) {
+				release(conn);
+				conns[i] = conns[--count];
+				fds[i + 2] = fds[count + 2];
+				i--;
+			}
+		}
+
+		if (fds[1].revents & POLLIN) {
+			fd = accept4(stub->listen_fd, NULL, NULL,
+				SOCK_CLOEXEC | SOCK_NONBLOCK);
+			if (fd == -1)
+				continue;
+
+			if (count == STUB_CLIENTS) {
+				close(fd);
+				continue;
+			}
+
+			memset(conns + count, 0, sizeof(rk_stub_conn_t));
+			conns[count].fd = fd;
+			conns[count].buf = malloc(STUB_REQUEST_SIZE);
+
+			if (!conns[count].buf) {
+				close(fd);
+				continue;
+			}
+
+			count++;
+		}
+	}
+
+	for (size_t i = 0; i < count; i++)
+		release(conns + i);
+
+	return NULL;
+}
+
+static int listen_unix(rk_service_stub_t *stub)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+
+	strcpy(stub->tmpdir, "/tmp/riker-stub-XXXXXX");
+	if (!mkdtemp(stub->tmpdir))
+		return -1;
+
+	snprintf(stub->address, sizeof(stub->address), "%s/stub.sock",
+		stub->tmpdir);
+	strcpy(addr.sun_path, stub->address);
+
+	stub->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (stub->listen_fd == -1)
+		return -1;
+
+	if (bind(stub->listen_fd, (struct sockaddr *)&addr, sizeof(addr)))
+		return -1;
+
+	return listen(stub->listen_fd, SOMAXCONN);
+}
+
+static int listen_inet(rk_service_stub_t *stub)
+{
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+	};
+	socklen_t addr_len = sizeof(addr);
+
+	stub->listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (stub->listen_fd == -1)
+		return -1;
+
+	/* port 0 lets the kernel pick a free port */
+	if (bind(stub->listen_fd, (struct sockaddr *)&addr, sizeof(addr)))
+		return -1;
+
+	if (getsockname(stub->listen_fd, (struct sockaddr *)&addr, &addr_len))
+		return -1;
+
+	stub->port = ntohs(addr.sin_port);
+	snprintf(stub->address, sizeof(stub->address), "127.0.0.1:%d",
+		stub->port);
+
+	return listen(stub->listen_fd, SOMAXCONN);
+}
+
+static void cleanup(rk_service_stub_t *stub)
+{
+	if (stub->listen_fd != -1)
+		close(stub->listen_fd);
+
+	if (stub->wake[0] != -1) {
+		close(stub->wake[0]);
+		close(stub->wake[1]);
+	}
+
+	if (stub->domain == AF_UNIX && stub->tmpdir[0]) {
+		unlink(stub->address);
+		rmdir(stub->tmpdir);
+	}
+
+	pthread_mutex_destroy(&stub->lock);
+	free(stub->traffic);
+	free(stub);
+}
+
+rk_service_stub_t *rk_service_stub_start(int domain,
+		const rk_stub_rule_t *rules, unsigned long latency_us,
+		unsigned long bandwidth)
+{
+	rk_service_stub_t *stub;
+	int ret;
+
+	assert(rules);
+
+	if (domain != AF_UNIX && domain != AF_INET) {
+		errno = EAFNOSUPPORT;
+		return NULL;
+	}
+
+	stub = calloc(1, sizeof(rk_service_stub_t));
+	if (!stub)
+		return NULL;
+
+	stub->rules = rules;
+	stub->latency_us = latency_us;
+	stub->bandwidth = bandwidth;
+	stub->domain = domain;
+	stub->listen_fd = -1;
+	stub->wake[0] = -1;
+	stub->wake[1] = -1;
+
+	pthread_mutex_init(&stub->lock, NULL);
+
+	if (pipe2(stub->wake, O_CLOEXEC))
+		goto error;
+
+	if (domain == AF_UNIX)
+		ret = listen_unix(stub);
+	else
+		ret = listen_inet(stub);
+
+	if (ret)
+		goto error;
+
+	ret = pthread_create(&stub->thread, NULL, serve, stub);
+	if (ret) {
+		errno = ret;
+		goto error;
+	}
+
+	return stub;
+
+error:
+	ret = errno;
+	cleanup(stub);
+	errno = ret;
+
+	return NULL;
+}
+
+const char *__attribute__((pure)) rk_service_stub_address(
+		rk_service_stub_t *stub)
+{
+	assert(stub);
+
+	return stub->address;
+}
+
+int rk_service_stub_connect(rk_service_stub_t *stub)
+{
+	struct sockaddr_un addr_un = { .sun_family = AF_UNIX };
+	struct sockaddr_in addr_in = {
+		.sin_family = AF_INET,
+		.sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+	};
+	struct sockaddr *addr;
+	socklen_t addr_len;
+	int fd;
+
+	assert(stub);
+
+	if (stub->domain == AF_UNIX) {
+		strcpy(addr_un.sun_path, stub->address);
+		addr = (struct sockaddr *)&addr_un;
+		addr_len = sizeof(addr_un);
+	} else {
+		addr_in.sin_port = htons((uint16_t)stub->port);
+		addr = (struct sockaddr *)&addr_in;
+		addr_len = sizeof(addr_in);
+	}
+
+	fd = socket(stub->domain, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd == -1)
+		return -1;
+
+	if (connect(fd, addr, addr_len)) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+size_t rk_service_stub_traffic(rk_service_stub_t *stub, char *buf,
+		size_t size, size_t *requests)
+{
+	size_t len;
+
+	assert(stub);
+
+	pthread_mutex_lock(&stub->lock);
+
+	len = stub->traffic_len;
+	if (buf && size)
+		memcpy(buf, stub->traffic, len < size ? len : size);
+
+	if (requests)
+		*requests = stub->requests;
+
+	pthread_mutex_unlock(&stub->lock);
+
+	return len;
+}
+
+void rk_service_stub_stop(rk_service_stub_t *stub)
+{
+	if (!stub)
+		return;
+
+	if (write(stub->wake[1], "", 1) == 1)
+		pthread_join(stub->thread, NULL);
+
+	cleanup(stub);
+}
@@ -0,0 +1,433 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) 2025 Andrea Cervesato <andrea.cervesato@mailbox.org>
+ */
+
+#define _GNU_SOURCE
+
+#include "riker_internal.h"
+#include <setjmp.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+/* Maximum number of threads running the sweep */
+#define SWEEP_MAX_THREADS 16
+
+/* Failures kept by each thread to be reported */
+#define SWEEP_MAX_FAILURES 4096
+
+/* Lines of the failures report, one for each pair of alignments */
+#define SWEEP_REPORT_LINES 16
+
+/* Size of a line of the failures report */
+#define SWEEP_LINE_SIZE 256
+
+/* Room left in a line for one more range of lengths */
+#define SWEEP_RANGE_SIZE 48
+
+typedef enum
+{
+	SWEEP_MISMATCH = 0,
+	SWEEP_FAULT,
+} rk_sweep_kind_t;
+
+typedef struct
+{
+	size_t src_align;
+	size_t dst_align;
+	size_t len;
+	rk_sweep_kind_t kind;
+	char padding[4];
+} rk_sweep_failure_t;
+
+typedef struct rk_sweep rk_sweep_t;
+
+/*
+ * Buffers of a thread. Each one is followed by a guard page, so the bytes
+ * after the end of the data can't be accessed.
+ */
+typedef struct
+{
+	rk_sweep_t *sweep;
+	char *src;
+	char *dst;
+	char *ref;
+	rk_sweep_failure_t *failures;
+	size_t nfailures;
+	size_t count;
+	pthread_t thread;
+	bool started;
+	char padding[7];
+} rk_sweep_worker_t;
+
+struct rk_sweep
+{
+	rk_sweep_func fn;
+	rk_sweep_func ref_fn;
+	rk_sweep_worker_t *workers;
+	char *pattern;
+	size_t max_len;
+	size_t align_range;
+	size_t data_size;
+	size_t map_size;
+	size_t next_pair;
+	size_t npairs;
+};
+
+static __thread sigjmp_buf fault_jmp;
+static __thread volatile sig_atomic_t fault_active;
+
+static void on_fault(int sig)
+{
+	if (fault_active)
+		siglongjmp(fault_jmp, 1);
+
+	/* fault happened outside the function under test */
+	signal(sig, SIG_DFL);
+	raise(sig);
+}
+
+static char *map_buffer(const rk_sweep_t *sweep)
+{
+	char *ptr;
+
+	ptr = mmap(NULL, sweep->map_size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	if (ptr == MAP_FAILED)
+		return NULL;
+
+	if (mprotect(ptr + sweep->data_size, sweep->map_size - sweep->data_size,
+			PROT_NONE)) {
+		munmap(ptr, sweep->map_size);
+		return NULL;
+	}
+
+	return ptr;
+}
+
+/*
+ * Place data of the given length as close as possible to the guard page,
+ * starting at the given alignment. For each length there's one alignment
+ * where the data ends exactly where the guard page starts.
+ */
+static char *place(const rk_sweep_t *sweep, char *buf, size_t align,
+		size_t len)
+{
+	uintptr_t start = (uintptr_t)(buf + sweep->data_size - len);
+	size_t range = sweep->align_range;
+
+	start -= (start % range + range - align) % range;
+
+	return (char *)start;
+}
+
+static void add_failure(rk_sweep_worker_t *worker, size_t src_align,
+		size_t dst_align, size_t len, rk_sweep_kind_t kind)
+{
+	rk_sweep_failure_t *failure;
+
+	worker->count++;
+
+	if (!worker->failures || worker->nfailures == SWEEP_MAX_FAILURES)
+		return;
+
+	failure = worker->failures + worker->nfailures++;
+	failure->src_align = src_align;
+	failure->dst_align = dst_align;
+	failure->len = len;
+	failure->kind = kind;
+}
+
+/*
+ * Run the function under test, returning -1 if it accessed memory outside
+ * of the buffers.
+ */
+static int call_fn(const rk_sweep_t *sweep, char *dst, const char *src,
+		size_t len)
+{
+	fault_active = 1;
+
+	if (sigsetjmp(fault_jmp, 1)) {
+		fault_active = 0;
+		return -1;
+	}
+
+	sweep->fn(dst, src, len);
+
+	fault_active = 0;
+
+	return 0;
+}
+
+static void sweep_pair(rk_sweep_t *sweep, rk_sweep_worker_t *worker,
+		size_t src_align, size_t dst_align)
+{
+	size_t range = sweep->align_range;
+	char *src, *dst, *ref, *window;
+	size_t offset, size;
+
+	for (size_t len = 0; len <= sweep->max_len; len++) {
+		src = place(sweep, worker->src, src_align, len);
+		dst = place(sweep, worker->dst, dst_align, len);
+		ref = worker->ref + (dst - worker->dst);
+
+		/* bytes around the destination must be left untouched */
+		window = dst - range;
+		offset = (size_t)(window - worker->dst);
+		size = sweep->data_size - offset;
+
+		memcpy(window, sweep->pattern + offset, size);
+		memcpy(worker->ref + offset, sweep->pattern + offset, size);
+
+		sweep->ref_fn(ref, src, len);
+
+		if (call_fn(sweep, dst, src, len)) {
+			add_failure(worker, src_align, dst_align, len,
+				SWEEP_FAULT);
+			continue;
+		}
+
+		if (memcmp(window, worker->ref + offset, size)) {
+			add_failure(worker, src_align, dst_align, len,
+				SWEEP_MISMATCH);
+		}
+	}
+}
+
+static void *sweep_loop(void *arg)
+{
+	rk_sweep_worker_t *worker = arg;
+	rk_sweep_t *sweep = worker->sweep;
+	size_t pair;
+
+	/* each pair of alignments is a chunk, taken by the first free thread */
+	for (;;) {
+		pair = __atomic_fetch_add(&sweep->next_pair, 1,
+			__ATOMIC_RELAXED);
+		if (pair >= sweep->npairs)
+			break;
+
+		sweep_pair(sweep, worker, pair / sweep->align_range,
+			pair % sweep->align_range);
+	}
+
+	return NULL;
+}
+
+static int compare_failures(const void *a, const void *b)
+{
+	const rk_sweep_failure_t *x = a;
+	const rk_sweep_failure_t *y = b;
+
+	if (x->kind != y->kind)
+		return x->kind < y->kind ? -1 : 1;
+
+	if (x->src_align != y->src_align)
+		return x->src_align < y->src_align ? -1 : 1;
+
+	if (x->dst_align != y->dst_align)
+		return x->dst_align < y->dst_align ? -1 : 1;
+
+	return (x->len > y->len) - (x->len < y->len);
+}
+
+/*
+ * Print failures as one line for each pair of alignments, with the failing
+ * lengths written as ranges, such as "len 3-7,9".
+ */
+static void report(const char *file, const int lineno,
+		rk_sweep_failure_t *failures, size_t count, size_t total)
+{
+	char line[SWEEP_LINE_SIZE];
+	size_t lines = 0, len, pos;
+	rk_sweep_failure_t *first;
+	size_t i = 0, end;
+
+	qsort(failures, count, sizeof(rk_sweep_failure_t), compare_failures);
+
+	while (i < count && lines < SWEEP_REPORT_LINES) {
+		first = failures + i;
+		pos = (size_t)snprintf(line, sizeof(line), "%s src+%zu dst+%zu: "
+			"len ", first->kind == SWEEP_FAULT ? "fault" : "mismatch",
+			first->src_align, first->dst_align);
+
+		while (i < count && failures[i].kind == first->kind &&
+			failures[i].src_align == first->src_align &&
+			failures[i].dst_align == first->dst_align) {
+			len = failures[i].len;
+
+			for (end = i; end + 1 < count &&
+				failures[end + 1].kind == first->kind &&
+				failures[end + 1].src_align == first->src_align &&
+				failures[end + 1].dst_align == first->dst_align &&
+				failures[end + 1].len == failures[end].len + 1;)
+				end++;
+
+			/* lengths which don't fit are left out of the line */
+			if (pos + SWEEP_RANGE_SIZE < sizeof(line)) {
+				pos += (size_t)snprintf(line + pos,
+					sizeof(line) - pos, "%s%zu",
+					first == failures + i ? "" : ",", len);
+
+				if (end > i) {
+					pos += (size_t)snprintf(line + pos,
+						sizeof(line) - pos, "-%zu",
+						failures[end].len);
+				}
+			}
+
+			i = end + 1;
+		}
+
+		rk_result_(file, lineno, TINFO, "%s", line);
+		lines++;
+	}
+
+	if (total > i)
+		rk_result_(file, lineno, TINFO, "... and %zu more", total - i);
+}
+
+long rk_sweep_buffers_(const char *file, const int lineno, rk_sweep_func fn,
+		rk_sweep_func ref_fn, size_t max_len, size_t align_range)
+{
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	struct sigaction sa, old_segv, old_bus;
+	rk_sweep_failure_t *all = NULL;
+	size_t nworkers, count = 0;
+	long cpus, total = -1;
+	rk_sweep_t sweep;
+	int ret;
+
+	assert(fn);
+	assert(ref_fn);
+
+	if (!align_range || align_range > page) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	memset(&sweep, 0, sizeof(rk_sweep_t));
+
+	sweep.fn = fn;
+	sweep.ref_fn = ref_fn;
+	sweep.max_len = max_len;
+	sweep.align_range = align_range;
+	sweep.npairs = align_range * align_range;
+	sweep.data_size = (max_len + 2 * align_range + page - 1) / page * page;
+	sweep.map_size = sweep.data_size + page;
+
+	cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	nworkers = cpus > 0 ? (size_t)cpus : 1;
+
+	if (nworkers > SWEEP_MAX_THREADS)
+		nworkers = SWEEP_MAX_THREADS;
+
+	if (nworkers > sweep.npairs)
+		nworkers = sweep.npairs;
+
+	sweep.workers = calloc(nworkers, sizeof(rk_sweep_worker_t));
+	sweep.pattern = malloc(sweep.data_size);
+
+	if (!sweep.workers || !sweep.pattern)
+		goto exit;
+
+	/* a pattern changing at every byte shows writes in the wrong place */
+	for (size_t i = 0; i < sweep.data_size; i++)
+		sweep.pattern[i] = (char)(i * 7 + 0x5a);
+
+	for (size_t i = 0; i < nworkers; i++) {
+		rk_sweep_worker_t *worker = sweep.workers + i;
+
+		worker->sweep = &sweep;
+		worker->src = map_buffer(&sweep);
+		worker->dst = map_buffer(&sweep);
+		worker->ref = map_buffer(&sweep);
+		worker->failures = calloc(SWEEP_MAX_FAILURES,
+			sizeof(rk_sweep_failure_t));
+
+		if (!worker->src || !worker->dst || !worker->ref ||
+			!worker->failures)
+			goto exit;
+
+		/* source data is read only, as it should be for the function */
+		memcpy(worker->src, sweep.pattern, sweep.data_size);
+		for (size_t j = 0; j < sweep.data_size; j++)
+			worker->src[j] = (char)(worker->src[j] ^ (char)j);
+
+		if (mprotect(worker->src, sweep.data_size, PROT_READ))
+			goto exit;
+	}
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = on_fault;
+	sa.sa_flags = SA_NODEFER;
+	sigemptyset(&sa.sa_mask);
+
+	sigaction(SIGSEGV, &sa, &old_segv);
+	sigaction(SIGBUS, &sa, &old_bus);
+
+	/* pairs of threads which didn't start are taken by the others */
+	for (size_t i = 1; i < nworkers; i++) {
+		ret = pthread_create(&sweep.workers[i].thread, NULL, sweep_loop,
+			sweep.workers + i);
+		sweep.workers[i].started = !ret;
+	}
+
+	sweep_loop(sweep.workers);
+
+	for (size_t i = 1; i < nworkers; i++) {
+		if (sweep.workers[i].started)
+			pthread_join(sweep.workers[i].thread, NULL);
+	}
+
+	sigaction(SIGSEGV, &old_segv, NULL);
+	sigaction(SIGBUS, &old_bus, NULL);
+
+	total = 0;
+
+	for (size_t i = 0; i < nworkers; i++) {
+		total += (long)sweep.workers[i].count;
+		count += sweep.workers[i].nfailures;
+	}
+
+	if (total) {
+		all = malloc(count * sizeof(rk_sweep_failure_t));
+		count = 0;
+
+		for (size_t i = 0; all && i < nworkers; i++) {
+			memcpy(all + count, sweep.workers[i].failures,
+				sweep.workers[i].nfailures *
+				sizeof(rk_sweep_failure_t));
+			count += sweep.workers[i].nfailures;
+		}
+
+		if (all)
+			report(file, lineno, all, count, (size_t)total);
+	}
+
+exit:
+	for (size_t i = 0; sweep.workers && i < nworkers; i++) {
+		rk_sweep_worker_t *worker = sweep.workers + i;
+
+		if (worker->src)
+			munmap(worker->src, sweep.map_size);
+		if (worker->dst)
+			munmap(worker->dst, sweep.map_size);
+		if (worker->ref)
+			munmap(worker->ref, sweep.map_size);
+
+		free(worker->failures);
+	}
+
+	free(all);
+	free(sweep.workers);
+	free(sweep.pattern);
+
+	return total;
+}
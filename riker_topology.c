@@ -0,0 +1,217 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) 2025 Andrea Cervesato <andrea.cervesato@mailbox.org>
+ */
+
+#define _GNU_SOURCE
+
+#include "riker_internal.h"
+#include <sched.h>
+#include <stdlib.h>
+
+#define SYSFS_CPU "/sys/devices/system/cpu"
+
+/* Cache indexes inspected when looking for the last level cache */
+#define TOPOLOGY_CACHES 8
+
+static int read_int(const char *path, int *value)
+{
+	FILE *file;
+	int ret;
+
+	file = fopen(path, "re");
+	if (!file)
+		return -1;
+
+	/* shared_cpu_list starts with the first CPU of the list */
+	ret = fscanf(file, "%d", value);
+	fclose(file);
+
+	return ret == 1 ? 0 : -1;
+}
+
+static int read_cpu_int(int cpu, const char *file, int *value)
+{
+	char path[128];
+
+	snprintf(path, sizeof(path), SYSFS_CPU "/cpu%d/%s", cpu, file);
+
+	return read_int(path, value);
+}
+
+/*
+ * Tests sharing the last level cache disturb each other, so CPUs are grouped
+ * by the first CPU sharing the highest level cache.
+ */
+static int last_level_cache(int cpu)
+{
+	int level, best = 0, llc = cpu, first;
+	char file[64];
+
+	for (int i = 0; i < TOPOLOGY_CACHES; i++) {
+		snprintf(file, sizeof(file), "cache/index%d/level", i);
+		if (read_cpu_int(cpu, file, &level))
+			break;
+
+		snprintf(file, sizeof(file), "cache/index%d/shared_cpu_list", i);
+		if (level > best && !read_cpu_int(cpu, file, &first)) {
+			best = level;
+			llc = first;
+		}
+	}
+
+	return llc;
+}
+
+static void count_domains(rk_topology_t *topo)
+{
+	for (size_t i = 0; i < topo->count; i++) {
+		bool package = true, llc = true;
+
+		for (size_t j = 0; j < i; j++) {
+			if (topo->cpus[j].package == topo->cpus[i].package)
+				package = false;
+
+			if (topo->cpus[j].llc == topo->cpus[i].llc)
+				llc = false;
+		}
+
+		topo->packages += package;
+		topo->llcs += llc;
+	}
+}
+
+int rk_topology_read_(rk_topology_t *topo)
+{
+	int package, core_id;
+	cpu_set_t set;
+	rk_cpu_t *cpu;
+
+	assert(topo);
+
+	memset(topo, 0, sizeof(rk_topology_t));
+
+	/* only CPUs where the process is allowed to run can be used */
+	if (sched_getaffinity(0, sizeof(set), &set))
+		return -1;
+
+	topo->cpus = calloc((size_t)CPU_COUNT(&set), sizeof(rk_cpu_t));
+	if (!topo->cpus)
+		return -1;
+
+	for (int i = 0; i < CPU_SETSIZE; i++) {
+		if (!CPU_ISSET((size_t)i, &set))
+			continue;
+
+		cpu = topo->cpus + topo->count++;
+		cpu->cpu = i;
+
+		/* without sysfs every CPU is a core of its own */
+		if (read_cpu_int(i, "topology/physical_package_id", &package))
+			package = 0;
+
+		if (read_cpu_int(i, "topology/core_id", &core_id))
+			core_id = i;
+
+		cpu->package = package;
+		cpu->llc = last_level_cache(i);
+		cpu->core = -1;
+
+		/* core IDs are only unique inside the same package */
+		for (size_t j = 0; j < topo->count - 1; j++) {
+			if (topo->cpus[j].package == package &&
+				topo->cpus[j].core_id == core_id) {
+				cpu->core = topo->cpus[j].core;
+				break;
+			}
+		}
+
+		cpu->core_id = core_id;
+
+		if (cpu->core == -1)
+			cpu->core = (int)topo->cores++;
+	}
+
+	count_domains(topo);
+
+	return 0;
+}
+
+void rk_topology_free_(rk_topology_t *topo)
+{
+	free(topo->cpus);
+	memset(topo, 0, sizeof(rk_topology_t));
+}
+
+/*
+ * Print the CPUs of a cache domain as a list of ranges, such as 0-3,8-11.
+ */
+static void print_cpus(const rk_topology_t *topo, int llc)
+{
+	int start = -1, last = -1;
+	const char *sep = "";
+
+	for (size_t i = 0; i <= topo->count; i++) {
+		int cpu = -1;
+
+		if (i < topo->count && topo->cpus[i].llc == llc)
+			cpu = topo->cpus[i].cpu;
+
+		if (cpu != -1 && cpu == last + 1 && start != -1) {
+			last = cpu;
+			continue;
+		}
+
+		if (start != -1) {
+			if (start == last)
+				rk_out_printf_("%s%d", sep, start);
+			else
+				rk_out_printf_("%s%d-%d", sep, start, last);
+
+			sep = ",";
+		}
+
+		start = cpu;
+		last = cpu;
+	}
+}
+
+void rk_topology_report_(const rk_topology_t *topo)
+{
+	assert(topo);
+
+	rk_out_printf_("Topology: %u packages, %u cores, %zu CPUs, %u cache "
+		"domains\n", topo->packages, topo->cores, topo->count,
+		topo->llcs);
+
+	for (size_t i = 0; i < topo->count; i++) {
+		const rk_cpu_t *cpu = topo->cpus + i;
+		unsigned int cores = 0;
+		bool first = true;
+
+		for (size_t j = 0; j < i && first; j++)
+			first = topo->cpus[j].llc != cpu->llc;
+
+		if (!first)
+			continue;
+
+		for (size_t j = 0; j < topo->count; j++) {
+			bool counted = false;
+
+			if (topo->cpus[j].llc != cpu->llc)
+				continue;
+
+			for (size_t k = 0; k < j && !counted; k++) {
+				counted = topo->cpus[k].llc == cpu->llc &&
+					topo->cpus[k].core == topo->cpus[j].core;
+			}
+
+			cores += !counted;
+		}
+
+		rk_out_printf_("  cache domain %d: package %d, %u cores, CPUs ",
+			cpu->llc, cpu->package, cores);
+		print_cpus(topo, cpu->llc);
+		rk_out_printf_("\n");
+	}
+}
@@ -3,12 +3,25 @@
  * Copyright (c) 2025 Andrea Cervesato <andrea.cervesato@mailbox.org>
  */
 
+#define _GNU_SOURCE
 #define TEST_CUSTOM_MAIN 1
 
 #include "riker.h"
 #include <stdlib.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <unistd.h>
+#include <poll.h>
+#include <time.h>
+#include <errno.h>
+#include <sched.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
 #include <sys/wait.h>
+#include <sys/resource.h>
 
 static void setup_error(void)
 {
@@ -32,9 +45,13 @@ static void teardown_test(void)
 	rk_result(TINFO, "Teardown test");
 }
 
+static int select_sum(rk_isa_t isa, void *data);
+static rk_isa_t query_sum(void *data);
+
 static void setup_suite(void)
 {
 	rk_result(TINFO, "Setup suite");
+	rk_check_eq(rk_isa_register("sum", select_sum, query_sum, NULL), 0);
 }
 
 static void teardown_suite(void)
@@ -254,68 +271,1702 @@ static void test_rk_check_assignment(void)
 	rk_check_eq(RK_TST_RES, TFAIL);
 }
 
-static rk_suite_t test_suite = {
-	.tests = (rk_test_t []) {
-		{
-			.setup = setup_test,
-			.run = test_pass,
-			.teardown = teardown_test
-		},
-		{
-			.setup = setup_error,
-			.run = test_pass,
-			.teardown = teardown_test,
-		},
-		{
-			.setup = setup_test,
-			.run = test_error,
-			.teardown = teardown_test,
-		},
-		{
-			.setup = setup_test,
-			.run = test_pass,
-			.teardown = teardown_error,
-		},
-		{ .run = test_pass },
-		{ .run = test_fail },
-		{ .run = test_skip },
-		{ .run = test_rk_check_expr },
-		{ .run = test_rk_check_eq },
-		{ .run = test_rk_check_ne },
-		{ .run = test_rk_check_gt },
-		{ .run = test_rk_check_ge },
-		{ .run = test_rk_check_lt },
-		{ .run = test_rk_check_le },
-		{ .run = test_rk_check_ptr_null },
-		{ .run = test_rk_check_ptr_not_null },
-		{ .run = test_rk_check_mem_eq },
-		{ .run = test_rk_check_mem_ne },
-		{ .run = test_rk_check_str_eq },
-		{ .run = test_rk_check_str_ne },
-		{ .run = test_rk_check_eq_ptr },
-		{ .run = test_rk_check_ptr_ne },
-		{ .run = test_rk_check_assignment },
-		{ .run = NULL },
-	},
-	.setup = setup_suite,
-	.teardown = teardown_suite,
-};
+static pthread_mutex_t contended_lock = PTHREAD_MUTEX_INITIALIZER;
 
-int main(void)
+static void *contend_lock(void *arg)
 {
-	pid_t pid;
-	int status;
+	for (int i = 0; i < 10000; i++) {
+		pthread_mutex_lock(&contended_lock);
+		(*(volatile int *)arg)++;
+		pthread_mutex_unlock(&contended_lock);
+	}
 
-	pid = fork();
-	assert(pid != -1);
+	return NULL;
+}
 
-	if (!pid) {
-		rk_run_suite(&test_suite);
-		exit(0);
+#ifdef RK_LOCK_CONTENTION
+static pthread_cond_t contended_cond = PTHREAD_COND_INITIALIZER;
+static int contended_ready;
+
+static void *signal_cond(void *arg)
+{
+	(void)arg;
+
+	usleep(50000);
+
+	pthread_mutex_lock(&contended_lock);
+	contended_ready = 1;
+	pthread_cond_signal(&contended_cond);
+	pthread_mutex_unlock(&contended_lock);
+
+	return NULL;
+}
+
+static void *take_lock(void *arg)
+{
+	(void)arg;
+
+	pthread_mutex_lock(&contended_lock);
+	pthread_mutex_unlock(&contended_lock);
+
+	return NULL;
+}
+#endif
+
+static void test_rk_check_contention_le(void)
+{
+	pthread_t threads[4];
+	int counter = 0;
+
+#ifdef RK_LOCK_CONTENTION
+	/* a lock which is never contended doesn't wait */
+	for (int i = 0; i < 1000; i++) {
+		pthread_mutex_lock(&contended_lock);
+		pthread_mutex_unlock(&contended_lock);
 	}
 
-	assert(waitpid(pid, &status, 0) != -1);
-	assert(WIFEXITED(status));
+	rk_check_contention_le(0);
+	rk_check_eq(RK_TST_RES, TPASS);
+
+	/* waiting for a condition isn't waiting for the lock */
+	contended_ready = 0;
+	pthread_create(threads, NULL, signal_cond, NULL);
+
+	pthread_mutex_lock(&contended_lock);
+	while (!contended_ready)
+		pthread_cond_wait(&contended_cond, &contended_lock);
+	pthread_mutex_unlock(&contended_lock);
+
+	pthread_join(threads[0], NULL);
+
+	rk_check_contention_le(20000000);
+	rk_check_eq(RK_TST_RES, TPASS);
+
+	/* the thread waits for the lock until it's released */
+	pthread_mutex_lock(&contended_lock);
+	pthread_create(threads, NULL, take_lock, NULL);
+	usleep(100000);
+	pthread_mutex_unlock(&contended_lock);
+
+	pthread_join(threads[0], NULL);
+
+	rk_check_contention_le(40000000);
+	rk_check_eq(RK_TST_RES, TFAIL);
+#else
+	rk_check_eq(rk_contention_wait_ns(), 0ULL);
+#endif
+
+	for (int i = 0; i < 4; i++)
+		pthread_create(threads + i, NULL, contend_lock, &counter);
+
+	for (int i = 0; i < 4; i++)
+		pthread_join(threads[i], NULL);
+
+	rk_check_eq(counter, 40000);
+}
+
+static int clock_spinning;
+
+static void *spin_clock(void *arg)
+{
+	(void)arg;
+
+	while (__atomic_load_n(&clock_spinning, __ATOMIC_RELAXED))
+		;
+
+	return NULL;
+}
+
+static void *sleep_clock(void *arg)
+{
+	struct timespec start, end;
+	long long *slept = arg;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	sleep(10);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	*slept = (end.tv_sec - start.tv_sec) * 1000000000LL +
+		end.tv_nsec - start.tv_nsec;
+
+	return NULL;
+}
+
+static void test_rk_clock(void)
+{
+	struct timespec start, end;
+	struct pollfd pfd;
+	pthread_t thread;
+	long long slept;
+	int fds[2];
+
+	if (rk_clock_enable()) {
+		rk_result(TSKIP, "Virtual clock is not supported");
+		return;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	sleep(30);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	rk_check_ge(end.tv_sec - start.tv_sec, 30);
+
+	/* each sleeping thread wakes up at its own virtual time */
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	pthread_create(&thread, NULL, sleep_clock, &slept);
+	sleep(30);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	pthread_join(thread, NULL);
+
+	rk_check_ge(slept, 10000000000LL);
+	rk_check_lt(slept, 11000000000LL);
+	rk_check_ge(end.tv_sec - start.tv_sec, 30);
+	rk_check_lt(end.tv_sec - start.tv_sec, 31);
+
+	assert(pipe(fds) != -1);
+
+	pfd.fd = fds[0];
+	pfd.events = POLLIN;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	rk_check_eq(poll(&pfd, 1, 5000), 0);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	rk_check_ge(end.tv_sec - start.tv_sec, 5);
+
+	close(fds[0]);
+	close(fds[1]);
+
+	rk_clock_advance(3600000000000ULL);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	rk_check_ge(start.tv_sec - end.tv_sec, 3600);
+
+	/* a running thread keeps the time going at the real pace */
+	clock_spinning = 1;
+	pthread_create(&thread, NULL, spin_clock, NULL);
+
+	rk_clock_disable();
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	rk_clock_enable();
+	usleep(50000);
+	rk_clock_disable();
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	rk_check_ge((end.tv_sec - start.tv_sec) * 1000000000LL +
+		end.tv_nsec - start.tv_nsec, 50000000LL);
+
+	/* unless a grace period lets the sleeping thread move it forward */
+	setenv("RIKER_CLOCK_GRACE_MS", "1", 1);
+	rk_clock_enable();
+	unsetenv("RIKER_CLOCK_GRACE_MS");
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	sleep(30);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	rk_check_ge(end.tv_sec - start.tv_sec, 30);
+
+	rk_clock_disable();
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	rk_check_lt(end.tv_sec - start.tv_sec, 10);
+
+	__atomic_store_n(&clock_spinning, 0, __ATOMIC_RELAXED);
+	pthread_join(thread, NULL);
+}
+
+static void async_write(rk_async_t *ctx, int fd, unsigned int events,
+		void *data)
+{
+	rk_check_eq(events & EPOLLOUT, EPOLLOUT);
+	rk_check_eq(write(fd, data, 4), 4);
+
+	rk_async_unwatch(ctx, fd);
+}
+
+static void test_rk_async(rk_async_t *ctx)
+{
+	static char msg[] = "ciao";
+	char buf[4] = {0};
+	int fds[2];
+
+	assert(pipe(fds) != -1);
+
+	rk_check_eq(rk_async_watch(ctx, fds[1], EPOLLOUT, async_write, msg), 0);
+	rk_check_eq(rk_async_wait(ctx, fds[0], EPOLLIN), EPOLLIN);
+	rk_check_eq(read(fds[0], buf, 4), 4);
+	rk_check_str_eq(buf, "ciao", 4);
+
+	close(fds[0]);
+	close(fds[1]);
+}
+
+static void test_rk_async_timeout(rk_async_t *ctx)
+{
+	int fds[2];
+
+	assert(pipe(fds) != -1);
+
+	rk_check_eq(rk_async_wait(ctx, fds[0], EPOLLIN), -1);
+	rk_check_eq(errno, ETIMEDOUT);
+
+	close(fds[0]);
+	close(fds[1]);
+}
+
+static int overflow_stack(int depth)
+{
+	volatile char frame[4096];
+
+	frame[0] = (char)depth;
+
+	return depth ? overflow_stack(depth - 1) + frame[0] : 0;
+}
+
+static void test_rk_async_overflow(rk_async_t *ctx)
+{
+	(void)ctx;
+
+	/* four times the stack of an asynchronous test */
+	rk_check_eq(overflow_stack(256), 0);
+}
+
+static void test_rk_service_stub(void)
+{
+	static rk_stub_rule_t rules[] = {
+		{ .request = "PING", .response = "PONG" },
+		{ .request = "GET", .response = "VALUE" },
+		{ NULL },
+	};
+	int domains[] = { AF_UNIX, AF_INET };
+	struct timespec start, end;
+	rk_service_stub_t *stub;
+	size_t requests;
+	char buf[16];
+	int fd, fd2;
+
+	for (int i = 0; i < 2; i++) {
+		stub = rk_service_stub_start(domains[i], rules, 1000, 0);
+		rk_check_ptr_not_null(stub);
+		if (!stub)
+			return;
+
+		rk_result(TINFO, "Stub listening on %s",
+			rk_service_stub_address(stub));
+
+		fd = rk_service_stub_connect(stub);
+		rk_check_ge(fd, 0);
+
+		memset(buf, 0, sizeof(buf));
+		rk_check_eq(write(fd, "PING\n", 5), 5);
+		rk_check_eq(read(fd, buf, sizeof(buf)), 4);
+		rk_check_str_eq(buf, "PONG", 4);
+
+		/* a request is answered once it's complete */
+		memset(buf, 0, sizeof(buf));
+		rk_check_eq(write(fd, "GET k", 5), 5);
+		usleep(10000);
+		rk_check_eq(write(fd, "ey\n", 3), 3);
+		rk_check_eq(read(fd, buf, sizeof(buf)), 5);
+		rk_check_str_eq(buf, "VALUE", 5);
+
+		memset(buf, 0, sizeof(buf));
+		rk_check_eq(rk_service_stub_traffic(stub, buf, sizeof(buf),
+			&requests), 13);
+		rk_check_eq(requests, 2);
+		rk_check_str_eq(buf, "PING\nGET key\n", 13);
+
+		close(fd);
+		rk_service_stub_stop(stub);
+	}
+
+	/* a slow response doesn't delay the other clients */
+	stub = rk_service_stub_start(AF_UNIX, rules, 200000, 0);
+	rk_check_ptr_not_null(stub);
+	if (!stub)
+		return;
+
+	fd = rk_service_stub_connect(stub);
+	fd2 = rk_service_stub_connect(stub);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	rk_check_eq(write(fd, "PING\nPING\n", 10), 10);
+	rk_check_eq(write(fd2, "PING\n", 5), 5);
+
+	memset(buf, 0, sizeof(buf));
+	rk_check_eq(read(fd2, buf, sizeof(buf)), 4);
+	rk_check_str_eq(buf, "PONG", 4);
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	rk_check_lt((end.tv_sec - start.tv_sec) * 1000000000LL +
+		end.tv_nsec - start.tv_nsec, 390000000LL);
+
+	/* pipelined requests are answered in order */
+	for (int i = 0; i < 2; i++) {
+		memset(buf, 0, sizeof(buf));
+		rk_check_eq(read(fd, buf, 4), 4);
+		rk_check_str_eq(buf, "PONG", 4);
+	}
+
+	close(fd);
+	close(fd2);
+	rk_service_stub_stop(stub);
+}
+
+static void count_output(const char *buf, size_t len, int fd, void *data)
+{
+	size_t *count = data;
+
+	if (buf && fd == STDOUT_FILENO)
+		*count += len;
+}
+
+static void test_rk_run_cmd(void)
+{
+	char sh[] = "sh", opt_c[] = "-c", head[] = "head", size[] = "4000000";
+	char echo_script[] = "echo hello; echo world >&2; exit 3";
+	char kill_script[] = "kill -TERM $$";
+	char zero[] = "/dev/zero";
+	char *const echo_argv[] = { sh, opt_c, echo_script, NULL };
+	char *const kill_argv[] = { sh, opt_c, kill_script, NULL };
+	char *const head_argv[] = { head, opt_c, size, zero, NULL };
+	rk_cmd_opts_t opts = { .output = count_output };
+	rk_cmd_result_t res;
+	size_t count = 0;
+
+	rk_check_eq(rk_run_cmd(echo_argv, NULL, &res), 0);
+	rk_check_cmd_exit(&res, 3);
+	rk_check_cmd_out_eq(&res, "hello\n");
+	rk_check_cmd_out_contains(&res, "ell");
+	rk_check_cmd_out_hash(&res, rk_hash("hello\n", 6));
+	rk_check_str_eq(res.err, "world\n", 6);
+
+	rk_check_cmd_signal(&res, SIGTERM);
+	rk_check_eq(RK_TST_RES, TFAIL);
+
+	rk_cmd_release(&res);
+
+	rk_check_eq(rk_run_cmd(kill_argv, NULL, &res), 0);
+	rk_check_cmd_signal(&res, SIGTERM);
+	rk_cmd_release(&res);
+
+	opts.data = &count;
+
+	rk_check_eq(rk_run_cmd(head_argv, &opts, &res), 0);
+	rk_check_cmd_exit(&res, 0);
+	rk_check_eq(count, 4000000);
+}
+
+static void test_rk_check_contains(void)
+{
+	const char *log = "first line\nsecond ERROR line\nthird line\n";
+	size_t len = strlen(log);
+
+	rk_check_contains(log, len, "ERROR");
+	rk_check_eq(RK_TST_RES, TPASS);
+
+	rk_check_contains(log, len, "ERRNO");
+	rk_check_eq(RK_TST_RES, TFAIL);
+
+	rk_check_not_contains(log, len, "WARNING");
+	rk_check_eq(RK_TST_RES, TPASS);
+
+	rk_check_not_contains(log, len, "third");
+	rk_check_eq(RK_TST_RES, TFAIL);
+
+	rk_check_count(log, len, "line", 3);
+	rk_check_eq(RK_TST_RES, TPASS);
+
+	rk_check_count(log, len, "line", 2);
+	rk_check_eq(RK_TST_RES, TFAIL);
+}
+
+static void test_rk_check_regex(void)
+{
+	const char *log = "first line\nsecond ERROR 42 line\nthird line\n";
+	size_t len = strlen(log);
+	size_t offset;
+
+	for (int i = 0; i < 2; i++) {
+		rk_check_regex(log, len, "ERROR [0-9]+");
+		rk_check_eq(RK_TST_RES, TPASS);
+	}
+
+	rk_check_regex(log, len, "^ERROR");
+	rk_check_eq(RK_TST_RES, TFAIL);
+
+	rk_check_regex(log, len, "(");
+	rk_check_eq(RK_TST_RES, TFAIL);
+
+	/* offsets of bigger buffers don't fit inside regoff_t */
+	rk_check_eq(rk_regex_(log, (size_t)INT_MAX + 1, "ERROR", &offset), -1);
+	rk_check_eq(errno, EOVERFLOW);
+}
+
+static char *make_text(size_t lines, size_t every)
+{
+	char *text, *pos;
+
+	text = malloc(lines * 16 + 1);
+	if (!text)
+		return NULL;
+
+	pos = text;
+	for (size_t i = 0; i < lines; i++) {
+		pos += sprintf(pos, "%s = %zu\n",
+			every && !(i % every) ? "changed" : "option", i);
+	}
+
+	return text;
+}
+
+static void test_rk_check_str_diff(void)
+{
+	char *s1 = make_text(50000, 0);
+	char *s2 = make_text(50000, 0);
+	char *s3 = make_text(50000, 10);
+
+	rk_check_ptr_not_null(s1);
+	rk_check_ptr_not_null(s2);
+	rk_check_ptr_not_null(s3);
+	if (!s1 || !s2 || !s3)
+		goto exit;
+
+	rk_check_str_eq(s1, s2, strlen(s1));
+	rk_check_eq(RK_TST_RES, TPASS);
+
+	/* a single line differs in the middle of the text */
+	memcpy(strstr(s2, "option = 25000\n"), "OPTION", 6);
+
+	rk_check_str_eq(s1, s2, strlen(s1));
+	rk_check_eq(RK_TST_RES, TFAIL);
+
+	/* too many differences: only the first one is reported */
+	rk_check_str_eq(s1, s3, strlen(s1));
+	rk_check_eq(RK_TST_RES, TFAIL);
+
+exit:
+	free(s1);
+	free(s2);
+	free(s3);
+}
+
+static volatile int ct_result;
+
+static void ct_gen(void *input, size_t size, int cls)
+{
+	unsigned char *buf = input;
+
+	/* fixed class matches the secret, random class differs at once */
+	for (size_t i = 0; i < size; i++)
+		buf[i] = cls ? (unsigned char)(rand() | 1) : 0;
+}
+
+static void ct_compare_safe(const void *input, size_t size)
+{
+	const unsigned char *buf = input;
+	unsigned char diff = 0;
+
+	for (size_t i = 0; i < size; i++)
+		diff |= buf[i];
+
+	ct_result = !diff;
+}
+
+static void ct_compare_leaky(const void *input, size_t size)
+{
+	const unsigned char *buf = input;
+	size_t i;
+
+	for (i = 0; i < size && !buf[i]; i++)
+		;
+
+	ct_result = i == size;
+}
+
+static void test_rk_check_constant_time(void)
+{
+	rk_check_constant_time(ct_compare_safe, ct_gen, 512, 20000);
+	rk_check_eq(RK_TST_RES, TPASS);
+
+	rk_check_constant_time(ct_compare_leaky, ct_gen, 512, 20000);
+	rk_check_eq(RK_TST_RES, TFAIL);
+}
+
+static void jitter_work(void *data)
+{
+	(*(unsigned long *)data)++;
+}
+
+static void test_rk_check_jitter_le(void)
+{
+	unsigned long count = 0;
+	rk_jitter_opts_t opts = {
+		.interval_us = 1000,
+		.loops = 200,
+		.work = jitter_work,
+		.data = &count,
+		.cpu = -1,
+		.priority = 80,
+	};
+	rk_jitter_result_t res;
+
+	rk_check_eq(rk_jitter(&opts, &res), 0);
+	rk_check_eq(res.loops, 200UL);
+	rk_check_eq(count, 200UL);
+	rk_check_le(res.min_ns, res.avg_ns);
+	rk_check_le(res.avg_ns, res.max_ns);
+
+	rk_check_jitter_le(&res, 1000000, 1000000);
+	rk_check_eq(RK_TST_RES, TPASS);
+
+	rk_check_jitter_le(&res, 0, 0);
+	rk_check_eq(RK_TST_RES, TFAIL);
+}
+
+static void test_rk_bench_io(void)
+{
+	rk_bench_io_opts_t opts = {
+		.file_size = 8 * 1024 * 1024,
+		.block_size = 64 * 1024,
+		.runs = 3,
+	};
+	rk_bench_io_result_t res;
+
+	rk_check_eq(rk_bench_io(&opts, &res), 0);
+	rk_check_eq(res.stats.runs, 3UL);
+	rk_check_le(res.stats.min_ns, res.stats.median_ns);
+	rk_check_le(res.stats.median_ns, res.stats.max_ns);
+	rk_check_gt(res.iops, 0ULL);
+	rk_bench_io_report("sequential read", &res);
+
+	opts.write = 1;
+	opts.direct = 1;
+
+	rk_check_eq(rk_bench_io(&opts, &res), 0);
+	rk_check_eq(res.stats.runs, 3UL);
+	rk_bench_io_report("direct write", &res);
+
+	/* the last block would be unaligned */
+	opts.file_size += 512;
+
+	rk_check_eq(rk_bench_io(&opts, &res), -1);
+	rk_check_eq(errno, EINVAL);
+
+	/* every block would be unaligned */
+	opts.file_size = 1000 * 64;
+	opts.block_size = 1000;
+
+	rk_check_eq(rk_bench_io(&opts, &res), -1);
+	rk_check_eq(errno, EINVAL);
+
+	opts.block_size = 0;
+
+	rk_check_eq(rk_bench_io(&opts, &res), -1);
+	rk_check_eq(errno, EINVAL);
+}
+
+static void test_rk_check_io_le(void)
+{
+	char path[] = "/var/tmp/riker-io-XXXXXX";
+	char buf[4096];
+	int fd;
+
+	memset(buf, 'x', sizeof(buf));
+
+	fd = mkstemp(path);
+	rk_check_ne(fd, -1);
+	if (fd == -1)
+		return;
+
+	unlink(path);
+
+	for (int i = 0; i < 16; i++)
+		rk_check_eq(write(fd, buf, sizeof(buf)), 4096);
+
+	close(fd);
+
+	rk_check_io_le(RK_IO_RUN, wchar, 1024 * 1024);
+	if (RK_TST_RES == TSKIP)
+		return;
+
+	rk_check_eq(RK_TST_RES, TPASS);
+
+	rk_check_io_le(RK_IO_RUN, wchar, 1024);
+	rk_check_eq(RK_TST_RES, TFAIL);
+
+	rk_check_io_le(RK_IO_SETUP, syscw, 0);
+	rk_check_eq(RK_TST_RES, TPASS);
+
+	rk_check_io_le(RK_IO_TOTAL, syscw, 15);
+	rk_check_eq(RK_TST_RES, TFAIL);
+}
+
+static void test_rk_exclusive(void)
+{
+	cpu_set_t set;
+
+	rk_check_eq(sched_getaffinity(0, sizeof(set), &set), 0);
+
+	/* forked benchmarks are pinned on the first CPU of a reserved core */
+	if (getenv("RIKER_JOBS"))
+		rk_check_eq(CPU_COUNT(&set), 1);
+	else
+		rk_check_ge(CPU_COUNT(&set), 1);
+}
+
+static void test_rk_arena_alloc(void)
+{
+	size_t big = 4 * 1024 * 1024;
+	char *small, *large;
+	void *aligned;
+
+	small = rk_arena_alloc(100, 0);
+	rk_check_ptr_not_null(small);
+
+	aligned = rk_arena_alloc(64, 4096);
+	rk_check_ptr_not_null(aligned);
+	rk_check_eq((unsigned long)aligned % 4096, 0UL);
+
+	/* bigger than a chunk */
+	large = rk_arena_alloc(big, 0);
+	rk_check_ptr_not_null(large);
+
+	if (!small || !large)
+		return;
+
+	memset(small, 'a', 100);
+	memset(large, 'b', big);
+	rk_check_eq(small[99], 'a');
+	rk_check_eq(large[big - 1], 'b');
+
+	rk_check_ptr_null(rk_arena_alloc(16, 3));
+	rk_check_eq(errno, EINVAL);
+}
+
+typedef unsigned long (*sum_func)(const unsigned char *buf, size_t len);
+
+static unsigned long sum_scalar(const unsigned char *buf, size_t len)
+{
+	unsigned long sum = 0;
+
+	for (size_t i = 0; i < len; i++)
+		sum += buf[i];
+
+	return sum;
+}
+
+/* stands for a vectorized kernel, unrolled to be a different code path */
+static unsigned long sum_unrolled(const unsigned char *buf, size_t len)
+{
+	unsigned long sum[4] = { 0 };
+	size_t i;
+
+	for (i = 0; i + 4 <= len; i += 4) {
+		sum[0] += buf[i];
+		sum[1] += buf[i + 1];
+		sum[2] += buf[i + 2];
+		sum[3] += buf[i + 3];
+	}
+
+	for (; i < len; i++)
+		sum[0] += buf[i];
+
+	return sum[0] + sum[1] + sum[2] + sum[3];
+}
+
+static sum_func sum_kernel = sum_scalar;
+static rk_isa_t sum_isa;
+
+static int select_sum(rk_isa_t isa, void *data)
+{
+	(void)data;
+
+	/* there's no AVX-512 kernel */
+	if (isa == RK_ISA_AVX512)
+		return -1;
+
+	sum_kernel = isa == RK_ISA_SCALAR ? sum_scalar : sum_unrolled;
+	sum_isa = isa;
+
+	return 0;
+}
+
+static rk_isa_t query_sum(void *data)
+{
+	(void)data;
+
+	return sum_isa;
+}
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (unsigned long long)ts.tv_sec * 1000000000ULL +
+		(unsigned long long)ts.tv_nsec;
+}
+
+static void test_rk_isa_sweep(void)
+{
+	unsigned long long samples[16], start;
+	rk_bench_stats_t stats;
+	unsigned char buf[4099];
+	unsigned long sum = 0;
+
+	for (size_t i = 0; i < sizeof(buf); i++)
+		buf[i] = (unsigned char)i;
+
+	rk_check_eq(sum_isa, rk_isa_current());
+	rk_check_eq(sum_kernel(buf, sizeof(buf)),
+		sum_scalar(buf, sizeof(buf)));
+
+	for (int i = 0; i < 16; i++) {
+		start = now_ns();
+		sum += sum_kernel(buf, sizeof(buf));
+		samples[i] = now_ns() - start;
+	}
+
+	rk_check_gt(sum, 0UL);
+	rk_check_eq(rk_bench_stats(samples, 16, &stats), 0);
+	rk_isa_report("sum", &stats);
+}
+
+static void test_rk_bench_mem(void)
+{
+	rk_bench_mem_latency_opts_t lat_opts = {
+		.min_size = 4096,
+		.max_size = 1024 * 1024,
+		.loads = 65536,
+	};
+	rk_bench_mem_bandwidth_opts_t bw_opts = {
+		.size = 4 * 1024 * 1024,
+		.runs = 2,
+		.threads = 2,
+	};
+	rk_bench_mem_latency_result_t lat;
+	rk_bench_mem_bandwidth_result_t bw;
+	unsigned long long samples[] = { 1000 };
+	rk_bench_stats_t stats;
+
+	rk_check_eq(rk_bench_mem_latency(&lat_opts, &lat), 0);
+	rk_check_eq(lat.count, 9UL);
+	rk_check_eq(lat.size[8], 1024UL * 1024);
+	rk_check_gt(lat.ns[0], 0);
+	rk_bench_mem_latency_report(&lat);
+
+	rk_check_eq(rk_bench_stats(samples, 1, &stats), 0);
+	rk_check_lt(rk_bench_peak_percent(&stats, 1000), 0);
+
+	rk_check_eq(rk_bench_mem_bandwidth(&bw_opts, &bw), 0);
+	rk_check_eq(bw.threads, 2U);
+	rk_check_gt(bw.mb_per_sec[RK_MEM_TRIAD], 0ULL);
+	rk_check_ge(bw.peak_mb_per_sec, bw.mb_per_sec[RK_MEM_COPY]);
+	rk_bench_mem_bandwidth_report(&bw);
+
+	/* moving peak MB in 1 us is the peak bandwidth */
+	rk_check_gt(rk_bench_peak_percent(&stats, bw.peak_mb_per_sec), 99);
+	rk_check_lt(rk_bench_peak_percent(&stats, bw.peak_mb_per_sec), 101);
+
+	lat_opts.min_size = 2 * lat_opts.max_size;
+	rk_check_eq(rk_bench_mem_latency(&lat_opts, &lat), -1);
+	rk_check_eq(errno, EINVAL);
+}
+
+static void test_rk_calibrate(void)
+{
+	unsigned long long samples[] = { 1000, 1000, 1000 };
+	const rk_calib_t *suite_calib = rk_calibration();
+	rk_bench_stats_t stats;
+	rk_calib_t calib;
+
+	rk_check_eq(rk_calibrate(&calib), 0);
+	rk_check_gt(calib.speed, 0);
+
+	for (int i = 0; i < RK_CALIB_COUNT; i++)
+		rk_check_gt(calib.kernel_ns[i], 0ULL);
+
+	rk_check_eq(rk_bench_stats(samples, 3, &stats), 0);
+
+	if (!suite_calib) {
+		rk_check_lt(rk_bench_score(&stats), 0);
+		rk_check_bench_score_le(&stats, 1000000000ULL);
+		rk_check_eq(RK_TST_RES, TSKIP);
+		return;
+	}
+
+	rk_check_str_eq(suite_calib->cpu, calib.cpu, sizeof(calib.cpu));
+	rk_check_gt(rk_bench_score(&stats), 0);
+	rk_bench_report("calibrated", &stats);
+
+	rk_check_bench_score_le(&stats, 1000000000ULL);
+	rk_check_eq(RK_TST_RES, TPASS);
+
+	rk_check_bench_score_le(&stats, 0);
+	rk_check_eq(RK_TST_RES, TFAIL);
+}
+
+static void copy_ref(void *dst, const void *src, size_t len)
+{
+	memcpy(dst, src, len);
+}
+
+static void copy_words(void *dst, const void *src, size_t len)
+{
+	unsigned char *d = dst;
+	const unsigned char *s = src;
+	size_t i;
+
+	for (i = 0; i + sizeof(unsigned long) <= len; i += sizeof(unsigned long))
+		memcpy(d + i, s + i, sizeof(unsigned long));
+
+	for (; i < len; i++)
+		d[i] = s[i];
+}
+
+/* copies the tail twice, writing one byte past the end of short buffers */
+static void copy_overflow(void *dst, const void *src, size_t len)
+{
+	unsigned char *d = dst;
+	const unsigned char *s = src;
+
+	memcpy(d, s, len);
+
+	if (len && len < 8)
+		d[len] = s[len - 1];
+}
+
+static void test_rk_sweep_buffers(void)
+{
+	rk_sweep_buffers(copy_words, copy_ref, 64, 16);
+	rk_check_eq(RK_TST_RES, TPASS);
+
+	rk_sweep_buffers(copy_overflow, copy_ref, 64, 16);
+	rk_check_eq(RK_TST_RES, TFAIL);
+
+	rk_sweep_buffers(copy_words, copy_ref, 64, 0);
+	rk_check_eq(RK_TST_RES, TFAIL);
+}
+
+typedef struct
+{
+	long x;
+	long y;
+} litmus_sb_t;
+
+static void litmus_sb_init(void *state)
+{
+	litmus_sb_t *sb = state;
+
+	__atomic_store_n(&sb->x, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&sb->y, 0, __ATOMIC_RELAXED);
+}
+
+/* store buffering with sequentially consistent accesses */
+static void litmus_sb_0(void *state, long *regs)
+{
+	litmus_sb_t *sb = state;
+
+	__atomic_store_n(&sb->x, 1, __ATOMIC_SEQ_CST);
+	regs[0] = __atomic_load_n(&sb->y, __ATOMIC_SEQ_CST);
+}
+
+static void litmus_sb_1(void *state, long *regs)
+{
+	litmus_sb_t *sb = state;
+
+	__atomic_store_n(&sb->y, 1, __ATOMIC_SEQ_CST);
+	regs[0] = __atomic_load_n(&sb->x, __ATOMIC_SEQ_CST);
+}
+
+static int litmus_sb_forbidden(const long *regs)
+{
+	return !regs[0] && !regs[RK_LITMUS_REGS];
+}
+
+/* every thread reads its own store, so this outcome is always observed */
+static int litmus_sb_stored(const long *regs)
+{
+	return regs[0] || regs[RK_LITMUS_REGS];
+}
+
+static void test_rk_litmus(void)
+{
+	litmus_sb_t sb;
+	rk_litmus_opts_t opts = {
+		.threads = { litmus_sb_0, litmus_sb_1 },
+		.init = litmus_sb_init,
+		.forbidden = litmus_sb_forbidden,
+		.state = &sb,
+		.iterations = 20000,
+	};
+	rk_litmus_result_t res;
+	unsigned long total = 0;
+
+	rk_check_eq(rk_litmus(&opts, &res), 0);
+	rk_check_eq(res.iterations, 20000UL);
+	rk_check_eq(res.threads, 2U);
+	rk_check_ge(res.noutcomes, 1UL);
+
+	for (size_t i = 0; i < res.noutcomes; i++)
+		total += res.outcomes[i].count;
+
+	rk_check_eq(total + res.dropped, 20000UL);
+
+	rk_check_litmus(&res);
+	rk_check_eq(RK_TST_RES, TPASS);
+
+	opts.forbidden = litmus_sb_stored;
+	opts.iterations = 1000;
+
+	rk_check_eq(rk_litmus(&opts, &res), 0);
+	rk_check_litmus(&res);
+	rk_check_eq(RK_TST_RES, TFAIL);
+
+	opts.threads[0] = NULL;
+	rk_check_eq(rk_litmus(&opts, &res), -1);
+	rk_check_eq(errno, EINVAL);
+}
+
+static char captured[4096];
+static size_t captured_len;
+
+static void capture_output(const char *buf, size_t len, void *data)
+{
+	size_t *calls = data;
+
+	if (len > sizeof(captured) - captured_len - 1)
+		len = sizeof(captured) - captured_len - 1;
+
+	memcpy(captured + captured_len, buf, len);
+	captured_len += len;
+	(*calls)++;
+}
+
+static void test_rk_output(void)
+{
+	size_t calls = 0;
+
+	rk_check_eq(rk_output_fd(-1), -1);
+	rk_check_eq(errno, EBADF);
+
+	rk_check_eq(rk_output_callback(NULL, NULL), -1);
+	rk_check_eq(errno, EINVAL);
+
+	captured_len = 0;
+
+	/* output is given to the callback once the sink changes again */
+	rk_check_eq(rk_output_callback(capture_output, &calls), 0);
+	rk_result(TINFO, "first line");
+	rk_result(TINFO, "second line");
+	rk_check_eq(calls, (size_t)0);
+	rk_check_eq(rk_output_color(), 0);
+	rk_check_eq(rk_output_fd(STDOUT_FILENO), 0);
+
+	captured[captured_len] = '\0';
+
+	rk_check_eq(calls, (size_t)1);
+	rk_check_not_contains(captured, captured_len, "\033[");
+	rk_check_count(captured, captured_len, " INFO ", 2);
+	rk_check_contains(captured, captured_len, "second line\n");
+
+	/* not even when colors are forced */
+	setenv("RIKER_COLOR", "always", 1);
+	rk_check_eq(rk_output_callback(capture_output, &calls), 0);
+	rk_check_eq(rk_output_color(), 0);
+	rk_check_eq(rk_output_fd(STDOUT_FILENO), 0);
+	unsetenv("RIKER_COLOR");
+}
+
+static void test_rk_output_exit(void)
+{
+	char buf[256] = { 0 };
+	int fds[2], status;
+	ssize_t len;
+	pid_t pid;
+
+	rk_check_eq(pipe(fds), 0);
+
+	/* nothing buffered is inherited by the child */
+	rk_check_eq(rk_output_fd(STDOUT_FILENO), 0);
+
+	pid = fork();
+	if (!pid) {
+		close(fds[0]);
+		rk_output_fd(fds[1]);
+		rk_result(TINFO, "before exit");
+		exit(0);
+	}
+
+	close(fds[1]);
+	rk_check_ne(pid, -1);
+	rk_check_eq(waitpid(pid, &status, 0), pid);
+
+	len = read(fds[0], buf, sizeof(buf) - 1);
+	rk_check_gt(len, 0);
+	rk_check_contains(buf, len > 0 ? (size_t)len : 0, "before exit");
+
+	close(fds[0]);
+}
+
+static int batch_poisoned;
+
+static void test_batch_short(void)
+{
+	rk_check_eq(1, 1);
+}
+
+static void test_batch_poison(void)
+{
+	batch_poisoned = 1;
+	rk_check_eq(batch_poisoned, 1);
+}
+
+static void test_batch_victim(void)
+{
+	/* crashes only if the poisoning test ran in the same process */
+	if (batch_poisoned)
+		raise(SIGSEGV);
+
+	rk_check_eq(batch_poisoned, 0);
+}
+
+/* Tests which ran after the one calling exit(), shared across processes */
+static int *batch_survivors;
+
+static void test_batch_exit(void)
+{
+	rk_check_eq(1, 1);
+	exit(0);
+}
+
+static void test_batch_survivor(void)
+{
+	__atomic_add_fetch(batch_survivors, 1, __ATOMIC_RELAXED);
+	rk_check_eq(1, 1);
+}
+
+static void *burn_cpu(void *arg)
+{
+	struct timespec ts;
+
+	(void)arg;
+
+	do {
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	} while (ts.tv_sec == 0 && ts.tv_nsec < 50000000);
+
+	return NULL;
+}
+
+static void test_res_thread(void)
+{
+	pthread_t thread;
+
+	/* the thread exits before the test completes */
+	rk_check_eq(pthread_create(&thread, NULL, burn_cpu, NULL), 0);
+	rk_check_eq(pthread_join(thread, NULL), 0);
+}
+
+static int res_burned;
+
+static void *burn_and_wait(void *arg)
+{
+	burn_cpu(arg);
+	__atomic_store_n(&res_burned, 1, __ATOMIC_RELEASE);
+	pause();
+
+	return NULL;
+}
+
+static void test_res_sleep(void)
+{
+	rk_check_eq(usleep(50000), 0);
+}
+
+static void test_res_threads(void)
+{
+	pthread_t thread;
+
+	/* the thread is still alive when the test completes */
+	rk_check_eq(pthread_create(&thread, NULL, burn_and_wait, NULL), 0);
+	rk_check_eq(pthread_detach(thread), 0);
+
+	while (!__atomic_load_n(&res_burned, __ATOMIC_ACQUIRE))
+		usleep(1000);
+}
+
+/*
+ * Read the columns of the resource table after the I/O counters: wall, CPU,
+ * run queue and blocked time of a test, whose blocked time may be unknown,
+ * and its number of timeslices.
+ */
+static int res_columns(const char *table, const char *name,
+		unsigned long long *cols, char *blocked)
+{
+	char pattern[64];
+	const char *line;
+
+	snprintf(pattern, sizeof(pattern), "\n%s ", name);
+
+	line = strstr(table, pattern);
+	if (!line)
+		return -1;
+
+	if (sscanf(line, "%*s %*u %*u %*u %*u %*u %*u %llu %llu %llu %15s %llu",
+			cols, cols + 1, cols + 2, blocked, cols + 3) != 5)
+		return -1;
+
+	return 0;
+}
+
+/*
+ * Read the CPU time, run queue time and timeslices of the busiest thread of
+ * a test, from the row following the one of the test.
+ */
+static int res_busiest(const char *table, const char *name,
+		unsigned long long *cols)
+{
+	char pattern[64];
+	const char *line;
+
+	snprintf(pattern, sizeof(pattern), "\n%s ", name);
+
+	line = strstr(table, pattern);
+	if (!line)
+		return -1;
+
+	line = strchr(line + 1, '\n');
+	if (!line)
+		return -1;
+
+	if (sscanf(line, " tid %*d %llu %llu %llu", cols, cols + 1,
+			cols + 2) != 3)
+		return -1;
+
+	return 0;
+}
+
+static rk_suite_t test_suite = {
+	.tests = (rk_test_t []) {
+		{
+			.setup = setup_test,
+			.run = test_pass,
+			.teardown = teardown_test
+		},
+		{
+			.setup = setup_error,
+			.run = test_pass,
+			.teardown = teardown_test,
+		},
+		{
+			.setup = setup_test,
+			.run = test_error,
+			.teardown = teardown_test,
+		},
+		{
+			.setup = setup_test,
+			.run = test_pass,
+			.teardown = teardown_error,
+		},
+		{ .run = test_pass },
+		{ .run = test_fail },
+		{ .run = test_skip },
+		{
+			.run = test_rk_check_expr,
+			.flags = RK_TEST_THREAD_SAFE,
+		},
+		{
+			.run = test_rk_check_eq,
+			.flags = RK_TEST_THREAD_SAFE,
+		},
+		{
+			.run = test_rk_check_ne,
+			.flags = RK_TEST_THREAD_SAFE,
+		},
+		{
+			.run = test_rk_check_gt,
+			.flags = RK_TEST_THREAD_SAFE,
+		},
+		{
+			.run = test_rk_check_ge,
+			.flags = RK_TEST_THREAD_SAFE,
+		},
+		{
+			.run = test_rk_check_lt,
+			.flags = RK_TEST_THREAD_SAFE,
+		},
+		{
+			.run = test_rk_check_le,
+			.flags = RK_TEST_THREAD_SAFE,
+		},
+		{
+			.run = test_rk_check_ptr_null,
+			.flags = RK_TEST_THREAD_SAFE,
+		},
+		{
+			.run = test_rk_check_ptr_not_null,
+			.flags = RK_TEST_THREAD_SAFE,
+		},
+		{
+			.run = test_rk_check_mem_eq,
+			.flags = RK_TEST_THREAD_SAFE,
+		},
+		{
+			.run = test_rk_check_mem_ne,
+			.flags = RK_TEST_THREAD_SAFE,
+		},
+		{
+			.run = test_rk_check_str_eq,
+			.flags = RK_TEST_THREAD_SAFE,
+		},
+		{
+			.run = test_rk_check_str_ne,
+			.flags = RK_TEST_THREAD_SAFE,
+		},
+		{
+			.run = test_rk_check_eq_ptr,
+			.flags = RK_TEST_THREAD_SAFE,
+		},
+		{
+			.run = test_rk_check_ptr_ne,
+			.flags = RK_TEST_THREAD_SAFE,
+		},
+		{ .run = test_rk_check_assignment },
+		{ .run = test_rk_check_contention_le },
+		{ .run = test_rk_clock },
+		{ .run = test_rk_service_stub },
+		{ .run = test_rk_run_cmd },
+		{ .run = test_rk_check_contains },
+		{ .run = test_rk_check_regex },
+		{ .run = test_rk_check_str_diff },
+		{ .run = test_rk_check_constant_time },
+		{ .run = test_rk_check_jitter_le },
+		{ .run = test_rk_bench_io },
+		{ .run = test_rk_check_io_le, .name = "test_rk_check_io_le" },
+		{
+			.run = test_rk_exclusive,
+			.name = "test_rk_exclusive",
+			.flags = RK_TEST_EXCLUSIVE,
+		},
+		{
+			.run = test_rk_arena_alloc,
+			.flags = RK_TEST_THREAD_SAFE,
+		},
+		{
+			.run = test_rk_isa_sweep,
+			.name = "test_rk_isa_sweep",
+			.flags = RK_TEST_ISA_SWEEP | RK_TEST_THREAD_SAFE,
+		},
+		{ .run = test_rk_bench_mem },
+		{ .run = test_rk_calibrate },
+		{ .run = test_rk_sweep_buffers },
+		{ .run = test_rk_litmus },
+		{ .run = test_rk_output },
+		{ .run = test_rk_output_exit },
+		{ .async = test_rk_async },
+		{ .async = test_rk_async_timeout, .timeout = 50 },
+		{ .run = NULL },
+	},
+	.setup = setup_suite,
+	.teardown = teardown_suite,
+};
+
+static void setup_isa_suite(void)
+{
+	rk_check_eq(rk_isa_register("sum", select_sum, query_sum, NULL), 0);
+	rk_check_eq(select_sum(RK_ISA_SCALAR, NULL), 0);
+}
+
+static void test_isa_restored(void)
+{
+	rk_check_eq(sum_isa, RK_ISA_SCALAR);
+}
+
+static rk_suite_t isa_suite = {
+	.tests = (rk_test_t []) {
+		{
+			.run = test_rk_isa_sweep,
+			.name = "isa_sweep",
+			.flags = RK_TEST_ISA_SWEEP,
+		},
+		{ .run = test_isa_restored, .name = "isa_restored" },
+		{ .run = NULL },
+	},
+	.setup = setup_isa_suite,
+};
+
+static rk_suite_t overflow_suite = {
+	.tests = (rk_test_t []) {
+		{ .async = test_rk_async_overflow },
+		{ .run = NULL },
+	},
+};
+
+static rk_suite_t batch_suite = {
+	.tests = (rk_test_t []) {
+		{ .run = test_batch_short, .name = "batch_short_1" },
+		{ .run = test_batch_short, .name = "batch_short_2" },
+		{ .run = test_batch_poison, .name = "batch_poison" },
+		{ .run = test_batch_short, .name = "batch_short_3" },
+		{ .run = test_batch_short, .name = "batch_short_4" },
+		{ .run = test_batch_victim, .name = "batch_victim" },
+		{ .run = test_batch_short, .name = "batch_short_5" },
+		{ .run = NULL },
+	},
+};
+
+static rk_suite_t exit_suite = {
+	.tests = (rk_test_t []) {
+		{ .run = test_batch_short, .name = "exit_short_1" },
+		{ .run = test_batch_exit, .name = "exit_early" },
+		{ .run = test_batch_survivor, .name = "exit_survivor_1" },
+		{ .run = test_batch_survivor, .name = "exit_survivor_2" },
+		{ .run = NULL },
+	},
+};
+
+static rk_suite_t history_suite = {
+	.tests = (rk_test_t []) {
+		{ .run = test_batch_short },
+		{ .run = test_batch_short, .name = "history_named" },
+		{ .run = NULL },
+	},
+};
+
+static rk_suite_t coverage_suite = {
+	.tests = (rk_test_t []) {
+		{ .run = test_batch_short, .name = "coverage_short" },
+		{ .run = NULL },
+	},
+};
+
+/* Read the output of a child process until it closes the pipe */
+static void read_all(int fd, char *buf, size_t size)
+{
+	size_t len = 0;
+	ssize_t ret;
+
+	while (len < size - 1) {
+		ret = read(fd, buf + len, size - 1 - len);
+		if (ret <= 0)
+			break;
+
+		len += (size_t)ret;
+	}
+
+	buf[len] = '\0';
+	close(fd);
+}
+
+/*
+ * Run a suite serially inside a child process having `var` set to `value`,
+ * reading its output into `buf`. Returns the status of the child.
+ */
+static int run_captured(rk_suite_t *suite, const char *var,
+		const char *value, char *buf, size_t size)
+{
+	int fds[2], status;
+	pid_t pid;
+
+	assert(!pipe(fds));
+
+	pid = fork();
+	assert(pid != -1);
+
+	if (!pid) {
+		close(fds[0]);
+		unsetenv("RIKER_JOBS");
+		unsetenv("RIKER_THREADS");
+		setenv(var, value, 1);
+		rk_output_fd(fds[1]);
+		rk_run_suite(suite);
+		exit(0);
+	}
+
+	close(fds[1]);
+	read_all(fds[0], buf, size);
+
+	assert(waitpid(pid, &status, 0) != -1);
+
+	return status;
+}
+
+static rk_suite_t res_suite = {
+	.tests = (rk_test_t []) {
+		{ .run = test_res_thread, .name = "res_thread" },
+		{ .run = test_res_sleep, .name = "res_sleep" },
+		{ .run = test_res_threads, .name = "res_threads" },
+		{ .run = NULL },
+	},
+};
+
+/* Peak RSS recorded inside the history `journal` for the test `name` */
+static unsigned long long history_rss(char *journal, const char *name)
+{
+	unsigned long long rss, duration;
+	int off;
+
+	for (char *line = strtok(journal, "\n"); line;
+			line = strtok(NULL, "\n")) {
+		if (sscanf(line, "%llu %llu %n", &rss, &duration, &off) == 2 &&
+				!strcmp(line + off, name))
+			return rss;
+	}
+
+	return ULLONG_MAX;
+}
+
+int main(void)
+{
+	char history[] = "/tmp/riker-history-XXXXXX";
+	char exits[] = "/tmp/riker-exits-XXXXXX";
+	char unnamed[] = "/tmp/riker-unnamed-XXXXXX";
+	char calibration[] = "/tmp/riker-calibration-XXXXXX";
+	const char *other_cpu = "cpu Other CPU\nalu 1\nstream 2\n"
+		"latency 3\nsyscall 4\n";
+	char coverage[] = "/tmp/riker-coverage-XXXXXX";
+	char coverage_dir[64];
+	unsigned long long cols[4];
+	char table[16384], blocked[16];
+	size_t forks_failed = 0;
+	int fd, fds[2];
+
+	pid_t pid;
+	int status;
+
+	pid = fork();
+	assert(pid != -1);
+
+	if (!pid) {
+		rk_run_suite(&test_suite);
+		exit(0);
+	}
+
+	assert(waitpid(pid, &status, 0) != -1);
+	assert(WIFEXITED(status));
+
+	/* the fingerprint of another CPU model is kept */
+	fd = mkstemp(calibration);
+	assert(fd != -1);
+	assert(dprintf(fd, "%s", other_cpu) > 0);
+	close(fd);
+
+	/* run the suite again, forking tests in parallel on a calibrated host */
+	pid = fork();
+	assert(pid != -1);
+
+	if (!pid) {
+		setenv("RIKER_JOBS", "4", 1);
+		setenv("RIKER_CALIBRATION", calibration, 1);
+		rk_run_suite(&test_suite);
+		exit(0);
+	}
+
+	assert(waitpid(pid, &status, 0) != -1);
+	assert(WIFEXITED(status));
+
+	/* run the suite again, thread-safe tests running on a pool */
+	pid = fork();
+	assert(pid != -1);
+
+	if (!pid) {
+		setenv("RIKER_THREADS", "4", 1);
+		rk_run_suite(&test_suite);
+		exit(0);
+	}
+
+	assert(waitpid(pid, &status, 0) != -1);
+	assert(WIFEXITED(status));
+
+	/*
+	 * the first run records durations, the second one batches the short
+	 * tests and runs the crashing one again inside its own process
+	 */
+	fd = mkstemp(history);
+	assert(fd != -1);
+	close(fd);
+
+	for (int i = 0; i < 2; i++) {
+		pid = fork();
+		assert(pid != -1);
+
+		if (!pid) {
+			setenv("RIKER_JOBS", "2", 1);
+			setenv("RIKER_HISTORY", history, 1);
+			rk_run_suite(&batch_suite);
+			exit(0);
+		}
+
+		assert(waitpid(pid, &status, 0) != -1);
+		assert(WIFEXITED(status));
+		assert(WEXITSTATUS(status) == RK_PASSED);
+	}
+
+	unlink(history);
+
+	/* unnamed tests would take the history of a test moved at their place */
+	fd = mkstemp(unnamed);
+	assert(fd != -1);
+	close(fd);
+
+	pid = fork();
+	assert(pid != -1);
+
+	if (!pid) {
+		/* memory of the runner is not accounted to its tests */
+		assert(mmap(NULL, 64 << 20, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0) !=
+			MAP_FAILED);
+
+		setenv("RIKER_JOBS", "2", 1);
+		setenv("RIKER_HISTORY", unnamed, 1);
+		rk_run_suite(&history_suite);
+		exit(0);
+	}
+
+	assert(waitpid(pid, &status, 0) != -1);
+	assert(WIFEXITED(status));
+	assert(WEXITSTATUS(status) == RK_PASSED);
+
+	fd = open(unnamed, O_RDONLY);
+	assert(fd != -1);
+	read_all(fd, table, sizeof(table));
+
+	assert(strstr(table, " history_named\n"));
+	assert(!strstr(table, " test 1\n"));
+	assert(history_rss(table, "history_named") < 32 * 1024);
+	unlink(unnamed);
+
+	/* a test calling exit(0) must not drop the rest of its batch */
+	batch_survivors = mmap(NULL, sizeof(int), PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	assert(batch_survivors != MAP_FAILED);
+
+	fd = mkstemp(exits);
+	assert(fd != -1);
+	close(fd);
+
+	for (int i = 0; i < 2; i++) {
+		pid = fork();
+		assert(pid != -1);
+
+		if (!pid) {
+			setenv("RIKER_JOBS", "2", 1);
+			setenv("RIKER_HISTORY", exits, 1);
+			rk_run_suite(&exit_suite);
+			exit(0);
+		}
+
+		assert(waitpid(pid, &status, 0) != -1);
+		assert(WIFEXITED(status));
+		assert(WEXITSTATUS(status) == RK_FAILED);
+	}
+
+	assert(*batch_survivors == 4);
+	munmap(batch_survivors, sizeof(int));
+	unlink(exits);
+
+	/* tests which can't be forked are reported, each of them */
+	assert(!pipe(fds));
+
+	pid = fork();
+	assert(pid != -1);
+
+	if (!pid) {
+		struct rlimit rl = { .rlim_cur = 32, .rlim_max = 32 };
+
+		close(fds[0]);
+		rk_output_fd(fds[1]);
+		setenv("RIKER_JOBS", "2", 1);
+		unsetenv("RIKER_HISTORY");
+
+		/* the output of a forked test can't be collected */
+		setrlimit(RLIMIT_NOFILE, &rl);
+		while (dup(STDIN_FILENO) != -1)
+			;
+
+		rk_run_suite(&batch_suite);
+		exit(0);
+	}
+
+	close(fds[1]);
+	read_all(fds[0], table, sizeof(table));
+
+	assert(waitpid(pid, &status, 0) != -1);
+	assert(WIFEXITED(status));
+
+	for (const char *ptr = table; (ptr = strstr(ptr, "Can't fork")); ptr++)
+		forks_failed++;
+
+	assert(forks_failed == 7);
+
+	/* dispatch points get their kernels back, variants are summarized */
+	status = run_captured(&isa_suite, "RIKER_COLOR", "never", table,
+		sizeof(table));
+	assert(WIFEXITED(status));
+	assert(WEXITSTATUS(status) == RK_PASSED);
+
+	assert(strstr(table, "ISA variants of isa_sweep:\n"
+		"scalar   passed 4, failed 0, skipped 0, errors 0\n"));
+
+	/* a coroutine overflowing its stack hits the guard page */
+	status = run_captured(&overflow_suite, "RIKER_COLOR", "never", table,
+		sizeof(table));
+	assert(WIFSIGNALED(status));
+	assert(WTERMSIG(status) == SIGSEGV);
+
+	/* CPU time of exited threads is kept, their blocked time is unknown */
+	status = run_captured(&res_suite, "RIKER_RESOURCES", "1", table,
+		sizeof(table));
+	assert(WIFEXITED(status));
+	assert(WEXITSTATUS(status) == RK_PASSED);
+
+	assert(!res_columns(table, "res_thread", cols, blocked));
+	assert(cols[1] >= 50000);
+	assert(!strcmp(blocked, "-"));
+
+	assert(!res_columns(table, "res_sleep", cols, blocked));
+	assert(cols[1] < 50000);
+	assert(strtoull(blocked, NULL, 10) >= 40000);
+	assert(cols[3] >= 1);
+
+	/* timeslices and times of the threads alive at the end are reported */
+	assert(!res_columns(table, "res_threads", cols, blocked));
+	assert(cols[1] >= 50000);
+	assert(cols[3] >= 2);
+
+	assert(!res_busiest(table, "res_threads", cols));
+	assert(cols[0] >= 50000);
+	assert(cols[2] >= 1);
+
+#ifndef RK_COVERAGE
+	/* without coverage support the directory is not even created */
+	assert(mkdtemp(coverage));
+	snprintf(coverage_dir, sizeof(coverage_dir), "%s/gcda", coverage);
+
+	status = run_captured(&coverage_suite, "RIKER_COVERAGE_DIR",
+		coverage_dir, table, sizeof(table));
+	assert(WIFEXITED(status));
+	assert(WEXITSTATUS(status) == RK_PASSED);
+
+	assert(strstr(table, "INFO Coverage is not available"));
+	assert(access(coverage_dir, F_OK) == -1 && errno == ENOENT);
+	assert(!rmdir(coverage));
+#endif
+
+	fd = open(calibration, O_RDONLY);
+	assert(fd != -1);
+	read_all(fd, table, sizeof(table));
+
+	assert(strstr(table, other_cpu));
+	assert(strstr(table, "cpu ") != strstr(table, other_cpu));
+
+	unlink(calibration);
 
 	return 0;
 }
@@ -0,0 +1,221 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) 2025 Andrea Cervesato <andrea.cervesato@mailbox.org>
+ */
+
+#define TEST_CUSTOM_MAIN 1
+
+#include "riker.hpp"
+#include <stdexcept>
+#include <vector>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+struct point
+{
+	int x;
+	int y;
+
+	bool operator==(const point &other) const
+	{
+		return x == other.x && y == other.y;
+	}
+};
+
+template <>
+struct riker::formatter<point>
+{
+	static std::string format(const point &p)
+	{
+		return "(" + std::to_string(p.x) + ", " + std::to_string(p.y) + ")";
+	}
+};
+
+struct opaque
+{
+	long value;
+
+	bool operator==(const opaque &other) const
+	{
+		return value == other.value;
+	}
+};
+
+enum class color
+{
+	red = 1,
+	green = 2,
+};
+
+static int fixtures_alive;
+static int fixtures_created;
+
+struct counted
+{
+	std::vector<int> data;
+
+	counted() : data(3, 1)
+	{
+		fixtures_alive++;
+		fixtures_created++;
+	}
+
+	~counted()
+	{
+		fixtures_alive--;
+	}
+
+	void run()
+	{
+		rk_check_eq(fixtures_alive, 1);
+		rk_check_eq(data.size(), 3U);
+	}
+
+	void run_throw()
+	{
+		throw std::runtime_error("fixture failure");
+	}
+};
+
+struct shared
+{
+	int value;
+
+	shared() : value(42)
+	{
+	}
+};
+
+static void test_check_numbers()
+{
+	int a = 10;
+	long b = 20;
+	double c = 0.5;
+
+	rk_check_eq(a, 10);
+	rk_check_eq(RK_TST_RES, TPASS);
+
+	rk_check_eq(a, b);
+	rk_check_eq(RK_TST_RES, TFAIL);
+
+	rk_check_ne(a, b);
+	rk_check_eq(RK_TST_RES, TPASS);
+
+	rk_check_lt(a, b);
+	rk_check_eq(RK_TST_RES, TPASS);
+
+	rk_check_le(b, a);
+	rk_check_eq(RK_TST_RES, TFAIL);
+
+	rk_check_gt(c, 0);
+	rk_check_eq(RK_TST_RES, TPASS);
+
+	rk_check_ge(c, 1);
+	rk_check_eq(RK_TST_RES, TFAIL);
+}
+
+static void test_check_strings()
+{
+	std::string hello("hello");
+
+	rk_check_eq(hello, "hello");
+	rk_check_eq(RK_TST_RES, TPASS);
+
+	rk_check_eq(hello, "world");
+	rk_check_eq(RK_TST_RES, TFAIL);
+
+	rk_check_eq(riker::format(hello), "\"hello\"");
+	rk_check_eq(riker::format("hello"), "\"hello\"");
+	rk_check_eq(riker::format(static_cast<const char *>(nullptr)), "NULL");
+}
+
+static void test_check_user_types()
+{
+	point p1 = { 1, 2 };
+	point p2 = { 1, 3 };
+	opaque o1 = { 1 };
+	opaque o2 = { 2 };
+
+	rk_check_eq(p1, p1);
+	rk_check_eq(RK_TST_RES, TPASS);
+
+	rk_check_eq(p1, p2);
+	rk_check_eq(RK_TST_RES, TFAIL);
+
+	rk_check_eq(o1, o2);
+	rk_check_eq(RK_TST_RES, TFAIL);
+
+	rk_check_eq(color::red, color::green);
+	rk_check_eq(RK_TST_RES, TFAIL);
+
+	rk_check_eq(riker::format(p2), "(1, 3)");
+	rk_check_eq(riker::format(o1), "<8-byte object>");
+	rk_check_eq(riker::format(color::green), "2");
+	rk_check_eq(riker::format(true), "true");
+	rk_check_eq(riker::format(static_cast<unsigned char>(65)), "65");
+}
+
+static void test_fixtures_released()
+{
+	rk_check_eq(fixtures_created, 2);
+	rk_check_eq(fixtures_alive, 0);
+}
+
+static void test_suite_fixture()
+{
+	rk_check_eq(riker::suite_fixture<shared>().value, 42);
+}
+
+static rk_test_t tests[] = {
+	riker::test<test_check_numbers>("check_numbers"),
+	riker::test<test_check_strings>("check_strings"),
+	riker::test<test_check_user_types>("check_user_types"),
+	riker::test<counted, &counted::run>("fixture"),
+	riker::test<counted, &counted::run_throw>("fixture_throw"),
+	riker::test<test_fixtures_released>("fixtures_released"),
+	riker::test<test_suite_fixture>("suite_fixture"),
+	{},
+};
+
+rk_suite_t test_suite = riker::suite<shared>(tests);
+
+int main()
+{
+	std::string output;
+	char buf[4096];
+	ssize_t len;
+	int status, fds[2];
+	pid_t pid;
+
+	assert(pipe(fds) != -1);
+
+	/* the suite fails on purpose, only its completion is verified */
+	pid = fork();
+	assert(pid != -1);
+
+	if (!pid) {
+		close(fds[0]);
+		rk_output_fd(fds[1]);
+		rk_run_suite(&test_suite);
+		exit(0);
+	}
+
+	close(fds[1]);
+
+	while ((len = read(fds[0], buf, sizeof(buf))) > 0)
+		output.append(buf, static_cast<size_t>(len));
+
+	close(fds[0]);
+
+	assert(waitpid(pid, &status, 0) != -1);
+	assert(WIFEXITED(status));
+
+	/* exceptions are reported where the test is declared */
+	assert(output.find("test_riker.cpp:") != std::string::npos);
+	assert(output.find("fixture_throw: uncaught exception in test: "
+		"fixture failure") != std::string::npos);
+	assert(output.find("riker.hpp:") == std::string::npos);
+
+	return 0;
+}
@@ -0,0 +1,102 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) 2025 Andrea Cervesato <andrea.cervesato@mailbox.org>
+ */
+
+#define _GNU_SOURCE
+#define TEST_CUSTOM_MAIN 1
+
+#include "riker.h"
+#include <ftw.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+static size_t gcda_files;
+
+static void test_coverage_first(void)
+{
+	rk_check_eq(1, 1);
+}
+
+static void test_coverage_second(void)
+{
+	rk_check_ne(1, 2);
+}
+
+static rk_suite_t test_suite = {
+	.tests = (rk_test_t []) {
+		{ .run = test_coverage_first, .name = "coverage_first" },
+		{ .run = test_coverage_second, .name = "coverage_second" },
+		{ .run = NULL },
+	},
+};
+
+static int count_gcda(const char *path, const struct stat *st, int flag,
+		struct FTW *ftw)
+{
+	size_t len = strlen(path);
+
+	(void)st;
+	(void)ftw;
+
+	if (flag == FTW_F && len > 5 && !strcmp(path + len - 5, ".gcda"))
+		gcda_files++;
+
+	return 0;
+}
+
+/* Number of .gcda files found anywhere under `dir`/`name` */
+static size_t count_dir(const char *dir, const char *name)
+{
+	char path[PATH_MAX];
+
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+
+	gcda_files = 0;
+	nftw(path, count_gcda, 16, FTW_PHYS);
+
+	return gcda_files;
+}
+
+static int remove_entry(const char *path, const struct stat *st, int flag,
+		struct FTW *ftw)
+{
+	(void)st;
+	(void)ftw;
+
+	return flag == FTW_DP ? rmdir(path) : unlink(path);
+}
+
+int main(void)
+{
+	char dir[] = "/tmp/riker-coverage-XXXXXX";
+	pid_t pid;
+	int status;
+
+	assert(mkdtemp(dir));
+
+	/* forked tests dump their coverage inside a directory each */
+	pid = fork();
+	assert(pid != -1);
+
+	if (!pid) {
+		setenv("RIKER_COVERAGE_DIR", dir, 1);
+		setenv("RIKER_JOBS", "2", 1);
+		rk_run_suite(&test_suite);
+		exit(0);
+	}
+
+	assert(waitpid(pid, &status, 0) != -1);
+	assert(WIFEXITED(status));
+	assert(WEXITSTATUS(status) == RK_PASSED);
+
+	assert(count_dir(dir, "coverage_first"));
+	assert(count_dir(dir, "coverage_second"));
+	assert(count_dir(dir, "merged"));
+
+	nftw(dir, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+
+	return 0;
+}